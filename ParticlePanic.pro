@@ -5,28 +5,45 @@ CONFIG += opengl
 INCLUDEPATH += .
 OBJECTS_DIR = obj
 
-QMAKE_CXXFLAGS += -std=c++11
+QMAKE_CXXFLAGS += -std=c++11 -fopenmp -pthread
+QMAKE_LFLAGS += -fopenmp -pthread
 
+# The simulation itself is in core/ParticlePanicCore.pro, build that first.
+# Only the window, toolbar and OpenGL drawing are compiled here.
 SOURCES += \
-    src/Vec3.cpp \
-    src/Mat3.cpp \
-    src/Particle.cpp \
-    src/World.cpp \
+    src/Vec3Draw.cpp \
+    src/ParticleDraw.cpp \
+    src/MarchingAlgorithmsDraw.cpp \
+    src/WorldDraw.cpp \
     src/Toolbar.cpp \
-    src/ParticleProperties.cpp \
-    src/Main.cpp \
-    src/MarchingAlgorithms.cpp
+    src/Main.cpp
 
 HEADERS += \
     include/Particle.h \
+    include/ParticleStore.h \
+    include/NeighbourList.h \
+    include/SpringHash.h \
+    include/CellHash.h \
+    include/PhaseTimer.h \
+    include/RenderSnapshot.h \
+    include/TripleBuffer.h \
+    include/SimulationThread.h \
     include/Vec3.h \
     include/Mat3.h \
     include/World.h \
     include/Toolbar.h \
     include/ParticleProperties.h \
     include/Commands.h \
+    include/CommandLog.h \
+    include/Checkpoint.h \
+    include/Trajectory.h \
+    include/FieldBuffer.h \
+    include/MetaballKernel.h \
     include/MarchingAlgorithms.h
 
+LIBS += -L$$PWD/lib -lParticlePanicCore
+PRE_TARGETDEPS += $$PWD/lib/libParticlePanicCore.a
+
 LIBS += -L/usr/local/lib
 
 linux: {
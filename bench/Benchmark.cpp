@@ -0,0 +1,323 @@
+///
+///  @file Benchmark.cpp
+///  @brief headless benchmark: runs canonical scenes through World::update with no window and reports the
+///         throughput and memory, so the effect of a change on the simulation can be measured
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "include/World.h"
+
+namespace
+{
+  /// Same window size as Main.cpp opens with, the world's width follows from its aspect ratio
+  const int WINDOW_WIDTH = 900;
+  const int WINDOW_HEIGHT = 600;
+  const float ASPECT = float(WINDOW_WIDTH)/float(WINDOW_HEIGHT);
+
+  /// Indices into World::m_particleTypes, see World::init()
+  const int WATER = 0;
+  const int SLIME = 1;
+  const int CUBE = 4;
+
+  struct Result
+  {
+    int m_steps;
+    int m_startParticles;
+    int m_endParticles;
+    double m_seconds;
+    double m_particleSteps;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief Box lower and upper corner of a block of particles, in 3D the x and z extents are what
+  ///        ParticleStore::updatePosition lets particles reach
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Box
+  {
+    Vec3 m_min;
+    Vec3 m_max;
+  };
+
+  float sideLimit(float _halfheight, bool _3d)
+  {
+    float halfwidth = _halfheight*ASPECT;
+    if(_3d) return (halfwidth-0.5f)*0.4f-0.05f;
+    return halfwidth-0.6f;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief blockBox       works out a block of roughly _count particles with _spacing between them, sitting on the
+  ///                       floor and covering _fraction of the width. Returns false if it does not fit under half
+  ///                       of the world's height.
+  //----------------------------------------------------------------------------------------------------------------------
+  bool blockBox(int _count, float _spacing, float _fraction, float _halfheight, bool _3d, Box &o_box)
+  {
+    float side = sideLimit(_halfheight,_3d);
+    float width = 2.0f*side*_fraction;
+    int columns = (int)floor(width/_spacing)+1;
+    int layers = 1;
+    float depth = 0.0f;
+    if(_3d)
+    {
+      layers = (int)floor(2.0f*side/_spacing)+1;
+      depth = (layers-1)*_spacing;
+    }
+    int rows = (_count+columns*layers-1)/(columns*layers);
+
+    float bottom = -_halfheight+0.6f;
+    o_box.m_min = Vec3(-side,bottom,-depth/2.0f);
+    o_box.m_max = Vec3(-side+(columns-1)*_spacing,bottom+(rows-1)*_spacing,depth/2.0f);
+    return bottom+rows*_spacing < 0.0f;
+  }
+
+  float fitBlock(int _count, float _spacing, float _fraction, bool _3d, Box &o_box)
+  {
+    float halfheight = 5.0f;
+    while(!blockBox(_count,_spacing,_fraction,halfheight,_3d,o_box))
+    {
+      halfheight += 1.0f;
+    }
+    return halfheight;
+  }
+
+  void setupWorld(World &io_world, float _halfheight, bool _3d)
+  {
+    io_world.init();
+    io_world.set3D(_3d);
+    io_world.setWorldHalfHeight(_halfheight);
+    io_world.resizeWorld(WINDOW_WIDTH,WINDOW_HEIGHT);
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief setupScene   fills the world with one of the canonical scenes. Returns false if the scene does not
+  ///                     exist in this mode.
+  //----------------------------------------------------------------------------------------------------------------------
+  bool setupScene(World &io_world, const std::string &_scene, int _count, bool _3d)
+  {
+    float spacing = 0.25f;
+    if(_3d) spacing = 0.35f;
+    Box box;
+
+    if(_scene=="dam")
+    {
+      // Water stacked against the left wall, it collapses across the floor
+      float halfheight = fitBlock(_count,spacing,0.4f,_3d,box);
+      setupWorld(io_world,halfheight,_3d);
+      io_world.setToDraw(WATER);
+      io_world.addBlock(box.m_min,box.m_max,spacing);
+    }
+    else if(_scene=="rain")
+    {
+      // A still pool across the floor with the rain switched on, so the count grows during the run
+      float halfheight = fitBlock(_count,spacing,1.0f,_3d,box);
+      setupWorld(io_world,halfheight,_3d);
+      io_world.setToDraw(WATER);
+      io_world.addBlock(box.m_min,box.m_max,spacing);
+      io_world.toggleRain();
+    }
+    else if(_scene=="slime")
+    {
+      // One blob of slime in the middle, its springs form as it falls
+      float halfheight = fitBlock(_count,spacing,0.3f,_3d,box);
+      setupWorld(io_world,halfheight,_3d);
+      Vec3 shift = Vec3(sideLimit(halfheight,_3d)*0.7f,halfheight*0.5f,0.0f);
+      io_world.setToDraw(SLIME);
+      io_world.addBlock(box.m_min+shift,box.m_max+shift,spacing);
+    }
+    else if(_scene=="cubes")
+    {
+      // drawCube() objects on a grid, 100 particles each. drawCube only exists in 2D.
+      if(_3d) return false;
+      int cubes = (_count+99)/100;
+      int perrow = (int)ceil(sqrt(cubes*ASPECT));
+      int rows = (cubes+perrow-1)/perrow;
+      float pitch = 3.0f;
+      float halfheight = 5.0f;
+      while(perrow*pitch>2.0f*sideLimit(halfheight,false) || rows*pitch>2.0f*halfheight-2.0f)
+      {
+        halfheight += 1.0f;
+      }
+      setupWorld(io_world,halfheight,false);
+      io_world.setToDraw(CUBE);
+      float left = -sideLimit(halfheight,false)+0.1f;
+      float top = halfheight-2.0f;
+      for(int k=0; k<cubes; ++k)
+      {
+        io_world.drawCube(left+(k%perrow)*pitch,top-(k/perrow)*pitch);
+      }
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  Result run(World &io_world, int _steps)
+  {
+    Result result;
+    result.m_steps=_steps;
+    result.m_startParticles=io_world.getAliveParticles();
+    result.m_particleSteps=0.0;
+
+    bool updateinprogress;
+    auto start = std::chrono::steady_clock::now();
+    for(int s=0; s<_steps; ++s)
+    {
+      result.m_particleSteps += io_world.getAliveParticles();
+      io_world.update(&updateinprogress);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.m_seconds=std::chrono::duration<double>(end-start).count();
+    result.m_endParticles=io_world.getAliveParticles();
+    return result;
+  }
+
+  /// Peak resident memory of the process so far in MB, see runScene() for why that is one scene's peak
+  double peakMemory()
+  {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss/(1024.0*1024.0);
+#else
+    return usage.ru_maxrss/1024.0;
+#endif
+  }
+
+  std::vector<int> parseCounts(const char *_list)
+  {
+    std::vector<int> counts;
+    std::stringstream stream(_list);
+    std::string item;
+    while(std::getline(stream,item,','))
+    {
+      int count = atoi(item.c_str());
+      if(count>0) counts.push_back(count);
+    }
+    return counts;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief runScene   sets up one scene, runs it and prints its row of the table. Returns false if the scene does
+  ///                   not exist in this mode.
+  //----------------------------------------------------------------------------------------------------------------------
+  bool runScene(const std::string &_scene, bool _3d, int _count, int _steps, bool _adaptive, bool _sleep,
+                bool _phases)
+  {
+    // World::update prints to std::cout, keep it out of the table
+    std::stringstream discard;
+
+    World world;
+    world.setAdaptiveTimestep(_adaptive);
+    world.setSleeping(_sleep);
+    std::streambuf *out = std::cout.rdbuf(discard.rdbuf());
+    bool exists = setupScene(world,_scene,_count,_3d);
+    Result result;
+    if(exists) result = run(world,_steps);
+    std::cout.rdbuf(out);
+    if(!exists) return false;
+
+    double nsperparticle = 0.0;
+    if(result.m_particleSteps>0.0) nsperparticle = result.m_seconds*1e9/result.m_particleSteps;
+    printf("%-6s %-3s %9d %9d %7d %11.1f %14.1f %10.1f\n",
+           _scene.c_str(),_3d ? "3d" : "2d",result.m_startParticles,result.m_endParticles,result.m_steps,
+           result.m_steps/result.m_seconds,nsperparticle,peakMemory());
+    if(_phases) world.getPhaseTimer().dump(std::cout);
+    std::cout.flush();
+    fflush(stdout);
+    return true;
+  }
+
+  void usage(const char *_name)
+  {
+    std::cout<<"usage: "<<_name<<" [--steps N] [--counts 1000,4000,16000] [--scene dam|rain|slime|cubes|all]"
+             <<" [--mode 2d|3d|both] [--phases] [--adaptive] [--sleep]"<<std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int steps = 200;
+  std::vector<int> counts = {1000,4000,16000};
+  std::string scene = "all";
+  std::string mode = "both";
+  bool phases = false;
+  bool adaptive = false;
+  bool sleep = false;
+
+  for(int a=1; a<argc; ++a)
+  {
+    bool hasvalue = a+1<argc;
+    if(!strcmp(argv[a],"--steps") && hasvalue) steps=atoi(argv[++a]);
+    else if(!strcmp(argv[a],"--counts") && hasvalue) counts=parseCounts(argv[++a]);
+    else if(!strcmp(argv[a],"--scene") && hasvalue) scene=argv[++a];
+    else if(!strcmp(argv[a],"--mode") && hasvalue) mode=argv[++a];
+    else if(!strcmp(argv[a],"--phases")) phases=true;
+    else if(!strcmp(argv[a],"--adaptive")) adaptive=true;
+    else if(!strcmp(argv[a],"--sleep")) sleep=true;
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if(steps<1 || counts.empty())
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> scenes = {"dam","rain","slime","cubes"};
+  if(scene!="all") scenes = {scene};
+  std::vector<bool> modes;
+  if(mode!="3d") modes.push_back(false);
+  if(mode!="2d") modes.push_back(true);
+
+  printf("%-6s %-3s %9s %9s %7s %11s %14s %10s\n",
+         "scene","dim","particles","end","steps","steps/sec","ns/particle","peak MB");
+
+  for(auto& s : scenes)
+  {
+    for(bool is3d : modes)
+    {
+      for(int count : counts)
+      {
+        // The peak resident memory of a process never goes down, so each scene runs in a child process of its own
+        // and reports its own peak rather than the largest of every scene before it
+        fflush(stdout);
+        pid_t child = fork();
+        if(child==0)
+        {
+          runScene(s,is3d,count,steps,adaptive,sleep,phases);
+          _exit(EXIT_SUCCESS);
+        }
+        else if(child>0)
+        {
+          int status;
+          waitpid(child,&status,0);
+        }
+        else
+        {
+          std::cerr<<"Could not fork, peak MB is the peak of every scene so far"<<std::endl;
+          runScene(s,is3d,count,steps,adaptive,sleep,phases);
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,514 @@
+///
+///  @file MicroBenchmark.cpp
+///  @brief micro-benchmarks for the hashing, neighbour search and meshing kernels on their own, each on the same
+///         seeded particle distributions every run so a regression in one kernel shows up by itself
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/World.h"
+
+namespace
+{
+  const int WINDOW_WIDTH = 900;
+  const int WINDOW_HEIGHT = 600;
+  const int WATER = 0;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief Random xorshift generator with its own float mapping, so the distributions are the same with every
+  ///        compiler and standard library
+  //----------------------------------------------------------------------------------------------------------------------
+  class Random
+  {
+  public:
+    Random(uint32_t _seed) : m_state(_seed ? _seed : 1u) {}
+    float uniform(float _min, float _max)
+    {
+      m_state ^= m_state<<13;
+      m_state ^= m_state>>17;
+      m_state ^= m_state<<5;
+      return _min+(_max-_min)*((m_state>>8)*(1.0f/16777216.0f));
+    }
+  private:
+    uint32_t m_state;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief positions  makes _count seeded positions. "uniform" spreads them over the whole world, "pool" packs them
+  ///                   into the bottom quarter like water that has settled.
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> positions(const std::string &_distribution, int _count, float _halfwidth, float _halfheight,
+                              bool _3d, uint32_t _seed)
+  {
+    Random random(_seed);
+    float side = _halfwidth-0.6f;
+    if(_3d) side = (_halfwidth-0.5f)*0.4f-0.05f;
+    float bottom = -_halfheight+0.6f;
+    float top = _halfheight-1.6f;
+    if(_distribution=="pool") top = bottom+(top-bottom)*0.25f;
+
+    std::vector<Vec3> result(_count);
+    for(auto& p : result)
+    {
+      float x = random.uniform(-side,side);
+      float y = random.uniform(bottom,top);
+      float z = -2.0f;
+      if(_3d) z = random.uniform(-side,side);
+      p = Vec3(x,y,z);
+    }
+    return result;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief halfHeightFor  picks a world size that gives roughly the density of drawn water for _count particles
+  ///                       spread over the whole world
+  //----------------------------------------------------------------------------------------------------------------------
+  float halfHeightFor(int _count, bool _3d)
+  {
+    float aspect = float(WINDOW_WIDTH)/float(WINDOW_HEIGHT);
+    float halfheight = 5.0f;
+    for(;;)
+    {
+      float halfwidth = halfheight*aspect;
+      float space;
+      if(_3d)
+      {
+        float side = 2.0f*((halfwidth-0.5f)*0.4f);
+        space = side*side*(2.0f*halfheight-2.2f)/0.05f;
+      }
+      else
+      {
+        space = (2.0f*halfwidth-1.2f)*(2.0f*halfheight-2.2f)/0.0625f;
+      }
+      if(space>=_count) return halfheight;
+      halfheight += 1.0f;
+    }
+  }
+
+  struct Timing
+  {
+    double m_min;
+    double m_median;
+    int m_reps;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief measure  runs _kernel once to warm up and then at least _minReps times and for at least _minSeconds.
+  ///                 Returns the fastest and median time of one call in seconds.
+  //----------------------------------------------------------------------------------------------------------------------
+  Timing measure(const std::function<void()> &_kernel, int _minReps, double _minSeconds)
+  {
+    _kernel();
+    std::vector<double> times;
+    double total = 0.0;
+    while((int)times.size()<_minReps || total<_minSeconds)
+    {
+      auto start = std::chrono::steady_clock::now();
+      _kernel();
+      auto end = std::chrono::steady_clock::now();
+      double seconds = std::chrono::duration<double>(end-start).count();
+      times.push_back(seconds);
+      total += seconds;
+    }
+    std::sort(times.begin(),times.end());
+    Timing result;
+    result.m_min=times.front();
+    result.m_median=times[times.size()/2];
+    result.m_reps=(int)times.size();
+    return result;
+  }
+
+  void report(const char *_kernel, const std::string &_distribution, bool _3d, int _count, const Timing &_t)
+  {
+    printf("%-24s %-8s %-3s %9d %6d %12.3f %12.3f %12.1f\n",
+           _kernel,_distribution.c_str(),_3d ? "3d" : "2d",_count,_t.m_reps,
+           _t.m_min*1e3,_t.m_median*1e3,_t.m_median*1e9/_count);
+    fflush(stdout);
+  }
+
+  void runKernels(const std::string &_distribution, int _count, bool _3d, uint32_t _seed, int _minReps,
+                  double _minSeconds, const std::string &_only)
+  {
+    World world;
+    world.init();
+    world.set3D(_3d);
+    world.setWorldHalfHeight(halfHeightFor(_count,_3d));
+    world.resizeWorld(WINDOW_WIDTH,WINDOW_HEIGHT);
+    world.setToDraw(WATER);
+    world.addParticles(positions(_distribution,_count,world.getHalfWidth(),world.getHalfHeight(),_3d,_seed));
+    int count = world.getAliveParticles();
+    world.publishSnapshot();
+    const RenderSnapshot &snapshot = world.getSnapshot();
+    world.resizeRender(snapshot.m_view);
+
+    // Cells to search from, one per particle in store order, which is what the update passes do
+    std::vector<int> cells;
+    for(int i=0; i<count; ++i)
+    {
+      cells.push_back(world.getGridCell(i));
+    }
+
+    // Keeps results alive so the compiler can not drop the work
+    volatile size_t sink = 0;
+    ParticleProperties *water = world.getParticleType(WATER);
+    MarchingAlgorithms &marching = world.getMarching();
+    auto wanted = [&](const char *_name){ return _only.empty() || _only==_name; };
+
+    if(wanted("hashParticles"))
+    {
+      report("hashParticles",_distribution,_3d,count,measure([&]{ world.hashParticles(); },_minReps,_minSeconds));
+    }
+
+    if(wanted("getSurroundingParticles"))
+    {
+      report("getSurroundingParticles",_distribution,_3d,count,measure([&]{
+        size_t found = 0;
+        for(int cell : cells)
+        {
+          found += world.getSurroundingParticles(cell,1,true).size();
+        }
+        sink = sink+found;
+      },_minReps,_minSeconds));
+    }
+
+    if(!_3d)
+    {
+      // The grids live in world, timing renderGrid() below fills the same one again with the same values
+      const FieldBuffer &grid = world.renderGrid(snapshot,water);
+      if(wanted("renderGrid"))
+      {
+        report("renderGrid",_distribution,_3d,count,measure([&]{
+          sink = sink+world.renderGrid(snapshot,water).size(0);
+        },_minReps,_minSeconds));
+      }
+      if(wanted("renderFields"))
+      {
+        report("renderFields",_distribution,_3d,count,measure([&]{
+          world.renderFields(snapshot,false);
+          sink = sink+world.getRenderFieldCount(WATER);
+        },_minReps,_minSeconds));
+      }
+      if(wanted("renderFieldsSerial"))
+      {
+        // Same tiles on one thread, against renderFields this is how well the tiles scale with the cores
+        world.setParallelRender(false);
+        report("renderFieldsSerial",_distribution,_3d,count,measure([&]{
+          world.renderFields(snapshot,false);
+          sink = sink+world.getRenderFieldCount(WATER);
+        },_minReps,_minSeconds));
+        world.setParallelRender(true);
+      }
+      if(wanted("renderFieldsCompact"))
+      {
+        world.setCompactMetaballs(true);
+        report("renderFieldsCompact",_distribution,_3d,count,measure([&]{
+          world.renderFields(snapshot,false);
+          sink = sink+world.getRenderFieldCount(WATER);
+        },_minReps,_minSeconds));
+        world.setCompactMetaballs(false);
+      }
+      if(wanted("calculateMarchingSquares"))
+      {
+        report("calculateMarchingSquares",_distribution,_3d,count,measure([&]{
+          marching.calculateMarchingSquares(grid,*water,false);
+          marching.calculateMarchingSquares(grid,*water,true);
+          marching.clearRealtime2DTriangles();
+        },_minReps,_minSeconds));
+      }
+    }
+    else
+    {
+      const FieldBuffer &grid = world.render3dGrid(snapshot,water);
+      if(wanted("render3dGrid"))
+      {
+        report("render3dGrid",_distribution,_3d,count,measure([&]{
+          sink = sink+world.render3dGrid(snapshot,water).size(0);
+        },_minReps,_minSeconds));
+      }
+      if(wanted("renderFields"))
+      {
+        report("renderFields",_distribution,_3d,count,measure([&]{
+          world.renderFields(snapshot,true);
+          sink = sink+world.getRenderFieldCount(WATER);
+        },_minReps,_minSeconds));
+      }
+      if(wanted("renderFieldsSerial"))
+      {
+        // Same tiles on one thread, against renderFields this is how well the tiles scale with the cores
+        world.setParallelRender(false);
+        report("renderFieldsSerial",_distribution,_3d,count,measure([&]{
+          world.renderFields(snapshot,true);
+          sink = sink+world.getRenderFieldCount(WATER);
+        },_minReps,_minSeconds));
+        world.setParallelRender(true);
+      }
+      if(wanted("calculateMarchingCubes"))
+      {
+        report("calculateMarchingCubes",_distribution,_3d,count,measure([&]{
+          marching.clearSnapshot3DTriangles();
+          marching.calculateMarchingCubes(grid,*water);
+        },_minReps,_minSeconds));
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief contourShift   compares where _a and _b cross _threshold. Returns the samples on different sides of it
+  ///                       divided by the samples of _a on its edge, roughly how far apart the two contours are on
+  ///                       average in render samples.
+  //----------------------------------------------------------------------------------------------------------------------
+  double contourShift(const FieldBuffer &_a, const FieldBuffer &_b, float _threshold)
+  {
+    int mismatched = 0;
+    int edge = 0;
+    for(int row=1; row<_a.size(0)-1; ++row)
+    {
+      for(int column=1; column<_a.size(1)-1; ++column)
+      {
+        bool inside = _a.at(row,column)>_threshold;
+        if(inside!=(_b.at(row,column)>_threshold)) ++mismatched;
+        if(inside && (_a.at(row-1,column)<=_threshold || _a.at(row+1,column)<=_threshold ||
+                      _a.at(row,column-1)<=_threshold || _a.at(row,column+1)<=_threshold)) ++edge;
+      }
+    }
+    return edge ? double(mismatched)/edge : 0.0;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief checkMetaballs builds the 2D grids of _count particles with the original and the compact metaball and
+  ///                       checks their outer and inner contours are on average less than a render sample apart.
+  ///                       Also checks the SIMD paths of MetaballKernel give the same values as the scalar one.
+  /// \return              false if either check fails
+  //----------------------------------------------------------------------------------------------------------------------
+  bool checkMetaballs(const std::string &_distribution, int _count, uint32_t _seed)
+  {
+    const double maxShift = 1.0;
+    const float maxPathError = 1e-5f;
+
+    World world;
+    world.init();
+    world.setWorldHalfHeight(halfHeightFor(_count,false));
+    world.resizeWorld(WINDOW_WIDTH,WINDOW_HEIGHT);
+    world.setToDraw(WATER);
+    world.addParticles(positions(_distribution,_count,world.getHalfWidth(),world.getHalfHeight(),false,_seed));
+    // Let the particles spread out like real fluid rather than contour the raw random positions
+    bool updating;
+    for(int step=0; step<50; ++step)
+    {
+      world.update(&updating);
+    }
+    const RenderSnapshot &snapshot = world.getSnapshot();
+    world.resizeRender(snapshot.m_view);
+
+    world.setCompactMetaballs(false);
+    world.renderFields(snapshot,false);
+    FieldBuffer original = world.getRenderField(WATER);
+    world.setCompactMetaballs(true);
+    world.renderFields(snapshot,false);
+    const FieldBuffer &compact = world.getRenderField(WATER);
+
+    // Outer and inner contours, see MarchingAlgorithms::calculateMarchingSquares
+    float threshold = world.getRender2DThreshold();
+    double outer = contourShift(original,compact,threshold);
+    double inner = contourShift(original,compact,0.7f*threshold);
+
+    // Every path on the same rows, relative to the threshold as that is the scale the contours care about
+    MetaballKernel kernel;
+    kernel.set(1.0f,1.0f,threshold);
+    float patherror = 0.0f;
+    for(int path=MetaballKernel::SSE; path<=MetaballKernel::bestPath(); ++path)
+    {
+      for(int row=0; row<16; ++row)
+      {
+        std::vector<float> expected(37,1.0f), actual(37,1.0f);
+        float dy = -1.6f+0.2f*row;
+        kernel.setPath(MetaballKernel::SCALAR);
+        kernel.addRow(expected.data(),(int)expected.size(),-1.7f,0.09f,dy*dy);
+        kernel.setPath((MetaballKernel::Path)path);
+        kernel.addRow(actual.data(),(int)actual.size(),-1.7f,0.09f,dy*dy);
+        for(size_t k=0; k<expected.size(); ++k)
+        {
+          patherror = std::max(patherror,std::abs(expected[k]-actual[k])/threshold);
+        }
+      }
+    }
+
+    bool pass = outer<maxShift && inner<maxShift && patherror<maxPathError;
+    printf("%-24s %-8s %-3s %9d  outer %.3f inner %.3f samples  simd %.1e  %s\n",
+           "compactMetaballs",_distribution.c_str(),"2d",world.getAliveParticles(),outer,inner,patherror,
+           pass ? "ok" : "FAILED");
+    fflush(stdout);
+    return pass;
+  }
+
+  /// Slots of the alive particles of _world sorted by particle id
+  std::vector<int> slotsById(const World &_world)
+  {
+    const ParticleStore &particles = _world.getParticles();
+    std::vector<int> slots;
+    for(int i=0; i<_world.getParticlePoolSize(); ++i)
+    {
+      if(particles.getAlive(i)) slots.push_back(i);
+    }
+    std::sort(slots.begin(),slots.end(),[&particles](int _a, int _b) { return particles.m_id[_a]<particles.m_id[_b]; });
+    return slots;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief checkCheckpoint saves a world straight after inserting particles, before a hash has given them a cell,
+  ///                        loads it into a second world and checks every particle came back where it was and is
+  ///                        in the slot range of its own cell
+  /// \return                false if the save or load fails or any particle is lost or in the wrong cell
+  //----------------------------------------------------------------------------------------------------------------------
+  bool checkCheckpoint(int _count, uint32_t _seed)
+  {
+    const char *path = "microbenchmark.ppck";
+
+    World world;
+    world.init();
+    world.setWorldHalfHeight(halfHeightFor(_count,false));
+    world.resizeWorld(WINDOW_WIDTH,WINDOW_HEIGHT);
+    world.setToDraw(WATER);
+    world.addParticles(positions("pool",_count,world.getHalfWidth(),world.getHalfHeight(),false,_seed));
+    bool updating;
+    for(int step=0; step<20; ++step)
+    {
+      world.update(&updating);
+    }
+    world.drawCube();
+    bool saved = world.saveCheckpoint(path);
+
+    World loaded;
+    loaded.init();
+    loaded.resizeWorld(WINDOW_WIDTH,WINDOW_HEIGHT);
+    bool restored = saved && loaded.loadCheckpoint(path);
+    std::remove(path);
+
+    int lost = 0;
+    int misplaced = 0;
+    if(restored)
+    {
+      std::vector<int> before = slotsById(world);
+      std::vector<int> after = slotsById(loaded);
+      const ParticleStore &a = world.getParticles();
+      const ParticleStore &b = loaded.getParticles();
+      lost = std::abs((int)before.size()-(int)after.size());
+      for(size_t k=0; k<std::min(before.size(),after.size()); ++k)
+      {
+        int i = before[k];
+        int j = after[k];
+        if(a.m_id[i]!=b.m_id[j] || a.m_x[i]!=b.m_x[j] || a.m_y[i]!=b.m_y[j] || a.m_z[i]!=b.m_z[j]) ++lost;
+
+        int first, last;
+        loaded.getCellRange(loaded.getGridCell(j),first,last);
+        if(j<first || j>=last) ++misplaced;
+      }
+    }
+
+    bool pass = restored && lost==0 && misplaced==0;
+    printf("%-24s %-8s %-3s %9d  lost %d misplaced %d  %s\n",
+           "checkpointAfterInsert","pool","2d",world.getAliveParticles(),lost,misplaced,pass ? "ok" : "FAILED");
+    fflush(stdout);
+    return pass;
+  }
+
+  std::vector<int> parseCounts(const char *_list)
+  {
+    std::vector<int> counts;
+    std::stringstream stream(_list);
+    std::string item;
+    while(std::getline(stream,item,','))
+    {
+      int count = atoi(item.c_str());
+      if(count>0) counts.push_back(count);
+    }
+    return counts;
+  }
+
+  void usage(const char *_name)
+  {
+    std::cout<<"usage: "<<_name<<" [--counts 1000,4000,16000] [--seed N] [--reps N] [--seconds S]"
+             <<" [--kernel name] [--mode 2d|3d|both] [--check]"<<std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<int> counts = {1000,4000,16000};
+  uint32_t seed = 12345;
+  int minreps = 5;
+  double minseconds = 0.2;
+  std::string kernel;
+  std::string mode = "both";
+  bool check = false;
+
+  for(int a=1; a<argc; ++a)
+  {
+    bool hasvalue = a+1<argc;
+    if(!strcmp(argv[a],"--counts") && hasvalue) counts=parseCounts(argv[++a]);
+    else if(!strcmp(argv[a],"--seed") && hasvalue) seed=(uint32_t)strtoul(argv[++a],nullptr,10);
+    else if(!strcmp(argv[a],"--reps") && hasvalue) minreps=atoi(argv[++a]);
+    else if(!strcmp(argv[a],"--seconds") && hasvalue) minseconds=atof(argv[++a]);
+    else if(!strcmp(argv[a],"--kernel") && hasvalue) kernel=argv[++a];
+    else if(!strcmp(argv[a],"--mode") && hasvalue) mode=argv[++a];
+    else if(!strcmp(argv[a],"--check")) check=true;
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if(counts.empty() || minreps<1)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(check)
+  {
+    // Accuracy of the approximations instead of timings
+    bool pass = true;
+    for(const char *distribution : {"uniform","pool"})
+    {
+      for(int count : counts)
+      {
+        pass = checkMetaballs(distribution,count,seed) && pass;
+      }
+    }
+    for(int count : counts)
+    {
+      pass = checkCheckpoint(count,seed) && pass;
+    }
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  printf("%-24s %-8s %-3s %9s %6s %12s %12s %12s\n",
+         "kernel","dist","dim","particles","reps","min ms","median ms","ns/particle");
+
+  std::vector<bool> modes;
+  if(mode!="3d") modes.push_back(false);
+  if(mode!="2d") modes.push_back(true);
+
+  for(bool is3d : modes)
+  {
+    for(const char *distribution : {"uniform","pool"})
+    {
+      for(int count : counts)
+      {
+        runKernels(distribution,count,is3d,seed,minreps,minseconds,kernel);
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
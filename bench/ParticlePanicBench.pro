@@ -0,0 +1,15 @@
+# Headless benchmark: runs the canonical scenes through World::update without a window and prints
+# steps/sec, ns per particle-step and peak memory. Build ../core first, this links against its library.
+TEMPLATE = app
+TARGET = ParticlePanicBench
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+INCLUDEPATH += ..
+OBJECTS_DIR = obj
+
+QMAKE_CXXFLAGS += -std=c++11 -fopenmp
+LIBS += -L$$PWD/../lib -lParticlePanicCore -fopenmp -pthread
+PRE_TARGETDEPS += $$PWD/../lib/libParticlePanicCore.a
+
+SOURCES += Benchmark.cpp
@@ -0,0 +1,20 @@
+# Micro-benchmarks for hashParticles, getSurroundingParticles, renderGrid, render3dGrid and the marching
+# squares / cubes on fixed seeded particle distributions. Build ../core first, this links against its library.
+# "make bench" builds and runs them.
+TEMPLATE = app
+TARGET = ParticlePanicMicroBench
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+INCLUDEPATH += ..
+OBJECTS_DIR = obj
+
+QMAKE_CXXFLAGS += -std=c++11 -fopenmp
+LIBS += -L$$PWD/../lib -lParticlePanicCore -fopenmp -pthread
+PRE_TARGETDEPS += $$PWD/../lib/libParticlePanicCore.a
+
+SOURCES += MicroBenchmark.cpp
+
+bench.commands = ./$$TARGET
+bench.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += bench
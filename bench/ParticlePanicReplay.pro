@@ -0,0 +1,15 @@
+# Replays a command log recorded with "ParticlePanic --record <file>" through the simulation without a window and
+# prints the time it took and a checksum of the final particles. Build ../core first, this links against its library.
+TEMPLATE = app
+TARGET = ParticlePanicReplay
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+INCLUDEPATH += ..
+OBJECTS_DIR = obj
+
+QMAKE_CXXFLAGS += -std=c++11 -fopenmp
+LIBS += -L$$PWD/../lib -lParticlePanicCore -fopenmp -pthread
+PRE_TARGETDEPS += $$PWD/../lib/libParticlePanicCore.a
+
+SOURCES += Replay.cpp
@@ -0,0 +1,270 @@
+///
+///  @file Replay.cpp
+///  @brief plays a command log recorded with "ParticlePanic --record <file>" through a headless World and reports
+///         how long it took, so a real session can be used as a performance regression scenario
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "include/World.h"
+#include "include/CommandLog.h"
+#include "include/Trajectory.h"
+
+namespace
+{
+  /// FNV-1a over the bits of the particle positions, two replays of the same log must print the same value
+  unsigned long long checksum(const RenderSnapshot &_snapshot)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    const std::vector<float> *arrays[3] = {&_snapshot.m_x, &_snapshot.m_y, &_snapshot.m_z};
+    for(auto& array : arrays)
+    {
+      for(int i=0; i<_snapshot.m_count; ++i)
+      {
+        unsigned int bits;
+        memcpy(&bits,&(*array)[i],sizeof(bits));
+        for(int b=0; b<4; ++b)
+        {
+          hash ^= (bits>>(8*b))&0xff;
+          hash *= 1099511628211ULL;
+        }
+      }
+    }
+    return hash;
+  }
+
+  /// Frames --verify keeps exact copies of to read back in random order
+  const int s_randomFrames = 32;
+
+  /// Copies the alive particles of _particles into o_frame sorted by id, the order TrajectoryReader gives them in
+  void capture(const ParticleStore &_particles, int _slots, long _step, TrajectoryFrame &o_frame)
+  {
+    std::vector<int> order;
+    for(int i=0; i<_slots; ++i)
+    {
+      if(_particles.getAlive(i)) order.push_back(i);
+    }
+    std::sort(order.begin(),order.end(),[&_particles](int _a, int _b) { return _particles.m_id[_a]<_particles.m_id[_b]; });
+
+    o_frame.resize((int)order.size());
+    o_frame.m_step=_step;
+    for(int k=0; k<o_frame.m_count; ++k)
+    {
+      int i = order[k];
+      o_frame.m_id[k]=_particles.m_id[i];
+      o_frame.m_type[k]=_particles.m_type[i];
+      o_frame.m_x[k]=_particles.m_x[i];
+      o_frame.m_y[k]=_particles.m_y[i];
+      o_frame.m_z[k]=_particles.m_z[i];
+      o_frame.m_velx[k]=_particles.m_velx[i];
+      o_frame.m_vely[k]=_particles.m_vely[i];
+      o_frame.m_velz[k]=_particles.m_velz[i];
+    }
+  }
+
+  /// Rounding to the step is off by at most half of it, plus the float error of scaling the value there and back
+  bool close(float _read, float _exact, float _step)
+  {
+    return std::fabs(_read-_exact)<=0.5f*_step+2.0f*FLT_EPSILON*std::fabs(_exact);
+  }
+
+  /// Counts the values of _read that are not where _exact is, and prints the first few
+  long compare(const TrajectoryFrame &_read, const TrajectoryFrame &_exact, float _positionStep, float _velocityStep,
+               int _frame, long &io_reported)
+  {
+    long bad = 0;
+    if(_read.m_count!=_exact.m_count || _read.m_step!=_exact.m_step)
+    {
+      bad=1;
+    }
+    else
+    {
+      for(int k=0; k<_exact.m_count; ++k)
+      {
+        bool ok = _read.m_id[k]==_exact.m_id[k] && _read.m_type[k]==_exact.m_type[k] &&
+                  close(_read.m_x[k],_exact.m_x[k],_positionStep) &&
+                  close(_read.m_y[k],_exact.m_y[k],_positionStep) &&
+                  close(_read.m_z[k],_exact.m_z[k],_positionStep) &&
+                  close(_read.m_velx[k],_exact.m_velx[k],_velocityStep) &&
+                  close(_read.m_vely[k],_exact.m_vely[k],_velocityStep) &&
+                  close(_read.m_velz[k],_exact.m_velz[k],_velocityStep);
+        if(!ok) ++bad;
+      }
+    }
+    if(bad && io_reported++<10)
+    {
+      printf("frame %d (step %ld): %ld particles differ, %d read against %d\n",
+             _frame,_exact.m_step,bad,_read.m_count,_exact.m_count);
+    }
+    return bad;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// Plays _log again, which lands on the same particles every step, and checks the frames of _trajectory against
+  /// them: every frame in order while the world runs, then s_randomFrames of them in random order afterwards
+  //----------------------------------------------------------------------------------------------------------------------
+  bool verify(const char *_log, const char *_trajectory)
+  {
+    TrajectoryReader reader;
+    CommandReplayer replayer;
+    if(!reader.open(_trajectory) || !replayer.open(_log))
+    {
+      printf("verify: could not open %s\n",_trajectory);
+      return false;
+    }
+    int frames = reader.getFrameCount();
+    float positionStep = reader.getPositionStep();
+    float velocityStep = reader.getVelocityStep();
+
+    std::mt19937 random(1234);
+    std::vector<int> picked;
+    for(int f=0; f<frames && (int)picked.size()<s_randomFrames; ++f)
+    {
+      // Every frame has the same chance of being picked
+      if(std::uniform_int_distribution<int>(0,frames-f-1)(random)<s_randomFrames-(int)picked.size()) picked.push_back(f);
+    }
+    std::vector<TrajectoryFrame> exact(picked.size());
+
+    std::stringstream discard;
+    std::streambuf *out = std::cout.rdbuf(discard.rdbuf());
+
+    World world;
+    replayer.start(world);
+    TrajectoryFrame read, current;
+    long bad = 0;
+    long reported = 0;
+    int frame = 0;
+    size_t next = 0;
+    bool updateinprogress;
+    while(!replayer.finished(world) && frame<frames)
+    {
+      replayer.execute(world);
+      world.update(&updateinprogress);
+      // Frames the writer dropped have no chunk, so only some steps have a frame
+      if(reader.getStep(frame)!=world.getStep()) continue;
+
+      capture(world.getParticles(),world.getParticlePoolSize(),world.getStep(),current);
+      if(!reader.read(frame,read))
+      {
+        bad+=current.m_count;
+        printf("frame %d: could not be read\n",frame);
+      }
+      else
+      {
+        bad+=compare(read,current,positionStep,velocityStep,frame,reported);
+      }
+      if(next<picked.size() && picked[next]==frame) exact[next++]=current;
+      ++frame;
+    }
+    std::cout.rdbuf(out);
+
+    std::vector<int> order(next);
+    for(size_t k=0; k<next; ++k) order[k]=(int)k;
+    std::shuffle(order.begin(),order.end(),random);
+    for(int k : order)
+    {
+      if(!reader.read(picked[k],read))
+      {
+        bad+=exact[k].m_count;
+        printf("frame %d: could not be read\n",picked[k]);
+      }
+      else
+      {
+        bad+=compare(read,exact[k],positionStep,velocityStep,picked[k],reported);
+      }
+    }
+
+    printf("verify: %d of %d frames in order and %zu at random, %ld particles off by more than half a step\n",
+           frame,frames,next,bad);
+    return bad==0 && frame==frames;
+  }
+
+  void usage(const char *_name)
+  {
+    std::cout<<"usage: "<<_name<<" <command log> [--phases] [--trajectory <file> [--verify]]"<<std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if(argc<2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  bool phases = false;
+  bool verifyTrajectory = false;
+  const char *trajectoryPath = nullptr;
+  for(int a=2; a<argc; ++a)
+  {
+    if(!strcmp(argv[a],"--phases")) phases=true;
+    else if(!strcmp(argv[a],"--trajectory") && a+1<argc) trajectoryPath=argv[++a];
+    else if(!strcmp(argv[a],"--verify")) verifyTrajectory=true;
+    else
+    {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if(verifyTrajectory && !trajectoryPath)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  CommandReplayer replayer;
+  if(!replayer.open(argv[1])) return EXIT_FAILURE;
+
+  // World::update prints to std::cout, keep it out of the report
+  std::stringstream discard;
+  std::streambuf *out = std::cout.rdbuf(discard.rdbuf());
+
+  World world;
+  replayer.start(world);
+
+  TrajectoryWriter trajectory;
+  if(trajectoryPath)
+  {
+    if(!trajectory.open(trajectoryPath)) return EXIT_FAILURE;
+    world.setTrajectory(&trajectory);
+  }
+
+  bool updateinprogress;
+  double particleSteps = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  while(!replayer.finished(world))
+  {
+    replayer.execute(world);
+    particleSteps += world.getAliveParticles();
+    world.update(&updateinprogress);
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout.rdbuf(out);
+  long dropped = trajectory.getDroppedFrames();
+  trajectory.close();
+
+  double seconds = std::chrono::duration<double>(end-start).count();
+  printf("%s: %zu commands over %ld steps, %d particles at the end\n",
+         argv[1],replayer.getCommandCount(),world.getStep(),world.getAliveParticles());
+  printf("%.3f s, %.1f steps/sec, %.1f ns/particle-step\n",seconds,world.getStep()/seconds,
+         particleSteps>0.0 ? seconds*1e9/particleSteps : 0.0);
+  printf("checksum %016llx\n",checksum(world.getSnapshot()));
+  if(trajectoryPath)
+  {
+    printf("trajectory %s: %ld frames written, %ld dropped\n",trajectoryPath,trajectory.getWrittenFrames(),dropped);
+  }
+  if(phases) world.getPhaseTimer().dump(std::cout);
+
+  if(verifyTrajectory && !verify(argv[1],trajectoryPath)) return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
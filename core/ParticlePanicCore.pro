@@ -0,0 +1,54 @@
+# Simulation core of ParticlePanic: particles, springs, spatial hash, update and the render fields for
+# marching squares / cubes. Has no OpenGL or SDL dependency so it can run without a window.
+# Build this first, ParticlePanic.pro links against the library it puts in ../lib
+TEMPLATE = lib
+TARGET = ParticlePanicCore
+CONFIG += staticlib
+CONFIG += c++11
+CONFIG -= qt
+INCLUDEPATH += ..
+OBJECTS_DIR = obj
+DESTDIR = ../lib
+
+QMAKE_CXXFLAGS += -std=c++11 -fopenmp -pthread
+
+SOURCES += \
+    ../src/Vec3.cpp \
+    ../src/Mat3.cpp \
+    ../src/Particle.cpp \
+    ../src/ParticleStore.cpp \
+    ../src/NeighbourList.cpp \
+    ../src/SpringHash.cpp \
+    ../src/CellHash.cpp \
+    ../src/PhaseTimer.cpp \
+    ../src/SimulationThread.cpp \
+    ../src/Commands.cpp \
+    ../src/CommandLog.cpp \
+    ../src/Checkpoint.cpp \
+    ../src/Trajectory.cpp \
+    ../src/MetaballKernel.cpp \
+    ../src/World.cpp \
+    ../src/ParticleProperties.cpp \
+    ../src/MarchingAlgorithms.cpp
+
+HEADERS += \
+    ../include/Particle.h \
+    ../include/ParticleStore.h \
+    ../include/NeighbourList.h \
+    ../include/SpringHash.h \
+    ../include/CellHash.h \
+    ../include/PhaseTimer.h \
+    ../include/RenderSnapshot.h \
+    ../include/TripleBuffer.h \
+    ../include/SimulationThread.h \
+    ../include/Commands.h \
+    ../include/CommandLog.h \
+    ../include/Checkpoint.h \
+    ../include/Trajectory.h \
+    ../include/FieldBuffer.h \
+    ../include/MetaballKernel.h \
+    ../include/Vec3.h \
+    ../include/Mat3.h \
+    ../include/World.h \
+    ../include/ParticleProperties.h \
+    ../include/MarchingAlgorithms.h
@@ -0,0 +1,65 @@
+/// \file CellHash.h
+/// \brief open addressing hash table from a grid cell to its place in the list of occupied cells
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _CELLHASH_H_
+#define _CELLHASH_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CellHash class maps a grid cell index to a value, used by the sparse spatial hash so that only cells
+///        with particles in them take any memory. Collisions are resolved with linear probing and the table is kept
+///        at most half full. There is no erase, the table is cleared and refilled every World::hashParticles().
+//----------------------------------------------------------------------------------------------------------------------
+class CellHash
+{
+public:
+  CellHash();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief clear      removes every entry and makes room for _expected entries without growing
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear(int _expected=0);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief find       returns the value stored for _cell or -1 if there is none
+  //----------------------------------------------------------------------------------------------------------------------
+  int find(int _cell) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief insert     stores _value for _cell, replacing any value already there. _cell must not be negative.
+  //----------------------------------------------------------------------------------------------------------------------
+  void insert(int _cell, int _value);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief size returns the number of entries
+  //----------------------------------------------------------------------------------------------------------------------
+  int size() const { return m_size; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief capacity returns the number of slots in the table, for measuring memory
+  //----------------------------------------------------------------------------------------------------------------------
+  int capacity() const { return (int)m_table.size(); }
+
+private:
+  struct Entry
+  {
+    int cell;
+    int value;
+  };
+
+  static uint32_t mix(uint32_t _cell);
+  void grow();
+
+  std::vector<Entry> m_table;
+  uint32_t m_mask;
+  int m_size;
+};
+
+#endif // _CELLHASH_H_
@@ -0,0 +1,111 @@
+/// \file Checkpoint.h
+/// \brief binary layout of a world checkpoint and the reader / writer for its sections, used by
+///        World::saveCheckpoint() and World::loadCheckpoint()
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief CheckpointHeader is the start of a checkpoint file. The arrays follow it in a fixed order, each one
+///        starting on an 8 byte boundary and stored exactly as it is in memory, so the file could be memory mapped
+///        and every array is restored with one copy:
+///          x, y, z, prevx, prevy, prevz, velx, vely, velz  float[m_particles]
+///          type                                            int32[m_particles]
+///          grid cell                                       int32[m_particles]
+///          id                                              int32[m_particles]
+///          flags                                           uint8[m_particles]
+///          springs                                         Particle::Spring[m_springs]
+///          free springs                                    int32[m_freeSprings]
+///          particle types                                  float[13*m_types], see World::saveCheckpoint()
+///        The grid cell is -1 for a particle inserted since the last hash. The springs of each particle are not
+///        stored, World lists them again from the springs when it needs them.
+///        Bump s_version whenever any of this changes, older files are then refused rather than misread.
+//----------------------------------------------------------------------------------------------------------------------
+struct CheckpointHeader
+{
+  static const uint32_t s_version = 3;
+  static const uint32_t s_byteOrder = 0x01020304;
+
+  char m_magic[4];
+  uint32_t m_version;
+  uint32_t m_headerSize;
+  uint32_t m_byteOrder;
+
+  int32_t m_particles;
+  int32_t m_springs;
+  int32_t m_freeSprings;
+  int32_t m_types;
+
+  int32_t m_gridwidth, m_gridheight, m_griddepth;
+  float m_halfwidth, m_halfheight, m_worldHalfHeight;
+  float m_interactionradius, m_squaresize, m_pointsize;
+  float m_boundaryMultiplier;
+  int32_t m_boundaryType;
+  int32_t m_todraw;
+  int32_t m_substepCount;
+  double m_timestep;
+  int64_t m_step;
+
+  uint8_t m_3d, m_gravity, m_rain, m_drawwall;
+  int32_t m_nextParticleId;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CheckpointWriter class writes the header and then each array padded to 8 bytes. The file is written
+///        next to _path and only renamed over it once complete, so a failed save never leaves half a checkpoint.
+//----------------------------------------------------------------------------------------------------------------------
+class CheckpointWriter
+{
+public:
+  bool open(const std::string &_path);
+  void write(const void *_data, size_t _bytes);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief close  finishes the file, returns false if anything failed to write
+  //----------------------------------------------------------------------------------------------------------------------
+  bool close();
+
+private:
+  std::ofstream m_file;
+  std::string m_path;
+  std::string m_temporary;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CheckpointReader class reads a whole checkpoint in one go and hands out its arrays in order, checking
+///        each one fits inside the file
+//----------------------------------------------------------------------------------------------------------------------
+class CheckpointReader
+{
+public:
+  CheckpointReader() : m_position(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief open       reads the file and checks its header, returns false and says why if it can't be used
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path);
+
+  const CheckpointHeader &header() const { return m_header; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief read       returns the next array of _bytes bytes, or nullptr if the file is too short
+  //----------------------------------------------------------------------------------------------------------------------
+  const void *read(size_t _bytes);
+
+private:
+  std::vector<char> m_data;
+  CheckpointHeader m_header;
+  size_t m_position;
+};
+
+#endif // _CHECKPOINT_H_
@@ -0,0 +1,130 @@
+/// \file CommandLog.h
+/// \brief records the Commands given to a World to a compact binary log and replays them, so that a session can be
+///        captured once and run again headless as a repeatable performance scenario
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _COMMANDLOG_H_
+#define _COMMANDLOG_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "include/Commands.h"
+
+class World;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The log starts with the magic "PPCL", a version byte and the window size the world was first resized to.
+///        Each command follows as the number of steps since the previous one, its type as one byte and its four
+///        arguments, all as variable length integers so a typical mouse command takes about 8 bytes. The log ends
+///        with an END record stamped with the step the recording stopped at.
+//----------------------------------------------------------------------------------------------------------------------
+namespace CommandLog
+{
+  const char s_magic[4] = {'P','P','C','L'};
+  const uint8_t s_version = 1;
+  const uint8_t s_end = 0xff;
+
+  /// The 'k' and 'l' keys save and load checkpoint.ppck, which a log can't carry, so they are never recorded
+  inline bool isCheckpointKey(const Command &_command)
+  {
+    return _command.m_type==Command::HANDLE_KEY && (_command.m_x=='k' || _command.m_x=='l');
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CommandRecorder class writes commands to a log as they are executed. Hand it to
+///        CommandQueue::setRecorder() so it sees every command on the simulation thread, in order. Checkpoint saves
+///        are left out and a checkpoint load ends the log, see CommandLog::isCheckpointKey().
+//----------------------------------------------------------------------------------------------------------------------
+class CommandRecorder
+{
+public:
+  CommandRecorder() : m_lastStep(0) {}
+  ~CommandRecorder();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief open       starts a new log
+  /// \param[in] _path  file to write
+  /// \param[in] _w     width in pixels the world is resized to before step 0
+  /// \param[in] _h     height in pixels
+  /// \return           false if the file could not be opened
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path, int _w, int _h);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief record         appends a command
+  /// \param[in] _step      number of World::update() calls made before the command runs
+  /// \param[in] _command   the command
+  //----------------------------------------------------------------------------------------------------------------------
+  void record(long _step, const Command &_command);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief close      writes the END record and closes the file
+  /// \param[in] _step  the step the recording stopped at, a replay runs up to here
+  //----------------------------------------------------------------------------------------------------------------------
+  void close(long _step);
+
+  bool isOpen() const { return m_file.is_open(); }
+
+private:
+  void writeVarint(uint64_t _value);
+  void writeSigned(int64_t _value);
+
+  std::ofstream m_file;
+  long m_lastStep;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CommandReplayer class reads a whole log and executes each command on a World at the step it was
+///        recorded at. The replay is exact as long as the adaptive timestep has no frame budget, see
+///        World::setFrameBudget(), as that depends on the wall-clock time of the substeps.
+//----------------------------------------------------------------------------------------------------------------------
+class CommandReplayer
+{
+public:
+  CommandReplayer() : m_width(0), m_height(0), m_endStep(0), m_next(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief open       reads a log
+  /// \param[in] _path  file to read
+  /// \return           false if the file is missing, is not a command log or saves or loads a checkpoint
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief start  initialises _world and resizes it like the recorded one
+  //----------------------------------------------------------------------------------------------------------------------
+  void start(World &_world);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief execute  executes the commands recorded for the step _world is at, call before each World::update()
+  /// \return         how many commands were executed
+  //----------------------------------------------------------------------------------------------------------------------
+  int execute(World &_world);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief finished returns true once _world has reached the step the recording stopped at
+  //----------------------------------------------------------------------------------------------------------------------
+  bool finished(const World &_world) const;
+
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+  long getEndStep() const { return m_endStep; }
+  size_t getCommandCount() const { return m_commands.size(); }
+
+private:
+  int m_width, m_height;
+  long m_endStep;
+
+  std::vector<long> m_steps;
+  std::vector<Command> m_commands;
+  size_t m_next;
+};
+
+#endif // _COMMANDLOG_H_
@@ -1,6 +1,6 @@
 /// \file Commands.h
-/// \brief Command  objects to be executed inside timerCallback in main. The purpose of this is to
-///                 make sure the commands are not executed in the middle of update() when outside the timer
+/// \brief Commands from the main loop to the world, passed to the simulation thread through a lock-free queue.
+///        The purpose of this is to make sure the commands are not executed in the middle of update().
 /// \author Thomas Collingwood
 /// \version 1.0
 /// \date 26/4/16 Updated to NCCA Coding standard
@@ -9,129 +9,105 @@
 #ifndef _COMMANDS_H_
 #define _COMMANDS_H_
 
-#include "include/World.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
 
-class Command
-{
-public:
-  ~Command() {}
-  virtual void execute() = 0;
-  void setWorld(World *_world) { m_world=_world; }
-protected:
-  World *m_world;
-};
-
-class ClearWorld : public Command
-{
-public:
-  ClearWorld(){}
-  ~ClearWorld(){}
-  void execute() {m_world->clearWorld();}
-};
+class World;
+class CommandRecorder;
 
-class MouseErase : public Command
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The Command struct is a plain value: what to do and its arguments. Mouse commands use x and y in pixels,
+///        RESIZE_WORLD uses w and h, SET_3D uses x as a bool, HANDLE_KEY uses x as the character,
+///        SET_RANDOM_TYPE uses x as the seed and SET_TO_DRAW uses x as the particle type. New types go at the end
+///        as the numbers are stored in command logs, see CommandLog.h.
+//----------------------------------------------------------------------------------------------------------------------
+struct Command
 {
-public:
-  MouseErase(){}
-  ~MouseErase(){}
-  void execute() {m_world->mouseErase(m_x,m_y);}
-  void setxy(int _x, int _y)
+  enum Type
   {
-    m_x=_x;
-    m_y=_y;
-  }
-private:
-  int m_x, m_y;
-};
+    CLEAR_WORLD,
+    MOUSE_ERASE,
+    MOUSE_DRAW,
+    MOUSE_DRAG,
+    SELECT_DRAGGED_PARTICLES,
+    MOUSE_DRAG_END,
+    RESIZE_WORLD,
+    SET_3D,
+    HANDLE_KEY,
+    SET_RANDOM_TYPE,
+    TOGGLE_RAIN,
+    TOGGLE_GRAVITY,
+    SET_TO_DRAW
+  };
 
-class MouseDraw : public Command
-{
-public:
-  MouseDraw(){}
-  ~MouseDraw(){}
-  void execute() {m_world->mouseDraw(m_x,m_y);}
-  void setxy(int _x, int _y)
-  {
-    m_x=_x;
-    m_y=_y;
-  }
-private:
-  int m_x, m_y;
-};
+  Command() : m_type(CLEAR_WORLD), m_x(0), m_y(0), m_w(0), m_h(0) {}
+  Command(Type _type, int _x=0, int _y=0, int _w=0, int _h=0) :
+    m_type(_type), m_x(_x), m_y(_y), m_w(_w), m_h(_h) {}
 
-class MouseDrag : public Command
-{
-public:
-  MouseDrag(){}
-  ~MouseDrag(){}
-  void execute() {m_world->mouseDrag(m_x,m_y);}
-  void setxy(int _x, int _y)
-  {
-    m_x=_x;
-    m_y=_y;
-  }
-private:
-  int m_x, m_y;
-};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief execute    runs the command on _world
+  //----------------------------------------------------------------------------------------------------------------------
+  void execute(World &_world) const;
 
-class SelectDraggedParticles : public Command
-{
-public:
-  SelectDraggedParticles(){}
-  ~SelectDraggedParticles(){}
-  void execute() {m_world->selectDraggedParticles(m_x,m_y);}
-  void setxy(int _x, int _y)
-  {
-    m_x=_x;
-    m_y=_y;
-  }
-private:
+  Type m_type;
   int m_x, m_y;
+  int m_w, m_h;
 };
 
-class MouseDragEnd : public Command
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The CommandQueue class is a bounded single-producer / single-consumer ring of Commands. The main loop
+///        pushes and the simulation thread pops, neither ever blocks or allocates. When the ring is full push()
+///        drops the command and counts it.
+//----------------------------------------------------------------------------------------------------------------------
+class CommandQueue
 {
 public:
-  MouseDragEnd(){}
-  ~MouseDragEnd(){}
-  void execute() {m_world->mouseDragEnd(m_x,m_y);}
-  void setxy(int _x, int _y)
-  {
-    m_x=_x;
-    m_y=_y;
-  }
-private:
-  int m_x, m_y;
-};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief CommandQueue   constructor
+  /// \param[in] _capacity  most commands waiting at once, rounded up to a power of two
+  //----------------------------------------------------------------------------------------------------------------------
+  CommandQueue(size_t _capacity=1024);
 
-class ResizeWorld : public Command
-{
-public:
-  ResizeWorld(){}
-  ~ResizeWorld(){}
-  void execute() {m_world->resizeWorld(m_w,m_h);}
-  void setwh(int _w, int _h)
-  {
-    m_w=_w;
-    m_h=_h;
-  }
-private:
-  int m_w, m_h;
-};
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief push   adds a command, returns false if the queue was full. Producer thread only.
+  //----------------------------------------------------------------------------------------------------------------------
+  bool push(const Command &_command);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief pop          takes the oldest command, returns false if there was none. Consumer thread only.
+  /// \param[out] o_command the command
+  //----------------------------------------------------------------------------------------------------------------------
+  bool pop(Command &o_command);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief execute  pops and executes every command waiting, called before each step. Consumer thread only.
+  /// \return         how many commands were executed
+  //----------------------------------------------------------------------------------------------------------------------
+  int execute(World &_world);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getDropped returns how many commands were dropped because the queue was full
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief setRecorder  execute() passes every command to _recorder, stamped with the world's step, before running
+  ///                     it. nullptr to stop recording. Set it before the consumer thread starts.
+  //----------------------------------------------------------------------------------------------------------------------
+  void setRecorder(CommandRecorder *_recorder) { m_recorder=_recorder; }
 
-class Set3D : public Command
-{
-public:
-  Set3D(){}
-  ~Set3D(){}
-  void execute() {m_world->set3D(m_3d);}
-  void setBool(bool b)
-  {
-    m_3d=b;
-  }
 private:
-  bool m_3d;
-};
+  std::vector<Command> m_slots;
+  size_t m_mask;
+
+  /// Next slot to read, written by the consumer only. Kept on its own cache line from m_tail.
+  alignas(64) std::atomic<size_t> m_head;
+  /// Next slot to write, written by the producer only
+  alignas(64) std::atomic<size_t> m_tail;
+  std::atomic<size_t> m_dropped;
 
-#endif // COMMAND
+  CommandRecorder *m_recorder;
+};
 
+#endif // _COMMANDS_H_
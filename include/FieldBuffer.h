@@ -0,0 +1,64 @@
+/// \file FieldBuffer.h
+/// \brief flat array of metaball field values that the marching squares / cubes are run over
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _FIELDBUFFER_H_
+#define _FIELDBUFFER_H_
+
+#include <algorithm>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The FieldBuffer class holds an array of up to three dimensions in one contiguous block, laid out like the C
+///        array float[_i][_j][_k] so the last index is the fastest. The 2D render grid is [row][column] and the
+///        3D one is [column][row][depth], the same order the nested vectors they replace were indexed in.
+///        reset() keeps the memory, so a buffer kept across frames stops allocating once it has seen the largest
+///        size it is used at.
+//----------------------------------------------------------------------------------------------------------------------
+class FieldBuffer
+{
+public:
+  FieldBuffer() : m_size{0,0,0}, m_stride{0,0} {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief reset  sizes the buffer to _i by _j by _k values and sets them all to 0
+  //----------------------------------------------------------------------------------------------------------------------
+  void reset(int _i, int _j, int _k=1)
+  {
+    m_size[0]=_i;
+    m_size[1]=_j;
+    m_size[2]=_k;
+    m_stride[1]=_k;
+    m_stride[0]=_j*_k;
+    m_data.resize((size_t)_i*_j*_k);
+    std::fill(m_data.begin(),m_data.end(),0.0f);
+  }
+
+  float &at(int _i, int _j) { return m_data[_i*m_stride[0]+_j]; }
+  float at(int _i, int _j) const { return m_data[_i*m_stride[0]+_j]; }
+  float &at(int _i, int _j, int _k) { return m_data[_i*m_stride[0]+_j*m_stride[1]+_k]; }
+  float at(int _i, int _j, int _k) const { return m_data[_i*m_stride[0]+_j*m_stride[1]+_k]; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief size   number of values along dimension _d, 0 to 2
+  //----------------------------------------------------------------------------------------------------------------------
+  int size(int _d) const { return m_size[_d]; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief stride distance in floats between neighbours along dimension _d, 0 or 1. The last one is always 1.
+  //----------------------------------------------------------------------------------------------------------------------
+  int stride(int _d) const { return m_stride[_d]; }
+
+  float *data() { return m_data.data(); }
+  const float *data() const { return m_data.data(); }
+
+private:
+  int m_size[3];
+  int m_stride[2];
+  std::vector<float> m_data;
+};
+
+#endif // _FIELDBUFFER_H_
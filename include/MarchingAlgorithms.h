@@ -11,20 +11,9 @@
 #include <vector>
 #include <stdlib.h>
 
-#ifdef __APPLE__
-#include <OpenGL/gl.h>
-#include <OpenGL/glu.h>
-#include <SDL.h>
-#include <SDL_image.h>
-#else
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
-#endif
-
 #include "include/Vec3.h"
 #include "include/ParticleProperties.h"
+#include "include/FieldBuffer.h"
 
 class MarchingAlgorithms
 {
@@ -57,25 +46,25 @@ public:
     m_render3dresolution(_render3dresolution),
     m_halfwidth(_halfwidth),
     m_halfheight(_halfheight),
-    m_ishighres(false),
-    m_snapshotmultiplier(_snapshotmultiplier){}
+    m_snapshotmultiplier(_snapshotmultiplier),
+    m_ishighres(false){}
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief calculateMarchingSquares   fills m_realtime2DTriangles full of triangle verticies and colors
-  /// \param[in] _renderGrid            the 2d rendergrid containing the metaball floats
+  /// \param[in] _renderGrid            the 2d rendergrid containing the metaball floats, [row][column]
   /// \param[in] _p                     particle properties - used for the colour attributes
   /// \param[in] _inner                 whether to increase the threshold for the outer rim effect for the liquid
   //----------------------------------------------------------------------------------------------------------------------
-  void calculateMarchingSquares(const std::vector<std::vector<float>> renderGrid,
-                                const ParticleProperties p,
+  void calculateMarchingSquares(const FieldBuffer &renderGrid,
+                                const ParticleProperties &p,
                                 const bool inner);
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief calculateMarchingCubes fills m_snapshot3DTriangles or m_realtime3DTriangles with triangle verticies and colors
-  /// \param[in] _renderGrid        the 3d rendergrid containing the metaball floats
+  /// \param[in] _renderGrid        the 3d rendergrid containing the metaball floats, [column][row][depth]
   /// \param[in] _p                 particle properties - used for the colour attributes
   //----------------------------------------------------------------------------------------------------------------------
-  void calculateMarchingCubes(const std::vector<std::vector<std::vector<float>>> renderGrid, const ParticleProperties p);
+  void calculateMarchingCubes(const FieldBuffer &renderGrid, const ParticleProperties &p);
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief VertexInterp calculates the position between two points depending on the floats at either point
@@ -0,0 +1,90 @@
+/// \file MetaballKernel.h
+/// \brief compact metaball falloff for the 2D render grid, evaluated a row of samples at a time
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _METABALLKERNEL_H_
+#define _METABALLKERNEL_H_
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The MetaballKernel class is the compact replacement for the r^2/d^2 metaball of World::renderGrid. A particle
+///        adds m_amplitude*(1-d^2/R^2)^3 to every sample closer than R and nothing beyond it, so each sample costs a
+///        few multiplies instead of a division and no sample outside the circle is visited at all.
+///
+///        R and the amplitude come from the threshold the contours are drawn at. d0 = r/sqrt(threshold) is where a
+///        lone particle of the r^2/d^2 metaball reaches the threshold, nearer than that it is above it whatever the
+///        other particles add. R is where the same particle has fallen to 1/200 of the threshold, d0*sqrt(200), kept
+///        between r and the old window 3 cells away; at the default threshold of 90 that is 1.5r. The amplitude is
+///        picked so a particle adds the same total to the grid as r^2/d^2 does between d0 and the edge of the old
+///        window, so a body of fluid sums to the same field and its contours land where the old ones did.
+//----------------------------------------------------------------------------------------------------------------------
+class MetaballKernel
+{
+public:
+  /// How addRow() is evaluated, picked once from what the CPU supports
+  enum Path
+  {
+    SCALAR,
+    SSE,
+    AVX2
+  };
+
+  MetaballKernel();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief set                    fits the kernel to the world
+  /// \param[in] _interactionradius r of the r^2/d^2 metaball
+  /// \param[in] _squaresize        size of a grid cell, the old metaball reached 3 of them
+  /// \param[in] _threshold         value the contours are drawn at
+  //----------------------------------------------------------------------------------------------------------------------
+  void set(float _interactionradius, float _squaresize, float _threshold);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getRadius  distance past which a particle adds nothing
+  //----------------------------------------------------------------------------------------------------------------------
+  float getRadius() const { return m_radius; }
+
+  float getAmplitude() const { return m_amplitude; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief evaluate       value of the kernel at squared distance _distance2
+  //----------------------------------------------------------------------------------------------------------------------
+  float evaluate(float _distance2) const
+  {
+    float t = 1.0f-_distance2*m_invRadius2;
+    return t>0.0f ? m_amplitude*t*t*t : 0.0f;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief addRow         adds the kernel to _count consecutive samples of one row
+  /// \param[in,out] io_row first sample of the row
+  /// \param[in] _count     number of samples
+  /// \param[in] _dx        x distance from the particle to the first sample
+  /// \param[in] _step      x distance between neighbouring samples
+  /// \param[in] _dy2       squared y distance from the particle to the row
+  //----------------------------------------------------------------------------------------------------------------------
+  void addRow(float *io_row, int _count, float _dx, float _step, float _dy2) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief setPath    forces addRow() onto _path, falls back to the best one the CPU has if it does not support it.
+  ///                   Only there so the paths can be compared against each other.
+  //----------------------------------------------------------------------------------------------------------------------
+  void setPath(Path _path);
+
+  Path getPath() const { return m_path; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief bestPath   fastest path this CPU supports
+  //----------------------------------------------------------------------------------------------------------------------
+  static Path bestPath();
+
+private:
+  float m_radius;
+  float m_invRadius2;
+  float m_amplitude;
+  Path m_path;
+};
+
+#endif // _METABALLKERNEL_H_
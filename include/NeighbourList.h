@@ -0,0 +1,89 @@
+/// \file NeighbourList.h
+/// \brief per particle list of neighbours with cached distances, shared by the spring and double density passes
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _NEIGHBOURLIST_H_
+#define _NEIGHBOURLIST_H_
+
+#include <vector>
+
+#include "include/ParticleStore.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The NeighbourList class stores for every particle the particles within the interaction radius plus a skin.
+///        The neighbours of particle i are m_neighbours[m_start[i]] to m_neighbours[m_start[i+1]-1] and their
+///        distances at the time of the last build or refresh are in m_distance. With a skin the list stays valid
+///        until some particle has moved more than half the skin since it was built. World fills it in
+///        World::updateNeighbourList().
+//----------------------------------------------------------------------------------------------------------------------
+class NeighbourList
+{
+public:
+  NeighbourList() : m_count(0), m_valid(false) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief invalidate marks the list as out of date, called when particles are inserted or deleted
+  //----------------------------------------------------------------------------------------------------------------------
+  void invalidate() { m_valid=false; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief isValid  returns true if the list was built for the current set of particles
+  //----------------------------------------------------------------------------------------------------------------------
+  bool isValid() const { return m_valid; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief beginBuild clears the list ready to be filled for _count particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void beginBuild(int _count);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief endBuild     finishes the list and remembers the positions it was built at
+  /// \param[in] _store   the particles the list was built for
+  //----------------------------------------------------------------------------------------------------------------------
+  void endBuild(const ParticleStore &_store);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief maxDisplacementSquared returns the largest squared distance any particle has moved since the last build
+  //----------------------------------------------------------------------------------------------------------------------
+  float maxDisplacementSquared(const ParticleStore &_store) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief refreshDistances recomputes m_distance from the current positions without searching for new neighbours
+  //----------------------------------------------------------------------------------------------------------------------
+  void refreshDistances(const ParticleStore &_store);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief reorder        follows a ParticleStore::reorder so the list can be reused after World::hashParticles
+  /// \param[in] _order     old slot for every new slot
+  /// \param[in] _remap     new slot for every old slot
+  //----------------------------------------------------------------------------------------------------------------------
+  void reorder(const std::vector<int> &_order, const std::vector<int> &_remap);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief count  number of particles the list was built for
+  //----------------------------------------------------------------------------------------------------------------------
+  int count() const { return m_count; }
+
+  /// Public so the update passes can loop through them directly
+  std::vector<int> m_start;
+  std::vector<int> m_neighbours;
+  std::vector<float> m_distance;
+
+private:
+  int m_count;
+  bool m_valid;
+
+  /// Positions at the last build, for the skin test
+  std::vector<float> m_builtx, m_builty, m_builtz;
+
+  /// Scratch arrays for reorder()
+  std::vector<int> m_scratchStart;
+  std::vector<int> m_scratchNeighbours;
+  std::vector<float> m_scratchDistance;
+  std::vector<float> m_scratchBuilt;
+};
+
+#endif // _NEIGHBOURLIST_H_
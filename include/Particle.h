@@ -7,13 +7,6 @@
 
 #ifndef _PARTICLE_H_
 #define _PARTICLE_H_
-#ifdef __APPLE__
-  #include <OpenGL/gl.h>
-  #include <OpenGL/glu.h>
-#else
-  #include <GL/gl.h>
-  #include <GL/glu.h>
-#endif
 
 #include <cmath>
 #include <vector>
@@ -27,7 +20,7 @@
 class Particle
 {
 public:
-  typedef struct spring{int indexi, indexj; GLfloat L; int count; bool alive;} Spring;
+  typedef struct spring{int indexi, indexj; float L; int count; bool alive;} Spring;
 
   //Particle();
   Particle(const Particle &_p) = default;
@@ -36,9 +29,9 @@ public:
     m_velocity(Vec3(0.0f,0.0f,0.0f)),
     m_properties(_properties),
     m_wall(false),
-    m_dragged(false),
     m_isPartOfObject(false),
     m_init(false),
+    m_dragged(false),
     m_alive(true)
     {}
 
@@ -157,7 +150,7 @@ public:
   /// \brief isObject returns the object bool on the particle.
   /// \return         bool that shows whether particle is an object
   //----------------------------------------------------------------------------------------------------------------------
-  bool isObject();
+  bool isObject() const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief setInit  m_init is set when the particle's springs have been made.
@@ -169,7 +162,7 @@ public:
   /// \brief isInit returns the value of m_init
   /// \return       m_init bool value
   //----------------------------------------------------------------------------------------------------------------------
-  bool isInit();
+  bool isInit() const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief setAlive sets m_alive to new bool.
@@ -181,7 +174,7 @@ public:
   /// \brief getAlive returns value of m_alive
   /// \return         m_alive value
   //----------------------------------------------------------------------------------------------------------------------
-  bool getAlive();
+  bool getAlive() const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief setIndex sets m_index which is index of particle inside world's vector m_particles
@@ -193,7 +186,7 @@ public:
   /// \brief getIndex returns m_index which is index of particle inside world's vector m_particles
   /// \return         bool value of m_index
   //----------------------------------------------------------------------------------------------------------------------
-  int getIndex();
+  int getIndex() const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief updateSpringIndex  checks if there is a spring with index from and if so changes it to to
@@ -227,7 +220,7 @@ private:
 
   //std::vector<Spring *> particleSprings;
 
-//  GLfloat rotation;
+//  float rotation;
 //  Colour particleColour;
 //  int timeToDeath;
 //  ParticleProperties* system;
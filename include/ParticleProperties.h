@@ -8,14 +8,6 @@
 #ifndef _PARTICLEPROPERTIES_H_
 #define _PARTICLEPROPERTIES_H_
 
-#ifdef __APPLE__
-  #include <OpenGL/gl.h>
-  #include <OpenGL/glu.h>
-#else
-  #include <GL/gl.h>
-  #include <GL/glu.h>
-#endif
-
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>
 #include <iostream>
@@ -25,37 +17,36 @@ class ParticleProperties
 public:
   /*
   ParticleProperties(bool spring=true,
-                     GLfloat _sigma=0.0f,
-                     GLfloat _beta=0.1f,
-                     GLfloat _gamma=0.4f,
-                     GLfloat _alpha=3.0f,
-                     GLfloat _knear=0.01f,
-                     GLfloat _k=0.004f,
-                     GLfloat _kspring=0.05f,
-                     GLfloat _p0=10.0f,
-                     GLfloat _red=0,
-                     GLfloat _green=0,
-                     GLfloat _blue=1.0f,
+                     float _sigma=0.0f,
+                     float _beta=0.1f,
+                     float _gamma=0.4f,
+                     float _alpha=3.0f,
+                     float _knear=0.01f,
+                     float _k=0.004f,
+                     float _kspring=0.05f,
+                     float _p0=10.0f,
+                     float _red=0,
+                     float _green=0,
+                     float _blue=1.0f,
                      bool _coloureffect=true):
 
 
     //water */
 
     ParticleProperties(bool spring=false,
-                       GLfloat _sigma=0.05f,
-                       GLfloat _beta=0.1f,
-                       GLfloat _gamma=0.004f,
-                       GLfloat _alpha=0.3f,
-                       GLfloat _knear=0.01f,
-                       GLfloat _k=0.004f,
-                       GLfloat _kspring=0.3f,
-                       GLfloat _p0=5.0f,
-                       GLfloat _red=0,
-                       GLfloat _green=0,
-                       GLfloat _blue=1.0f,
+                       float _sigma=0.05f,
+                       float _beta=0.1f,
+                       float _gamma=0.004f,
+                       float _alpha=0.3f,
+                       float _knear=0.01f,
+                       float _k=0.004f,
+                       float _kspring=0.3f,
+                       float _p0=5.0f,
+                       float _red=0,
+                       float _green=0,
+                       float _blue=1.0f,
                        bool _coloureffect=true):
                         //  */
-    m_spring(spring),
     m_sigma(_sigma),
     m_beta(_beta),
     m_gamma(_gamma),
@@ -67,18 +58,19 @@ public:
     m_red(_red),
     m_green(_green),
     m_blue(_blue),
+    m_spring(spring),
     m_coloureffect(_coloureffect){}
-  GLfloat getSigma() const;
-  GLfloat getBeta() const;
-  GLfloat getGamma() const;
-  GLfloat getAlpha() const;
-  GLfloat getKnear() const;
-  GLfloat getK() const;
-  GLfloat getKspring() const;
-  GLfloat getRed() const;
-  GLfloat getGreen() const;
-  GLfloat getBlue() const;
-  GLfloat getP0() const;
+  float getSigma() const;
+  float getBeta() const;
+  float getGamma() const;
+  float getAlpha() const;
+  float getKnear() const;
+  float getK() const;
+  float getKspring() const;
+  float getRed() const;
+  float getGreen() const;
+  float getBlue() const;
+  float getP0() const;
   bool getSpring() const;
   bool getColourEffect() const;
 
@@ -94,7 +86,7 @@ public:
   void randomize(int _seed);
 
 private:
-  GLfloat m_sigma, m_beta, m_gamma, m_alpha, m_knear, m_k, m_kspring, m_p0, m_red, m_green, m_blue, m_spring, m_coloureffect;
+  float m_sigma, m_beta, m_gamma, m_alpha, m_knear, m_k, m_kspring, m_p0, m_red, m_green, m_blue, m_spring, m_coloureffect;
 
 };
 
@@ -0,0 +1,127 @@
+/// \file ParticleStore.h
+/// \brief structure-of-arrays storage for all particles in the world. Each attribute lives in its own
+///        contiguous array so that the passes in World::update only load the data they actually use.
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _PARTICLESTORE_H_
+#define _PARTICLESTORE_H_
+
+#include <vector>
+
+#include "include/Particle.h"
+
+class ParticleStore
+{
+public:
+  /// Bits packed into m_flags, one byte per particle
+  enum Flag
+  {
+    ALIVE  = 1<<0,
+    WALL   = 1<<1,
+    DRAG   = 1<<2,
+    OBJECT = 1<<3,
+    INIT   = 1<<4,
+    SLEEP  = 1<<5
+  };
+
+  ParticleStore() = default;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief resize     resizes every array to hold _size particles. New slots are dead.
+  /// \param[in] _size  new number of slots
+  //----------------------------------------------------------------------------------------------------------------------
+  void resize(int _size);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief clear  removes all slots
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief size returns the number of slots (alive or dead)
+  //----------------------------------------------------------------------------------------------------------------------
+  int size() const { return (int)m_flags.size(); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief set          unpacks a Particle into slot _i
+  /// \param[in] _i       slot to write to
+  /// \param[in] _p       particle to unpack, its springs are left to World::m_springs
+  /// \param[in] _type    index of the particle's type in World::m_particleTypes
+  //----------------------------------------------------------------------------------------------------------------------
+  void set(int _i, const Particle &_p, int _type);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief move       moves the particle in slot _from to slot _to and kills _from. The indices stored inside the
+  ///                   springs must be updated by the caller.
+  //----------------------------------------------------------------------------------------------------------------------
+  void move(int _from, int _to);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief reorder        permutes the particles so that new slot k holds the particle that was in slot _order[k].
+  ///                       Slots from _count onwards are left dead. Used by World::hashParticles to keep the
+  ///                       particles sorted by grid cell and packed to the left.
+  /// \param[in] _order     old slot for every new slot, only the first _count entries are read
+  /// \param[in] _count     number of particles to keep
+  //----------------------------------------------------------------------------------------------------------------------
+  void reorder(const std::vector<int> &_order, int _count);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief addPosition  adds (_dx,_dy,_dz) to the position of particle _i while keeping it inside the boundaries.
+  ///                     Same behaviour as Particle::addPosition.
+  //----------------------------------------------------------------------------------------------------------------------
+  void addPosition(int _i, float _dx, float _dy, float _dz, float _halfheight, float _halfwidth, bool _is3D);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief updatePosition moves particle _i along its velocity while keeping it inside the boundaries.
+  ///                       Same behaviour as Particle::updatePosition.
+  //----------------------------------------------------------------------------------------------------------------------
+  void updatePosition(int _i, float _timestep, float _halfheight, float _halfwidth, bool _is3D);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief resetRest  particle _i starts a new rest period from where it is now
+  //----------------------------------------------------------------------------------------------------------------------
+  void resetRest(int _i)
+  {
+    m_restx[_i]=m_x[_i];
+    m_resty[_i]=m_y[_i];
+    m_restz[_i]=m_z[_i];
+    m_restSteps[_i]=0;
+  }
+
+  bool hasFlag(int _i, Flag _f) const { return (m_flags[_i] & _f) != 0; }
+  void setFlag(int _i, Flag _f, bool _on)
+  {
+    if(_on) m_flags[_i] |= _f;
+    else m_flags[_i] &= ~_f;
+  }
+  bool getAlive(int _i) const { return hasFlag(_i,ALIVE); }
+  bool getWall(int _i) const { return hasFlag(_i,WALL); }
+  bool getDrag(int _i) const { return hasFlag(_i,DRAG); }
+  bool getSleep(int _i) const { return hasFlag(_i,SLEEP); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// The arrays are public as the update passes inside world loop through them directly.
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_x, m_y, m_z;
+  std::vector<float> m_prevx, m_prevy, m_prevz;
+  std::vector<float> m_velx, m_vely, m_velz;
+  std::vector<int> m_type;
+  std::vector<unsigned char> m_flags;
+  std::vector<int> m_gridPosition;
+  /// Id given by World when the particle is inserted, it follows the particle when the slots are reordered
+  std::vector<int> m_id;
+  /// Where the particle came to rest and for how many steps it has stayed near there, see World::setSleeping()
+  std::vector<float> m_restx, m_resty, m_restz;
+  std::vector<int> m_restSteps;
+
+private:
+  /// Scratch arrays for reorder() so that sorting does not allocate every step
+  std::vector<float> m_scratchFloat;
+  std::vector<int> m_scratchInt;
+  std::vector<unsigned char> m_scratchFlags;
+};
+
+#endif // _PARTICLESTORE_H_
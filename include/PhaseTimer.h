@@ -0,0 +1,143 @@
+/// \file PhaseTimer.h
+/// \brief times each phase of World::update and keeps the last few frames in a ring buffer
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _PHASETIMER_H_
+#define _PHASETIMER_H_
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The PhaseTimer class records how long each phase of World::update took. A frame is opened with
+///        beginFrame(), each phase is timed with a Scope on the stack and endFrame() stores the frame in a ring
+///        buffer of the last getFrames() frames. getStats() gives the min, mean and 99th percentile of a phase over
+///        the frames in the ring.
+//----------------------------------------------------------------------------------------------------------------------
+class PhaseTimer
+{
+public:
+  /// The phases of World::update in the order they run
+  enum Phase
+  {
+    RAIN,
+    GRAVITY,
+    VISCOSITY,
+    POSITION,
+    HASH,
+    NEIGHBOURS,
+    SPRING_ADJUST,
+    SPRING_RELAX,
+    DENSITY,
+    VELOCITY,
+    BOUNDARY,
+    PHASE_COUNT
+  };
+
+  /// Statistics of one phase over the frames in the ring, in milliseconds
+  struct Stats
+  {
+    double min;
+    double mean;
+    double p99;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief The Scope class times from its construction to its destruction and adds the time to a phase
+  //----------------------------------------------------------------------------------------------------------------------
+  class Scope
+  {
+  public:
+    Scope(PhaseTimer &_timer, Phase _phase) :
+      m_timer(_timer),
+      m_phase(_phase),
+      m_start(std::chrono::steady_clock::now()) {}
+    ~Scope()
+    {
+      m_timer.add(m_phase,std::chrono::steady_clock::now()-m_start);
+    }
+  private:
+    PhaseTimer &m_timer;
+    Phase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief PhaseTimer     constructor
+  /// \param[in] _frames    how many frames the ring buffer keeps
+  //----------------------------------------------------------------------------------------------------------------------
+  PhaseTimer(int _frames=128);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief setFrames  resizes the ring buffer to keep _frames frames and forgets the frames recorded so far
+  //----------------------------------------------------------------------------------------------------------------------
+  void setFrames(int _frames);
+  int getFrames() const { return m_frames; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief clear  forgets every recorded frame
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief beginFrame zeroes the times of the frame about to be recorded
+  //----------------------------------------------------------------------------------------------------------------------
+  void beginFrame();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief endFrame stores the current frame in the ring, overwriting the oldest one once it is full
+  //----------------------------------------------------------------------------------------------------------------------
+  void endFrame();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief add          adds _time to _phase in the current frame, a phase may be added to more than once a frame
+  //----------------------------------------------------------------------------------------------------------------------
+  void add(Phase _phase, std::chrono::steady_clock::duration _time);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getRecordedFrames returns how many frames are in the ring, at most getFrames()
+  //----------------------------------------------------------------------------------------------------------------------
+  int getRecordedFrames() const { return m_recorded; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getStats     min, mean and 99th percentile of _phase over the recorded frames, all 0 if there are none
+  //----------------------------------------------------------------------------------------------------------------------
+  Stats getStats(Phase _phase) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getTotalStats  same as getStats but for the sum of all phases in a frame
+  //----------------------------------------------------------------------------------------------------------------------
+  Stats getTotalStats() const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getPhaseName returns a lower case name for _phase, used by dump()
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char *getPhaseName(Phase _phase);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief dump     writes a table of the stats of every phase to _out
+  //----------------------------------------------------------------------------------------------------------------------
+  void dump(std::ostream &_out) const;
+
+private:
+  Stats statsOf(std::vector<double> &io_times) const;
+
+  int m_frames;
+  int m_recorded;
+  int m_next;
+
+  /// Times of the frame being recorded in ms
+  double m_current[PHASE_COUNT];
+
+  /// m_frames frames of PHASE_COUNT times each in ms, frame f starts at m_ring[f*PHASE_COUNT]
+  std::vector<double> m_ring;
+
+  /// Scratch array for sorting in getStats()
+  mutable std::vector<double> m_sorted;
+};
+
+#endif // _PHASETIMER_H_
@@ -0,0 +1,75 @@
+/// \file RenderSnapshot.h
+/// \brief copy of what the renderer needs from one simulation step
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _RENDERSNAPSHOT_H_
+#define _RENDERSNAPSHOT_H_
+
+#include <vector>
+
+#include "include/ParticleProperties.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The RenderView struct is what the renderer needs to know about the world besides its particles: its size,
+///        the spatial hash the particles were binned into and whether it is 3D. World's own copies are changed by the
+///        simulation thread (resizeWorld(), set3D(), loadCheckpoint()), the renderer only ever reads this one.
+//----------------------------------------------------------------------------------------------------------------------
+struct RenderView
+{
+  RenderView() :
+    m_3d(false),
+    m_gridwidth(0),
+    m_gridheight(0),
+    m_squaresize(1.0f),
+    m_interactionradius(1.0f),
+    m_halfwidth(0.0f),
+    m_halfheight(0.0f),
+    m_pointsize(10.0f) {}
+
+  bool operator==(const RenderView &_other) const
+  {
+    return m_3d==_other.m_3d && m_gridwidth==_other.m_gridwidth && m_gridheight==_other.m_gridheight &&
+           m_squaresize==_other.m_squaresize && m_interactionradius==_other.m_interactionradius &&
+           m_halfwidth==_other.m_halfwidth && m_halfheight==_other.m_halfheight && m_pointsize==_other.m_pointsize;
+  }
+  bool operator!=(const RenderView &_other) const { return !(*this==_other); }
+
+  bool m_3d;
+  int m_gridwidth, m_gridheight;
+  float m_squaresize;
+  float m_interactionradius;
+  float m_halfwidth, m_halfheight;
+  float m_pointsize;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The RenderSnapshot struct is filled by World::publishSnapshot at the end of every step and drawn by
+///        World::draw, so drawing never reads the particle store while update() is changing it. Holds the alive
+///        particles only, with the colour they are drawn with already worked out.
+//----------------------------------------------------------------------------------------------------------------------
+struct RenderSnapshot
+{
+  RenderSnapshot() : m_count(0), m_step(0) {}
+
+  /// Number of particles, every array below has at least this many entries
+  int m_count;
+  /// Number of the update() this was taken after
+  long m_step;
+
+  std::vector<float> m_x, m_y, m_z;
+  std::vector<float> m_red, m_green, m_blue;
+  /// Index into World::m_particleTypes, for the marching squares / cubes of each type
+  std::vector<int> m_type;
+  /// Spatial hash cell at the time of the snapshot
+  std::vector<int> m_gridPosition;
+
+  /// World the particles were in
+  RenderView m_view;
+  /// Particle types at the time of the snapshot, m_type indexes into this
+  std::vector<ParticleProperties> m_types;
+};
+
+#endif // _RENDERSNAPSHOT_H_
@@ -0,0 +1,64 @@
+/// \file SimulationThread.h
+/// \brief runs World::update on its own thread at a fixed rate
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _SIMULATIONTHREAD_H_
+#define _SIMULATIONTHREAD_H_
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+class World;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The SimulationThread class steps a World every interval on a thread of its own. Before each step it
+///        calls a function given to start(), which is where the input commands are applied. The renderer reads
+///        the snapshots World publishes after each step, so it never waits for the solver.
+//----------------------------------------------------------------------------------------------------------------------
+class SimulationThread
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief SimulationThread   constructor, does not start the thread
+  /// \param[in] _world         the world to step
+  /// \param[in] _intervalms    time between steps in milliseconds
+  //----------------------------------------------------------------------------------------------------------------------
+  SimulationThread(World *_world, int _intervalms=30);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief ~SimulationThread  stops the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  ~SimulationThread();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief start          starts stepping
+  /// \param[in] _beforeStep called on the simulation thread before every step, may be empty
+  //----------------------------------------------------------------------------------------------------------------------
+  void start(std::function<void()> _beforeStep);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief stop finishes the step in progress and joins the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  void stop();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getSteps returns how many steps have been run
+  //----------------------------------------------------------------------------------------------------------------------
+  long getSteps() const { return m_steps.load(std::memory_order_relaxed); }
+
+private:
+  void run();
+
+  World *m_world;
+  int m_intervalms;
+  std::function<void()> m_beforeStep;
+  std::thread m_thread;
+  std::atomic<bool> m_running;
+  std::atomic<long> m_steps;
+};
+
+#endif // _SIMULATIONTHREAD_H_
@@ -0,0 +1,76 @@
+/// \file SpringHash.h
+/// \brief open addressing hash table from an unordered pair of particles to the spring between them
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _SPRINGHASH_H_
+#define _SPRINGHASH_H_
+
+#include <vector>
+#include <cstdint>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The SpringHash class finds the spring joining two particles in constant time. The key is the pair of
+///        particle indices with the smaller one first so (i,j) and (j,i) find the same spring. Collisions are
+///        resolved with linear probing and the table doubles once it is half full.
+//----------------------------------------------------------------------------------------------------------------------
+class SpringHash
+{
+public:
+  SpringHash();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief clear  removes every entry but keeps the memory
+  //----------------------------------------------------------------------------------------------------------------------
+  void clear();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief reserve    grows the table up front so _springs entries can be inserted without it growing again
+  //----------------------------------------------------------------------------------------------------------------------
+  void reserve(int _springs);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief find       returns the spring between particles _i and _j or -1 if there is none
+  //----------------------------------------------------------------------------------------------------------------------
+  int find(int _i, int _j) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief insert         stores _spring as the spring between _i and _j, replacing any spring already there
+  //----------------------------------------------------------------------------------------------------------------------
+  void insert(int _i, int _j, int _spring);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief erase          removes the entry for _i and _j, but only if it still points at _spring
+  //----------------------------------------------------------------------------------------------------------------------
+  void erase(int _i, int _j, int _spring);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief size returns the number of springs in the table
+  //----------------------------------------------------------------------------------------------------------------------
+  int size() const { return m_size; }
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    int spring;
+  };
+
+  static const uint64_t s_empty = ~uint64_t(0);
+
+  static uint64_t makeKey(int _i, int _j);
+  static uint64_t mix(uint64_t _key);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief grow doubles the table and re-inserts every entry
+  //----------------------------------------------------------------------------------------------------------------------
+  void grow();
+
+  std::vector<Entry> m_table;
+  uint64_t m_mask;
+  int m_size;
+};
+
+#endif // _SPRINGHASH_H_
@@ -25,6 +25,7 @@
 #include <time.h>
 
 #include <include/World.h>
+#include <include/Commands.h>
 
 
 class Toolbar
@@ -32,17 +33,18 @@ class Toolbar
 public:
   Toolbar() :
     m_draw(true),
+    m_erase(false),
     m_drag(false),
     m_tap(false),
+    m_gravity(true),
     m_clear(false),
     m_help(false),
-    m_gravity(true),
-    m_erase(false),
     m_randomize(false),
     m_camera(false),
     m_dropdownopen(false),
     m_dropdownselect(0),
-    m_helpscreen(false){}
+    m_helpscreen(false),
+    m_commands(nullptr){}
 
   //----------------------------------------------------------------------------------------------------------------------
   /// \brief drawToolbar  draws the toolbar on screen
@@ -97,6 +99,13 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void setWorld(World *_world);
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief setCommands    sets the queue the buttons send their changes to the world through, so they run between
+  ///                       steps on the simulation thread and end up in a command log when recording
+  /// \param[in] _commands  the queue
+  //----------------------------------------------------------------------------------------------------------------------
+  void setCommands(CommandQueue *_commands);
+
   // Functions below are called to toggle bools when button is pressed
   void pressDraw();
   void pressDrag();
@@ -145,6 +154,7 @@ private:
   GLuint m_iconsTexture; //
   int m_clickdownbutton; //
   World *m_world;
+  CommandQueue *m_commands;
   std::string m_randomSeed;
 
 };
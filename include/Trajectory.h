@@ -0,0 +1,197 @@
+/// \file Trajectory.h
+/// \brief streams the particles of every step to a compact binary file for offline rendering and reads any frame
+///        of it back
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _TRAJECTORY_H_
+#define _TRAJECTORY_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/ParticleStore.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief A trajectory file starts with the magic "PPTJ", a version byte, the keyframe interval and the position and
+///        velocity quantisation steps. Then comes one chunk per frame:
+///          uint32 payload bytes, uint32 particles, int64 step, payload
+///        The payload holds the particles sorted by id. Each one is the gap to the previous id, its type and the six
+///        quantised position and velocity values, all as variable length integers. Values are stored as the change
+///        from the same particle in the previous frame, or as they are for particles new to this frame and for every
+///        particle of a keyframe. The file ends with the frame index, a uint64 chunk offset and int64 step per frame,
+///        followed by the offset of the index, the number of frames and the magic again.
+//----------------------------------------------------------------------------------------------------------------------
+namespace Trajectory
+{
+  const char s_magic[4] = {'P','P','T','J'};
+  const uint8_t s_version = 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The TrajectoryFrame struct holds the alive particles of one step. Frames read back are sorted by id.
+//----------------------------------------------------------------------------------------------------------------------
+struct TrajectoryFrame
+{
+  TrajectoryFrame() : m_step(0), m_count(0) {}
+
+  void resize(int _count);
+
+  long m_step;
+  int m_count;
+  std::vector<int> m_id;
+  std::vector<int> m_type;
+  std::vector<float> m_x, m_y, m_z;
+  std::vector<float> m_velx, m_vely, m_velz;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The TrajectoryWriter class appends a frame for every push(). push() only copies the particles into one of a
+///        fixed number of frame buffers, a thread of the writer's own sorts, encodes and writes them. If every buffer
+///        is still waiting to be written the frame is dropped rather than making the simulation wait, see
+///        getDroppedFrames(). The frames are encoded against the last frame written so a dropped one leaves a gap
+///        in the steps but nothing else.
+//----------------------------------------------------------------------------------------------------------------------
+class TrajectoryWriter
+{
+public:
+  TrajectoryWriter();
+  ~TrajectoryWriter();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief open               starts a new file and the thread that writes it
+  /// \param[in] _path          file to write
+  /// \param[in] _positionStep  positions are rounded to a multiple of this
+  /// \param[in] _velocityStep  velocities are rounded to a multiple of this
+  /// \param[in] _keyframe      every _keyframe-th frame is stored without deltas, so reading a frame decodes at
+  ///                           most this many
+  /// \param[in] _buffers       frames that may be waiting to be written at once, bounds the memory used
+  /// \return                   false if the file could not be opened
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path, float _positionStep=1.0f/8192.0f, float _velocityStep=1.0f/65536.0f,
+            int _keyframe=30, int _buffers=4);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief push         queues the alive particles among the first _slots of _particles as the frame of _step.
+  ///                     Call from the thread that updates the world, after the step.
+  //----------------------------------------------------------------------------------------------------------------------
+  void push(long _step, const ParticleStore &_particles, int _slots);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief close  writes the frames still queued and the frame index, then closes the file
+  //----------------------------------------------------------------------------------------------------------------------
+  void close();
+
+  bool isOpen() const { return m_file.is_open(); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getDroppedFrames returns how many frames push() dropped, call from the thread that pushes
+  //----------------------------------------------------------------------------------------------------------------------
+  long getDroppedFrames() const { return m_dropped; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getWrittenFrames returns how many frames are in the file, only valid once it is closed
+  //----------------------------------------------------------------------------------------------------------------------
+  long getWrittenFrames() const { return (long)m_index.size(); }
+
+private:
+  void run();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief encode   quantises _frame, sorts it by id and appends its chunk to the file
+  //----------------------------------------------------------------------------------------------------------------------
+  void encode(const TrajectoryFrame &_frame);
+
+  std::ofstream m_file;
+  float m_positionStep, m_velocityStep;
+  int m_keyframe;
+
+  /// Frame buffers, and which of them are free or waiting to be written
+  std::vector<TrajectoryFrame> m_frames;
+  std::vector<int> m_free;
+  std::deque<int> m_queued;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stopping;
+  std::thread m_thread;
+  long m_dropped;
+
+  /// Only touched by the writing thread: the last frame written quantised as eight ints per particle (id, type,
+  /// position, velocity) and the offset and step of every chunk
+  std::vector<int> m_previous;
+  std::vector<int> m_current;
+  std::vector<int> m_order;
+  std::vector<char> m_payload;
+  std::vector<uint64_t> m_index;
+  std::vector<int64_t> m_indexSteps;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The TrajectoryReader class opens a trajectory file and reads any frame of it. The frame index gives the
+///        offset of every chunk straight away, reading frame f then decodes from the keyframe before it, so at
+///        most one keyframe interval of chunks.
+//----------------------------------------------------------------------------------------------------------------------
+class TrajectoryReader
+{
+public:
+  TrajectoryReader() : m_positionStep(0.0f), m_velocityStep(0.0f), m_keyframe(1), m_decoded(-1) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief open       reads the header and the frame index
+  /// \return           false if the file is missing, not a trajectory or was not closed
+  //----------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path);
+
+  int getFrameCount() const { return (int)m_offsets.size(); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getStep  returns the World step frame _frame was taken after. Steps only grow while the world runs on,
+  ///                 a checkpoint loaded in the middle of a recording sets them back to the step it was saved at.
+  //----------------------------------------------------------------------------------------------------------------------
+  long getStep(int _frame) const { return (long)m_steps[_frame]; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief read           decodes frame _frame. Reading the frames in order decodes each chunk once.
+  /// \param[out] o_frame   the particles of that frame sorted by id
+  /// \return               false if _frame is out of range or its chunk is broken
+  //----------------------------------------------------------------------------------------------------------------------
+  bool read(int _frame, TrajectoryFrame &o_frame);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getPositionStep  returns the quantisation step of positions, read values are within half of it
+  //----------------------------------------------------------------------------------------------------------------------
+  float getPositionStep() const { return m_positionStep; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief getVelocityStep  returns the quantisation step of velocities
+  //----------------------------------------------------------------------------------------------------------------------
+  float getVelocityStep() const { return m_velocityStep; }
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief decode applies the chunk of frame _frame on top of m_previous
+  //----------------------------------------------------------------------------------------------------------------------
+  bool decode(int _frame);
+
+  std::ifstream m_file;
+  float m_positionStep, m_velocityStep;
+  int m_keyframe;
+  std::vector<uint64_t> m_offsets;
+  std::vector<int64_t> m_steps;
+
+  /// The last frame decoded, quantised like TrajectoryWriter::m_previous
+  int m_decoded;
+  std::vector<int> m_previous;
+  std::vector<int> m_current;
+  std::vector<char> m_payload;
+};
+
+#endif // _TRAJECTORY_H_
@@ -0,0 +1,66 @@
+/// \file TripleBuffer.h
+/// \brief lock-free triple buffer for handing whole frames from one writer thread to one reader thread
+/// \author Thomas Collingwood
+/// \version 1.0
+/// \date 17/10/26
+/// Revision History : See https://github.com/TomCollingwood/ParticlePanic
+
+#ifndef _TRIPLEBUFFER_H_
+#define _TRIPLEBUFFER_H_
+
+#include <atomic>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// \brief The TripleBuffer class holds three T. The writer fills back() and calls publish(), the reader calls
+///        acquire() and reads front(). Neither side ever waits for the other: publishing swaps the back slot with
+///        the spare one and acquiring swaps the front slot with the spare one if it holds a newer frame. So the
+///        reader always sees a complete frame, the newest one published before its last acquire().
+///        There must be only one writer thread and one reader thread.
+//----------------------------------------------------------------------------------------------------------------------
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : m_back(0), m_spare(1), m_front(2) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief back returns the slot the writer fills, only the writer may call this
+  //----------------------------------------------------------------------------------------------------------------------
+  T &back() { return m_slots[m_back]; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief publish  hands back() to the reader and gives the writer the spare slot to fill next. If the reader has
+  ///                 not picked up the previous frame it is dropped.
+  //----------------------------------------------------------------------------------------------------------------------
+  void publish()
+  {
+    m_back = m_spare.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief acquire  makes the newest published frame the front one. Returns false if nothing new was published
+  ///                 since the last call, front() is then unchanged. Only the reader may call this.
+  //----------------------------------------------------------------------------------------------------------------------
+  bool acquire()
+  {
+    if(!(m_spare.load(std::memory_order_relaxed) & FRESH)) return false;
+    m_front = m_spare.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// \brief front  returns the frame the reader holds, only the reader may call this
+  //----------------------------------------------------------------------------------------------------------------------
+  const T &front() const { return m_slots[m_front]; }
+
+private:
+  /// m_spare holds a slot index in the low bits and FRESH when that slot has not been acquired yet
+  enum { INDEX = 3, FRESH = 4 };
+
+  T m_slots[3];
+  int m_back;
+  std::atomic<int> m_spare;
+  int m_front;
+};
+
+#endif // _TRIPLEBUFFER_H_
@@ -8,13 +8,6 @@
 #ifndef _VEC3_H_
 #define _VEC3_H_
 
-#ifdef __linux__
-  #include <GL/gl.h>
-#endif
-#ifdef __APPLE__
-  #include <OpenGL/gl.h>
-#endif
-
 #include <cmath>
 #include <cassert>
 
@@ -24,9 +17,9 @@ class Vec3
 {
 public:
   Vec3(const Vec3 &_rhs)=default;
-  Vec3(GLfloat _x=0.0f,
-       GLfloat _y=0.0f,
-       GLfloat _z=0.0f) :
+  Vec3(float _x=0.0f,
+       float _y=0.0f,
+       float _z=0.0f) :
     m_x(_x),
     m_y(_y),
     m_z(_z){}
@@ -42,29 +35,29 @@ public:
   void rotateAroundXAxisf(float degrees);
 
   Vec3 operator *(Mat3 &_rhs);
-  Vec3 operator *(GLfloat _rhs) const;
-  void operator *=(GLfloat _rhs);
-  Vec3 operator /(GLfloat _rhs) const;
-  void operator /=(GLfloat _rhs);
+  Vec3 operator *(float _rhs) const;
+  void operator *=(float _rhs);
+  Vec3 operator /(float _rhs) const;
+  void operator /=(float _rhs);
   Vec3 operator +(const Vec3 &_r) const;
   void operator +=(const Vec3 &_r);
   Vec3 operator -(const Vec3 &_rhs) const;
   Vec3 operator -();
   void operator -=(const Vec3 &_r);
   bool operator ==(const Vec3 &_rhs) const;
-  GLfloat & operator [](int _i);
-  void set(GLfloat _x, GLfloat _y, GLfloat _z);
+  float & operator [](int _i);
+  void set(float _x, float _y, float _z);
   void vertexGL() const;
 
 private:
   union
   {
-    GLfloat m_openGL[3];
+    float m_openGL[3];
     struct
     {
-      GLfloat m_x;
-      GLfloat m_y;
-      GLfloat m_z;
+      float m_x;
+      float m_y;
+      float m_z;
     };
   };
 };
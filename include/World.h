@@ -8,30 +8,29 @@
 #ifndef _WORLD_H_
 #define _WORLD_H_
 
-#include <sys/time.h>
 #include <stdlib.h>
 #include <iostream>
 #include <algorithm>
 #include <cmath>
 #include <string>
 #include <vector>
-
-#ifdef __APPLE__
-#include <OpenGL/gl.h>
-#include <OpenGL/glu.h>
-#include <SDL.h>
-#include <SDL_image.h>
-#else
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
-#endif
+#include <atomic>
 
 #include "include/Vec3.h"
 #include "include/Particle.h"
+#include "include/ParticleStore.h"
+#include "include/NeighbourList.h"
+#include "include/SpringHash.h"
+#include "include/CellHash.h"
+#include "include/PhaseTimer.h"
+#include "include/RenderSnapshot.h"
+#include "include/TripleBuffer.h"
 #include "include/ParticleProperties.h"
 #include "include/MarchingAlgorithms.h"
+#include "include/FieldBuffer.h"
+#include "include/MetaballKernel.h"
+
+class TrajectoryWriter;
 
 
 /**
@@ -65,29 +64,157 @@ public:
     //----------------------------------------------------------------------------------------------------------------------
     void resizeWindow(int _w, int _h);
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief initGL  sets up the OpenGL state used by draw(). Needs a current GL context, so it is kept apart from
+    ///                init() which only sets up the simulation.
+    //----------------------------------------------------------------------------------------------------------------------
+    void initGL();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief resizeRender rebuilds the marching squares / cubes for the world described by _view. Called by draw()
+    ///                     whenever the view of the snapshot changes, call it with the view of the first snapshot when
+    ///                     rendering without a window. Only call from the thread that draws.
+    /// \param[in] _view    world the render grids have to cover
+    //----------------------------------------------------------------------------------------------------------------------
+    void resizeRender(const RenderView &_view);
+
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief update                   updates the particles in the world according to SPH algorithms. Called in timer.
     /// \param[out] o_updateinprogress  bool that is set when update is in progress
     //----------------------------------------------------------------------------------------------------------------------
     void update(bool *o_updateinprogress);
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getStep returns how many times update() has run, command logs are stamped with it
+    //----------------------------------------------------------------------------------------------------------------------
+    long getStep() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setAdaptiveTimestep  when on, update() splits its timestep into several substeps when the fastest
+    ///                             particle would move too far in one, see setCFLNumber(). Off by default.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setAdaptiveTimestep(bool _adaptive);
+    bool getAdaptiveTimestep() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setCFLNumber  the fraction of m_interactionradius a particle may move in one substep, 0.25 by default
+    //----------------------------------------------------------------------------------------------------------------------
+    void setCFLNumber(float _cfl);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setMaxSubsteps most substeps one update() may take, 8 by default
+    //----------------------------------------------------------------------------------------------------------------------
+    void setMaxSubsteps(int _max);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setFrameBudget  wall-clock time in milliseconds the substeps of one update() should fit in, 20 by
+    ///                        default. Fewer substeps are taken if they would not fit. 0 means no budget.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setFrameBudget(double _ms);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getLastSubsteps returns how many substeps the last update() took
+    //----------------------------------------------------------------------------------------------------------------------
+    int getLastSubsteps() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setSleeping  when on, cells whose particles have all been at rest for a while, and that have no moving
+    ///                     cell next to them, are put to sleep and skipped by update() until something disturbs them.
+    ///                     Off by default.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSleeping(bool _sleeping);
+    bool getSleeping() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setSleepThreshold  a particle is at rest while it stays within _distance times m_interactionradius of
+    ///                           where it came to rest (0.05 by default) and may sleep once it has been at rest for
+    ///                           _steps steps in a row (10 by default). Fluid still creeping faster than
+    ///                           _distance/_steps interaction radii a step never sleeps.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSleepThreshold(float _distance, int _steps);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getSleepingParticles returns how many particles were asleep after the last hashParticles()
+    //----------------------------------------------------------------------------------------------------------------------
+    int getSleepingParticles() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief wakeParticles  wakes every particle and resets their rest counts, for changes that affect all of them
+    ///                       like turning gravity on or off
+    //----------------------------------------------------------------------------------------------------------------------
+    void wakeParticles();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief saveCheckpoint writes the particles, springs, particle types and world settings to a binary file,
+    ///                       see Checkpoint.h for the layout
+    /// \param[in] _path      file to write, replaced only once the new one is complete
+    /// \return               false if the file could not be written
+    //----------------------------------------------------------------------------------------------------------------------
+    bool saveCheckpoint(const std::string &_path) const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief loadCheckpoint replaces the whole world with one saved by saveCheckpoint(). The arrays are copied in
+    ///                       one go rather than inserted particle by particle. The window size is kept, the world
+    ///                       size comes from the file. All particles are woken and anything being dragged is let go.
+    /// \param[in] _path      file to read
+    /// \return               false if the file could not be read, the world is left untouched in that case
+    //----------------------------------------------------------------------------------------------------------------------
+    bool loadCheckpoint(const std::string &_path);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setTrajectory  after every update() the alive particles are handed to _writer, which writes them out on a
+    ///                       thread of its own. nullptr stops it, which is the default. Frames carry getStep(), so
+    ///                       after loadCheckpoint() restores an earlier step the steps in the file go backwards.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setTrajectory(TrajectoryWriter *_writer);
+
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief draw Draws the particles in the world either in spheres, marching cubes or squares
     //----------------------------------------------------------------------------------------------------------------------
     void draw();
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief getHalfHeight  returns half the height of the window in OpenGL coordinates
+    /// \brief getHalfHeight  returns half the height of the window in OpenGL coordinates. The simulation's own copy,
+    ///                       the thread that draws reads getDrawnView() instead.
     /// \return               value of half the height of the window
     //----------------------------------------------------------------------------------------------------------------------
     float getHalfHeight() const;
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief getHalfWidth returns half the width of the window in OpenGL coordinates
+    /// \brief getHalfWidth returns half the width of the window in OpenGL coordinates. The simulation's own copy,
+    ///                     the thread that draws reads getDrawnView() instead.
     /// \return             value of half the height of the window
     //----------------------------------------------------------------------------------------------------------------------
     float getHalfWidth() const;
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setParticleLimit  sets how many particles the pool may grow to. Particles inserted past this are dropped.
+    ///                          Can't be set lower than the current pool size.
+    /// \param[in] _limit        maximum number of particles
+    //----------------------------------------------------------------------------------------------------------------------
+    void setParticleLimit(int _limit);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getParticlePoolSize  returns the number of particle slots currently allocated
+    //----------------------------------------------------------------------------------------------------------------------
+    int getParticlePoolSize() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getParticlePoolGrowths returns how many times the particle pool has grown
+    //----------------------------------------------------------------------------------------------------------------------
+    int getParticlePoolGrowths() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getParticles returns the particle pool, alive or not, for checking what was written out against it.
+    ///                     Only call from the thread that updates the world.
+    //----------------------------------------------------------------------------------------------------------------------
+    const ParticleStore &getParticles() const { return m_particles; }
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getDroppedParticles returns how many particles were not inserted because the pool was at its limit
+    //----------------------------------------------------------------------------------------------------------------------
+    int getDroppedParticles() const;
+
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief getGridColumnRow returns the grid's column and row number from the spatial hash number
     /// \param[in] _k           spatial hash grid index
@@ -95,52 +222,146 @@ public:
     //----------------------------------------------------------------------------------------------------------------------
     Vec3 getGridColumnRow(int _k);
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief NeighbourRanges  ranges of particle slots [first[r], last[r]) covering the block of cells around a cell.
+    ///                         Each range is one row of cells: up to 5 ranges in 2D and 25 in 3D.
+    //----------------------------------------------------------------------------------------------------------------------
+    struct NeighbourRanges
+    {
+      int first[25];
+      int last[25];
+      int count;
+    };
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getNeighbourRanges  fills o_ranges with the particles in the block of cells around _thiscell without
+    ///                            allocating. Cells off the edge of the grid are left out.
+    /// \param[in] _thiscell       the centre cell of the block
+    /// \param[in] _rings          how many cells out the block reaches: 1 gives 3x3 (3x3x3 in 3D), 2 gives 5x5 (5x5x5)
+    /// \param[out] o_ranges       the particle ranges of the block
+    //----------------------------------------------------------------------------------------------------------------------
+    void getNeighbourRanges(int _thiscell, int _rings, NeighbourRanges &o_ranges) const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setNeighbourList  turns the neighbour list stage of update() on or off. When on, the spring and double
+    ///                          density passes read their neighbours from one list built per step.
+    /// \param[in] _enabled      true to use the neighbour list
+    /// \param[in] _skin         extra distance beyond m_interactionradius kept in the list. With a skin the list is only
+    ///                          rebuilt once a particle has moved more than half of it, otherwise it is rebuilt every step.
+    ///                          Limited to (2*m_squaresize-m_interactionradius)/2 so a pair stays within two cells.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setNeighbourList(bool _enabled, float _skin);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief updateNeighbourList  rebuilds m_neighbourList from the spatial hash, or just refreshes its distances if the
+    ///                             skin allows it to be reused. Called by update() straight after hashParticles().
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateNeighbourList();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setParallelDensity  picks which double density relaxation update() runs
+    /// \param[in] _parallel       true for the multithreaded pass over coloured cells, false for the original serial pass
+    //----------------------------------------------------------------------------------------------------------------------
+    void setParallelDensity(bool _parallel);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setParallelViscosity  picks which viscosity pass update() runs
+    /// \param[in] _parallel         true for the multithreaded pass over coloured cells, false for the original serial pass
+    //----------------------------------------------------------------------------------------------------------------------
+    void setParallelViscosity(bool _parallel);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setParallelRender  picks how renderFields() fills the render grids
+    /// \param[in] _parallel      true to fill the tiles on several threads, false for one thread. Both give the same grids.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setParallelRender(bool _parallel);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setCompactMetaballs  picks the metaball the 2D render grids are built from
+    /// \param[in] _compact         true for the compact MetaballKernel, which stops at a fixed radius and is evaluated
+    ///                             a row at a time with SIMD, false for the original r^2/d^2 over a window of cells
+    //----------------------------------------------------------------------------------------------------------------------
+    void setCompactMetaballs(bool _compact);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getRender2DThreshold returns the field value the 2D contours are drawn at
+    //----------------------------------------------------------------------------------------------------------------------
+    float getRender2DThreshold() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setSparseGrid  picks how the 3D spatial hash stores its cells. 2D always uses the dense grid.
+    /// \param[in] _sparse    true to keep only the occupied cells in a hash table so memory and the per step cost follow
+    ///                       the number of particles, false for the dense array of every cell in the box
+    //----------------------------------------------------------------------------------------------------------------------
+    void setSparseGrid(bool _sparse);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getSparseGrid returns true if the 3D spatial hash only stores occupied cells
+    //----------------------------------------------------------------------------------------------------------------------
+    bool getSparseGrid() const;
+
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief getSurroundingParticles  gets all particles in surrounding grids.
     /// \param[in] _thiscell            the centre cell in which to search for surrounding particles from
     /// \param[in] _numsur              how far out neightbouring particles can be (counted in grid squares)
     ///                                 if numsur==1 then it would return all particles in 3x3 grid around thiscell
     /// \param[in] _withwalls           if true will also include particles that are of wall type
-    /// \return                         returns vector of pointers to the surrounding particles
+    /// \return                         returns vector of indices of the surrounding particles in m_particles
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector<Particle *> getSurroundingParticles(int thiscell,int numsur, bool withwalls) const;
+    std::vector<int> getSurroundingParticles(int thiscell,int numsur, bool withwalls) const;
 
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief getbackhere  if particle is out of boundaries then it's position is changes so it is within boundaries
-    /// \param[inout] io_p  pointer to particle to check
+    /// \param[in] _p      index of particle to check
     //----------------------------------------------------------------------------------------------------------------------
-    void getbackhere(Particle * io_p);
+    void getbackhere(int _p);
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief handleKeys handles keyboard key inputs that affect the particles within the world
+    /// \brief handleKeys handles keyboard key inputs that affect the particles within the world. Runs on the
+    ///                   simulation thread through Command::HANDLE_KEY.
     /// \param[in] _input the inputted key
     //----------------------------------------------------------------------------------------------------------------------
     void handleKeys(char _input);
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief handleRenderKeys handles the keys that only change how the world is drawn ('r', 't', 'p', 'o', 'm').
+    ///                         Only call from the thread that draws.
+    /// \param[in] _input       the inputted key
+    //----------------------------------------------------------------------------------------------------------------------
+    void handleRenderKeys(char _input);
+
     // SPRING AND PARTICLE MAINTENANCE
 
-    // Springs and Particles are stored in a pre-allocated vector of a certain size. When inserting we insert where
-    // we know is the first free particle. We store this attribute in world. As m_firstFreeParticle and
-    // m_firstFreeSpring. Once we inserted we find the next free particle and update this attribute. When deleting
-    // particles / springs we also update the first free particle or spring attribute if we delete one that is before
-    // the current first free particle / spring.
+    // Particles are stored in a pre-allocated vector of a certain size. When inserting we insert where we know is
+    // the first free particle. We store this attribute in world as m_firstFreeParticle. Once we inserted we find the
+    // next free particle and update this attribute. When deleting particles we also update the first free particle
+    // attribute if we delete one that is before the current first free particle.
 
-    // We need to defrag the list so that all the alive particles / springs are together and all the dead ones are
-    // together also. As they can become fragmented when we delete particles / springs.
+    // We need to defrag the particles so that all the alive particles are together and all the dead ones are
+    // together also. This is done by the counting sort inside hashParticles(), which packs the alive particles to
+    // the left sorted by grid cell.
+
+    // Springs live in a pool that grows when it runs out. Deleted springs go on the free list m_freeSprings and are
+    // reused first, so the index of a spring never changes while it is alive and no defrag is needed.
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief deleteSpring deletes a spring from the vector m_springs while updating m_lastFreeSpring and m_lastTakenSpring
+    /// \brief deleteSpring deletes a spring from m_springs and puts its slot on the free list
     /// \param[in] _s       index of spring to delete
     //----------------------------------------------------------------------------------------------------------------------
     void deleteSpring(int _s);
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief insertSpring Inserts a spring to the vector m_springs while updating m_lastFreeSpring and m_lastTakenSpring
+    /// \brief insertSpring Inserts a spring into a slot from the free list, or at the end of m_springs if it is empty
     /// \param[in] _spring  Spring to insert
     /// \return             Index of the inserted spring in m_springs
     //----------------------------------------------------------------------------------------------------------------------
     int insertSpring(Particle::Spring _spring);
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief buildSpringLists lists the alive springs of every particle again in m_springListStart / m_springList
+    //----------------------------------------------------------------------------------------------------------------------
+    void buildSpringLists();
+
     //----------------------------------------------------------------------------------------------------------------------
     /// \brief deleteParticle deletes a particle from the vector m_particles while updating m_lastFreeParticle and
     ///                       m_lastTakenParticle
@@ -156,20 +377,44 @@ public:
     void insertParticle(Particle _particle);
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief defragParticles  reorders the particles within m_particles so all alive particles are to the left
+    /// \brief growParticles  doubles the particle pool, up to m_particleLimit
     //----------------------------------------------------------------------------------------------------------------------
-    void defragParticles();
+    void growParticles();
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief defragSprings  reorders the springs within m_springs so that all alive springs are to the left
+    /// \brief hashParticles  sorts m_particles by spatial hash cell with a two pass counting sort. Afterwards the
+    ///                       particles in occupied cell k, whose key is m_occupiedKeys[k], are the slots
+    ///                       m_occupiedStart[k] to m_occupiedStart[k+1]-1, all alive particles are packed to the left
+    ///                       and the springs / dragged particles are remapped.
     //----------------------------------------------------------------------------------------------------------------------
-    void defragSprings();
+    void hashParticles();
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief hashParticles  takes m_grid and m_particles, using spatial hash organises the particles into
-    ///                       buckets / squares as pointers
+    /// \brief getCellKey  returns the spatial hash cell of particle _i from its position, clamped to the grid
     //----------------------------------------------------------------------------------------------------------------------
-    void hashParticles();
+    int getCellKey(int _i) const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getGridSize returns the number of cells in the grid, 3D or not
+    //----------------------------------------------------------------------------------------------------------------------
+    int getGridSize() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief countCellsDense  first half of hashParticles() for the dense grid: counts the particles of every cell
+    ///                         into m_cellStart and fills m_cellParticles and the occupied cell list
+    //----------------------------------------------------------------------------------------------------------------------
+    void countCellsDense();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief countCellsSparse  the same for the sparse grid, only the occupied cells are found through m_cellHash
+    ///                          and m_cellStart is left empty
+    //----------------------------------------------------------------------------------------------------------------------
+    void countCellsSparse();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getCellRange  gives the particle slots [o_first, o_last) of grid cell _cell, empty if it has none
+    //----------------------------------------------------------------------------------------------------------------------
+    void getCellRange(int _cell, int &o_first, int &o_last) const;
 
     // INPUTS
     //----------------------------------------------------------------------------------------------------------------------
@@ -225,7 +470,7 @@ public:
     void drawWith(int _type);
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief mouseMove  used to rotate world in 3D according to mouse movement
+    /// \brief mouseMove  used to rotate world in 3D according to mouse movement. Only call from the thread that draws.
     /// \param x          x position of mouse on screen in pixels
     /// \param y          y position of mouse on screen in pixels
     /// \param leftclick  true if left mouse button is pressed
@@ -250,65 +495,256 @@ public:
 
     // RENDER GRIDS
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief renderGrid creates a 2D vector containing floats that are calculated with a metaball function.
+    /// \brief renderGrid fills a 2D grid [row][column] with floats that are calculated with a metaball function.
     ///                   The grid is specific to the particle type. The grid is used to create marching squares.
+    /// \param _snapshot  particles to create the grid from, see getSnapshot()
     /// \param p          ParticleProperties to create the grid for
-    /// \return           the render grid
+    /// \return           the render grid, reused by the next call so only valid until then
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector<std::vector<float>> renderGrid(ParticleProperties *p);
+    const FieldBuffer &renderGrid(const RenderSnapshot &_snapshot, ParticleProperties *p);
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// \brief render3dGrid creates a 3D vector containing floats that are calculated with a metaball function.
-    ///                     The grid is specific to the particle type. The grid is used to create marching cubes.
+    /// \brief render3dGrid fills a 3D grid [column][row][depth] with floats that are calculated with a metaball
+    ///                     function. The grid is specific to the particle type. The grid is used to create marching cubes.
+    /// \param _snapshot    particles to create the grid from, see getSnapshot()
     /// \param p            ParticleProperties to create the grid for
-    /// \return             the render grid
+    /// \return             the render grid, reused by the next call so only valid until then
+    //----------------------------------------------------------------------------------------------------------------------
+    const FieldBuffer &render3dGrid(const RenderSnapshot &_snapshot, ParticleProperties *p);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief renderFields builds the render grid of every particle type at once. The particles of _snapshot are
+    ///                     binned by type in one pass and then each type is splatted into its own layer, so the
+    ///                     snapshot is not scanned once per type. Types with no particles are not touched. Each
+    ///                     layer is cut into tiles that gather from the particles near them, see setParallelRender().
+    /// \param _snapshot    particles to create the grids from, see getSnapshot()
+    /// \param _3d          fill 3D grids like render3dGrid() instead of 2D ones like renderGrid()
+    //----------------------------------------------------------------------------------------------------------------------
+    void renderFields(const RenderSnapshot &_snapshot, bool _3d);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getRenderField  returns the layer of type _type filled by the last renderFields()
+    //----------------------------------------------------------------------------------------------------------------------
+    const FieldBuffer &getRenderField(int _type) const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getRenderFieldCount returns how many particles of type _type the last renderFields() splatted. When it is
+    ///                            0 the layer was left as it was and there is nothing of that type to march.
     //----------------------------------------------------------------------------------------------------------------------
-    std::vector<std::vector<std::vector<float>>> render3dGrid(ParticleProperties *p);
+    int getRenderFieldCount(int _type) const;
 
     Vec3 getGridXYZ(int k);
     int getrenderoption();
     void drawLoading();
 
-    /// called when down arrow is pressed - increases resolution of marching squares render
+    /// called when down arrow is pressed - increases resolution of marching squares render. Only call from the
+    /// thread that draws.
     void increase2DResolutionWORLD();
 
-    /// called when up arrow is pressed - increases resolution of marching squares render
+    /// called when up arrow is pressed - increases resolution of marching squares render. Only call from the
+    /// thread that draws.
     void decrease2DResolutionWORLD();
 
-    /// returns m_snapshotMode
+    /// returns where the renderer is in taking a 3D snapshot, safe to call from any thread
     int getSnapshotMode();
 
-    /// DRAWS A SQUARE OF m_particleTypes[todraw]
-    void drawCube();
+    /// DRAWS A SQUARE OF m_particleTypes[todraw] with its top left corner at (_x,_y)
+    void drawCube(float _x=-3.0f, float _y=3.0f);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief addBlock     fills a box with particles of m_particleTypes[todraw] on a regular lattice and hashes once at
+    ///                     the end, so large scenes can be set up without a mouse. In 2D the z values are ignored.
+    /// \param[in] _min     lower corner of the box in world coordinates
+    /// \param[in] _max     upper corner of the box in world coordinates
+    /// \param[in] _spacing distance between neighbouring particles
+    //----------------------------------------------------------------------------------------------------------------------
+    void addBlock(Vec3 _min, Vec3 _max, float _spacing);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setWorldHalfHeight sets half the height of the world in world units, 5 by default. The width follows from
+    ///                           the window's aspect ratio. Takes effect at the next resizeWorld() / resizeWindow().
+    //----------------------------------------------------------------------------------------------------------------------
+    void setWorldHalfHeight(float _halfheight);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getAliveParticles returns the number of alive particles
+    //----------------------------------------------------------------------------------------------------------------------
+    int getAliveParticles() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief addParticles     inserts a particle of m_particleTypes[todraw] at each position and hashes once at the end
+    /// \param[in] _positions   positions in world coordinates
+    //----------------------------------------------------------------------------------------------------------------------
+    void addParticles(const std::vector<Vec3> &_positions);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getParticleType returns m_particleTypes[_type], for renderGrid() and render3dGrid()
+    //----------------------------------------------------------------------------------------------------------------------
+    ParticleProperties *getParticleType(int _type);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getGridCell returns the spatial hash cell of the particle in slot _i as of the last hashParticles().
+    ///                    Alive particles are in slots 0 to getAliveParticles()-1.
+    //----------------------------------------------------------------------------------------------------------------------
+    int getGridCell(int _i) const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getMarching returns the marching squares / cubes object that is set up for the current world size
+    //----------------------------------------------------------------------------------------------------------------------
+    MarchingAlgorithms &getMarching();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getPhaseTimer returns the timings of the phases of update() over the last frames
+    //----------------------------------------------------------------------------------------------------------------------
+    const PhaseTimer &getPhaseTimer() const;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief setTimingDump  prints the particle count and the phase timings to std::cout every _frames updates.
+    ///                       0 turns it off, which is the default.
+    //----------------------------------------------------------------------------------------------------------------------
+    void setTimingDump(int _frames);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief publishSnapshot copies the alive particles and their colours into a RenderSnapshot and hands it to the
+    ///                        renderer. Called at the end of every update(), only from the thread that updates.
+    //----------------------------------------------------------------------------------------------------------------------
+    void publishSnapshot();
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getSnapshot returns the newest published snapshot. Only call from the thread that draws. The
+    ///                    snapshot stays valid and unchanged until the next call.
+    //----------------------------------------------------------------------------------------------------------------------
+    const RenderSnapshot &getSnapshot();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief getDrawnView returns the view of the snapshot getSnapshot() last returned. Only call from the thread
+    ///                     that draws.
+    //----------------------------------------------------------------------------------------------------------------------
+    const RenderView &getDrawnView() const;
 
 
 private:
     /// Keep track of whether this has been initialised - otherwise it won't be ready to draw!
     bool m_isInit;
 
-    /// The time since the object was initialised, which is used for animation purposes
-    double m_startTime;
-
-    /// A member that is updated when update() is called indicating the elapsed time
-    double m_elapsedTime;
-
     double m_timestep;
 
     // PARTICLES
-    std::vector<Particle> m_particles;
-    int m_particlesPoolSize;
+    ParticleStore m_particles;
+    int m_particlesPoolSize;  // Initial size of the pool, it doubles when full up to m_particleLimit
+    int m_particleLimit;
+    int m_particlePoolGrowths;
+    int m_droppedParticles;
     int m_firstFreeParticle;  // These two ints are needed for efficient insert and deletion
     int m_lastTakenParticle;  // See: insertParticle() and deleteParticle()
     int m_howManyAliveParticles;
+    int m_nextParticleId;     // Id the next inserted particle gets, see ParticleStore::m_id
     std::vector<ParticleProperties> m_particleTypes;
 
+    // NEIGHBOUR LIST
+    NeighbourList m_neighbourList;
+    bool m_useNeighbourList;
+    float m_neighbourSkin;
+    int m_neighbourListBuilds;
+
+    /// Neighbours of one particle and their distances, filled by gatherCandidates()
+    std::vector<int> m_candidates;
+    std::vector<float> m_candidateDistance;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief gatherCandidates fills o_candidates and o_distance with the neighbours of particle _i, from the
+    ///                         neighbour list if it is on or else from _ranges
+    /// \param[in] _cached      use the distances stored in the neighbour list instead of working them out again
+    /// \return                 number of candidates
+    //----------------------------------------------------------------------------------------------------------------------
+    int gatherCandidates(int _i, const NeighbourRanges &_ranges, bool _cached,
+                         std::vector<int> &o_candidates, std::vector<float> &o_distance) const;
+
+    // CELL COLOURING
+    /// Occupied cells sorted by colour, filled by colourCells()
+    std::vector<int> m_cellColour;
+    std::vector<int> m_colourStart;
+    std::vector<int> m_colourCursor;
+    std::vector<int> m_colourCells;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief colourCells  sorts the occupied cells into m_colourCells by colour so that two cells of the same colour
+    ///                     are more than 2*_reach cells apart along some axis. The cells of colour c are
+    ///                     m_colourCells[m_colourStart[c]] to m_colourCells[m_colourStart[c+1]-1].
+    /// \param[in] _reach   how many cells out a pass over one cell reads and writes
+    /// \return             number of colours
+    //----------------------------------------------------------------------------------------------------------------------
+    int colourCells(int _reach);
+
+    // VISCOSITY
+    bool m_parallelViscosity;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief viscositySerial  applies the viscosity impulses cell by cell in order
+    //----------------------------------------------------------------------------------------------------------------------
+    void viscositySerial();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief viscosityParallel  applies the viscosity impulses one colour of cells at a time, with the cells of each
+    ///                           colour split over threads with OpenMP. Same result for any number of threads.
+    //----------------------------------------------------------------------------------------------------------------------
+    void viscosityParallel();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief viscosityCell      applies the impulses between the particles of one cell and their neighbours
+    /// \param[in] _cell          the cell, an index into m_occupiedKeys
+    /// \param[in,out] io_ranges  scratch ranges
+    //----------------------------------------------------------------------------------------------------------------------
+    void viscosityCell(int _cell, NeighbourRanges &io_ranges);
+
+    // DOUBLE DENSITY
+    bool m_parallelDensity;
+
+    /// One candidate buffer per thread
+    std::vector<std::vector<int>> m_threadCandidates;
+    std::vector<std::vector<float>> m_threadCandidateDistance;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief relaxDensitySerial  double density relaxation visiting the particles one after another. Each particle
+    ///                            moves itself and its neighbours straight away so later particles see the new positions.
+    //----------------------------------------------------------------------------------------------------------------------
+    void relaxDensitySerial();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief relaxDensityParallel  the same relaxation split over threads with OpenMP. The cells are coloured so that
+    ///                              cells of one colour never share a neighbour, then each colour is relaxed in parallel.
+    ///                              Gives the same result for any number of threads.
+    //----------------------------------------------------------------------------------------------------------------------
+    void relaxDensityParallel();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief relaxDensityCell     relaxes the particles of one cell, moving them and their neighbours
+    /// \param[in] _cell            the cell to relax, an index into m_occupiedKeys
+    /// \param[in,out] io_ranges    scratch ranges for when the neighbour list is off
+    /// \param[in,out] io_candidates scratch candidate buffers, one set per thread
+    //----------------------------------------------------------------------------------------------------------------------
+    void relaxDensityCell(int _cell, NeighbourRanges &io_ranges, std::vector<int> &io_candidates, std::vector<float> &io_distance);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief boundaryDensity  adds the density of the walls to particle _i when m_boundaryType is 1
+    //----------------------------------------------------------------------------------------------------------------------
+    void boundaryDensity(int _i, float &io_density, float &io_neardensity) const;
+
     // SPATIAL HASH
-    std::vector<std::vector<Particle *>> m_grid;
-    std::vector<bool> m_cellsContainingParticles;
+    std::vector<int> m_cellStart;     // gridSize+1 offsets into m_particles for the dense grid, empty when sparse
+    std::vector<int> m_cellCursor;    // scratch write position per cell for the counting sort
+    std::vector<int> m_occupiedKeys;  // grid cell of every occupied cell in ascending order
+    std::vector<int> m_occupiedStart; // occupied cells+1 offsets into m_particles
+    CellHash m_cellHash;              // grid cell to index in m_occupiedKeys, only filled for the sparse grid
+    std::vector<int> m_particleCell;  // scratch slot in m_cellHash of each particle for the sparse counting sort
+    std::vector<int> m_cellOrder;     // scratch for sorting the occupied cells by key
+    std::vector<int> m_cellRank;      // scratch position in key order of each slot
+    std::vector<int> m_cellParticles; // old slot of each particle in sorted order
+    std::vector<int> m_particleRemap; // new slot of each old slot after sorting
 
     // WORLD SIZE ATTRIBUTES
     float m_halfwidth, m_halfheight;
+    float m_worldHalfHeight;
     float m_interactionradius;
     float m_squaresize;
     int m_gridheight, m_gridwidth, m_griddepth;
@@ -328,15 +764,25 @@ private:
 
     // SPRING ATTRIBUTES
     std::vector<Particle::Spring> m_springs;
-    int m_firstFreeSpring;
-    int m_lastTakenSpring;
-    int m_springsize;
+    std::vector<int> m_freeSprings;
+
+    /// Spring between each pair of particles, kept up to date by insertSpring(), deleteSpring() and hashParticles().
+    /// Left empty by loadCheckpoint() as the hashParticles() at the start of the next substep fills it anyway.
+    SpringHash m_springHash;
+
+    /// Springs of every particle, those of particle i are m_springList[m_springListStart[i]] up to
+    /// m_springList[m_springListStart[i+1]]. Only deleteParticle() needs them, so they are built from m_springs the
+    /// first time it runs after a spring was inserted, the particles were reordered or a checkpoint was loaded.
+    /// deleteSpring() leaves them alone, so an entry may name a spring that has died since.
+    std::vector<int> m_springListStart;
+    std::vector<int> m_springList;
+    bool m_springListsValid;
 
     // INTERACTION ATTRIBUTES
     bool m_rain;
     bool m_drawwall;
     bool m_gravity;
-    std::vector<Particle *> m_draggedParticles;
+    std::vector<int> m_draggedParticles;
     int m_previousmousex, m_previousmousey;
 
     // FUN PARTICLE TYPES
@@ -346,14 +792,111 @@ private:
 
     // 3D ATTRIBUTES
     bool m_3d;
+    /// Camera of the 3D view, only touched by the thread that draws
     float m_camerarotatey, m_camerarotatex;
-    int m_snapshotMode;
+    int m_cameramousex, m_cameramousey;
+    /// Snapshot mode of m_marching, copied out by the thread that draws so the simulation thread can read it
+    std::atomic<int> m_snapshotMode;
 
     // BOUNDARYS
     float m_boundaryMultiplier;
     int m_boundaryType;
 
     MarchingAlgorithms m_marching;
+    /// View m_marching and the render grid sizes were last built for, see resizeRender()
+    RenderView m_renderView;
+    /// Render grid of every particle type, filled by renderGrid(), render3dGrid() and renderFields(). Only touched
+    /// by the thread that draws.
+    std::vector<FieldBuffer> m_renderFields;
+    /// Snapshot particles binned by type and band for renderFields(). Those of type t are m_fieldTypeStart[t]
+    /// onwards, those of type t in band g are m_fieldBandStart[t*bands+g] onwards.
+    std::vector<int> m_fieldTypeStart;
+    std::vector<int> m_fieldBandStart;
+    std::vector<int> m_fieldBandCursor;
+    std::vector<int> m_fieldParticleBand;
+    std::vector<int> m_fieldParticles;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief splat2D / splat3D add the metaball of particle _i of _snapshot to io_grid. Only the values whose first
+    ///                          index is in [_first,_last) are touched, the rows in 2D and the columns in 3D.
+    //----------------------------------------------------------------------------------------------------------------------
+    void splat2D(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _first, int _last);
+    void splat3D(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _first, int _last);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief splat2DCompact    splat2D() with m_metaballKernel, visits only the samples within its radius
+    //----------------------------------------------------------------------------------------------------------------------
+    void splat2DCompact(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _first, int _last);
+
+    /// Fill the tiles of renderFields() on several threads
+    bool m_parallelRender;
+    /// Build the 2D grids from m_metaballKernel, fitted to m_mainrender2dthreshold every time a grid is built
+    bool m_compactMetaballs;
+    MetaballKernel m_metaballKernel;
+
+    // TIMINGS
+    /// Time of every phase of update() over the last frames
+    PhaseTimer m_phaseTimer;
+    /// Print the timings every this many updates, 0 for never
+    int m_timingDumpInterval;
+
+    // RENDER SNAPSHOTS
+    /// Written by publishSnapshot() on the simulation thread, read by draw() on the main thread
+    TripleBuffer<RenderSnapshot> m_snapshots;
+    /// Number of update() calls so far
+    long m_step;
+
+    // ADAPTIVE TIMESTEP
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief substep     one step of the solver with m_timestep, everything in update() but the rain
+    /// \param[in] _step   number of this substep since the start, used to adjust each spring only once a substep
+    //----------------------------------------------------------------------------------------------------------------------
+    void substep(int _step);
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief chooseSubsteps  how many substeps to split the next update() into, from the fastest particle, the
+    ///                        CFL number, m_maxSubsteps and the frame budget
+    //----------------------------------------------------------------------------------------------------------------------
+    int chooseSubsteps();
+
+    bool m_adaptiveTimestep;
+    float m_cflNumber;
+    int m_maxSubsteps;
+    double m_frameBudgetms;
+    /// Running average of the wall-clock time of one substep in milliseconds
+    double m_substepCostms;
+    int m_substepCount;
+    int m_lastSubsteps;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief restoreCells  rebuilds the occupied cell lists from m_gridPosition without moving any particle, so a
+    ///                      loaded checkpoint carries on from the same cells and particle order it was saved with.
+    ///                      If it was saved with particles inserted since the last hash the cells are not sorted
+    ///                      runs any more, then it falls back to hashParticles().
+    //----------------------------------------------------------------------------------------------------------------------
+    void restoreCells();
+
+    // SPARSE GRID
+    /// Only store the occupied cells of the 3D grid, see setSparseGrid()
+    bool m_sparseGrid;
+
+    // SLEEPING
+    //----------------------------------------------------------------------------------------------------------------------
+    /// \brief updateSleep  decides which occupied cells sleep from the rest counts of their particles and sets the
+    ///                     SLEEP flag of every particle to match. Called at the end of hashParticles().
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateSleep();
+
+    bool m_sleeping;
+    float m_sleepDistance;
+    int m_sleepSteps;
+    int m_sleepingParticles;
+    /// Per occupied cell: 1 if it has a particle that is not at rest / if it or a cell around it is restless
+    std::vector<unsigned char> m_cellRestless;
+    std::vector<unsigned char> m_cellAwake;
+
+    // TRAJECTORY EXPORT
+    TrajectoryWriter *m_trajectory;
 };
 
 #endif // WORLD_H
@@ -0,0 +1,86 @@
+///
+///  @file CellHash.cpp
+///  @brief open addressing hash table from a grid cell to its place in the list of occupied cells
+
+#include "include/CellHash.h"
+
+namespace
+{
+  const int s_initialSize = 256;
+}
+
+CellHash::CellHash() :
+  m_mask(s_initialSize-1),
+  m_size(0)
+{
+  Entry empty = {-1,-1};
+  m_table.assign(s_initialSize,empty);
+}
+
+uint32_t CellHash::mix(uint32_t _cell)
+{
+  // Finaliser of murmur3, neighbouring cells end up far apart in the table
+  _cell ^= _cell>>16;
+  _cell *= 0x85ebca6bU;
+  _cell ^= _cell>>13;
+  _cell *= 0xc2b2ae35U;
+  _cell ^= _cell>>16;
+  return _cell;
+}
+
+void CellHash::clear(int _expected)
+{
+  std::size_t slots = m_table.size();
+  while(slots<2*(std::size_t)_expected) slots*=2;
+
+  Entry empty = {-1,-1};
+  m_table.assign(slots,empty);
+  m_mask=(uint32_t)slots-1;
+  m_size=0;
+}
+
+int CellHash::find(int _cell) const
+{
+  for(uint32_t slot = mix(_cell)&m_mask; ; slot=(slot+1)&m_mask)
+  {
+    const Entry &entry = m_table[slot];
+    if(entry.cell==_cell) return entry.value;
+    if(entry.cell==-1) return -1;
+  }
+}
+
+void CellHash::insert(int _cell, int _value)
+{
+  if(2*(m_size+1)>(int)m_table.size()) grow();
+
+  for(uint32_t slot = mix(_cell)&m_mask; ; slot=(slot+1)&m_mask)
+  {
+    Entry &entry = m_table[slot];
+    if(entry.cell==_cell)
+    {
+      entry.value=_value;
+      return;
+    }
+    if(entry.cell==-1)
+    {
+      entry.cell=_cell;
+      entry.value=_value;
+      ++m_size;
+      return;
+    }
+  }
+}
+
+void CellHash::grow()
+{
+  std::vector<Entry> old;
+  old.swap(m_table);
+  Entry empty = {-1,-1};
+  m_table.assign(old.size()*2,empty);
+  m_mask=(uint32_t)m_table.size()-1;
+  m_size=0;
+  for(auto& entry : old)
+  {
+    if(entry.cell!=-1) insert(entry.cell,entry.value);
+  }
+}
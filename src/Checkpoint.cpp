@@ -0,0 +1,102 @@
+///
+///  @file Checkpoint.cpp
+///  @brief reader and writer for the sections of a world checkpoint
+
+#include "include/Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+  const char s_magic[4] = {'P','P','C','K'};
+
+  size_t padded(size_t _bytes)
+  {
+    return (_bytes+7)&~size_t(7);
+  }
+}
+
+bool CheckpointWriter::open(const std::string &_path)
+{
+  m_path=_path;
+  m_temporary=_path+".tmp";
+  m_file.open(m_temporary.c_str(),std::ios::out|std::ios::binary|std::ios::trunc);
+  if(!m_file.is_open())
+  {
+    std::cerr<<"Could not open "<<m_temporary<<" to save a checkpoint"<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+void CheckpointWriter::write(const void *_data, size_t _bytes)
+{
+  static const char zeros[8] = {0,0,0,0,0,0,0,0};
+  if(_bytes>0) m_file.write(static_cast<const char *>(_data),_bytes);
+  m_file.write(zeros,padded(_bytes)-_bytes);
+}
+
+bool CheckpointWriter::close()
+{
+  m_file.close();
+  if(m_file.fail() || std::rename(m_temporary.c_str(),m_path.c_str())!=0)
+  {
+    std::cerr<<"Could not save the checkpoint "<<m_path<<std::endl;
+    std::remove(m_temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CheckpointReader::open(const std::string &_path)
+{
+  std::ifstream file(_path.c_str(),std::ios::in|std::ios::binary|std::ios::ate);
+  if(!file.is_open())
+  {
+    std::cerr<<"Could not open the checkpoint "<<_path<<std::endl;
+    return false;
+  }
+
+  // One read of the whole file, the arrays are then copied straight out of it
+  m_data.resize((size_t)file.tellg());
+  file.seekg(0);
+  file.read(m_data.data(),m_data.size());
+  if(!file || m_data.size()<sizeof(CheckpointHeader))
+  {
+    std::cerr<<_path<<" is too short to be a checkpoint"<<std::endl;
+    return false;
+  }
+
+  memcpy(&m_header,m_data.data(),sizeof(CheckpointHeader));
+  if(memcmp(m_header.m_magic,s_magic,4)!=0)
+  {
+    std::cerr<<_path<<" is not a checkpoint"<<std::endl;
+    return false;
+  }
+  if(m_header.m_version!=CheckpointHeader::s_version || m_header.m_headerSize!=sizeof(CheckpointHeader) ||
+     m_header.m_byteOrder!=CheckpointHeader::s_byteOrder)
+  {
+    std::cerr<<_path<<" is a version "<<m_header.m_version<<" checkpoint or from a different platform, this is"
+             <<" version "<<CheckpointHeader::s_version<<std::endl;
+    return false;
+  }
+  if(m_header.m_particles<0 || m_header.m_springs<0 || m_header.m_freeSprings<0 || m_header.m_types<=0)
+  {
+    std::cerr<<_path<<" has a broken header"<<std::endl;
+    return false;
+  }
+  m_position=padded(sizeof(CheckpointHeader));
+  return true;
+}
+
+const void *CheckpointReader::read(size_t _bytes)
+{
+  if(m_position+_bytes>m_data.size()) return nullptr;
+  const void *data = m_data.data()+m_position;
+  m_position+=padded(_bytes);
+  return data;
+}
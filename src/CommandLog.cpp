@@ -0,0 +1,220 @@
+///
+///  @file CommandLog.cpp
+///  @brief records the commands given to a world to a compact binary log and replays them
+
+#include "include/CommandLog.h"
+#include "include/World.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+  /// Reads the variable length integers written by CommandRecorder, flags an error instead of reading past the end
+  class Reader
+  {
+  public:
+    Reader(const std::vector<char> &_data) : m_data(_data), m_position(0), m_error(false) {}
+
+    uint64_t varint()
+    {
+      uint64_t value = 0;
+      for(int shift=0; shift<64; shift+=7)
+      {
+        if(m_position>=m_data.size())
+        {
+          m_error=true;
+          return 0;
+        }
+        uint8_t byte = (uint8_t)m_data[m_position++];
+        value |= uint64_t(byte&0x7f)<<shift;
+        if(!(byte&0x80)) return value;
+      }
+      m_error=true;
+      return 0;
+    }
+
+    int64_t zigzag()
+    {
+      uint64_t value = varint();
+      return (int64_t)(value>>1) ^ -(int64_t)(value&1);
+    }
+
+    uint8_t byte()
+    {
+      if(m_position>=m_data.size())
+      {
+        m_error=true;
+        return 0;
+      }
+      return (uint8_t)m_data[m_position++];
+    }
+
+    bool atEnd() const { return m_position>=m_data.size(); }
+    bool error() const { return m_error; }
+
+  private:
+    const std::vector<char> &m_data;
+    size_t m_position;
+    bool m_error;
+  };
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CommandRecorder::~CommandRecorder()
+{
+  if(m_file.is_open()) close(m_lastStep);
+}
+
+bool CommandRecorder::open(const std::string &_path, int _w, int _h)
+{
+  m_file.open(_path.c_str(),std::ios::out|std::ios::binary|std::ios::trunc);
+  if(!m_file.is_open())
+  {
+    std::cerr<<"Could not open "<<_path<<" to record commands"<<std::endl;
+    return false;
+  }
+  m_file.write(CommandLog::s_magic,4);
+  m_file.put((char)CommandLog::s_version);
+  writeVarint(_w);
+  writeVarint(_h);
+  m_lastStep=0;
+  return true;
+}
+
+void CommandRecorder::record(long _step, const Command &_command)
+{
+  if(!m_file.is_open()) return;
+  if(CommandLog::isCheckpointKey(_command))
+  {
+    // Saving leaves the world as it is, so it is just left out. After a load the world comes from a file the log
+    // does not have, so the log ends there rather than replay into a different world.
+    if(_command.m_x=='l')
+    {
+      std::cerr<<"Checkpoint loaded, the command log stops at step "<<_step<<std::endl;
+      close(_step);
+    }
+    return;
+  }
+  writeVarint(_step-m_lastStep);
+  m_file.put((char)_command.m_type);
+  writeSigned(_command.m_x);
+  writeSigned(_command.m_y);
+  writeSigned(_command.m_w);
+  writeSigned(_command.m_h);
+  m_lastStep=_step;
+}
+
+void CommandRecorder::close(long _step)
+{
+  if(!m_file.is_open()) return;
+  writeVarint(std::max(0L,_step-m_lastStep));
+  m_file.put((char)CommandLog::s_end);
+  m_file.close();
+}
+
+void CommandRecorder::writeVarint(uint64_t _value)
+{
+  while(_value>=0x80)
+  {
+    m_file.put((char)((_value&0x7f)|0x80));
+    _value>>=7;
+  }
+  m_file.put((char)_value);
+}
+
+void CommandRecorder::writeSigned(int64_t _value)
+{
+  // Zigzag so that small negative numbers stay short too
+  writeVarint(((uint64_t)_value<<1) ^ (uint64_t)(_value>>63));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CommandReplayer::open(const std::string &_path)
+{
+  std::ifstream file(_path.c_str(),std::ios::in|std::ios::binary);
+  if(!file.is_open())
+  {
+    std::cerr<<"Could not open command log "<<_path<<std::endl;
+    return false;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+
+  if(data.size()<5 || !std::equal(CommandLog::s_magic,CommandLog::s_magic+4,data.begin()) ||
+     (uint8_t)data[4]!=CommandLog::s_version)
+  {
+    std::cerr<<_path<<" is not a version "<<(int)CommandLog::s_version<<" command log"<<std::endl;
+    return false;
+  }
+
+  Reader reader(data);
+  for(int i=0; i<5; ++i) reader.byte();
+  m_width=(int)reader.varint();
+  m_height=(int)reader.varint();
+
+  m_steps.clear();
+  m_commands.clear();
+  m_next=0;
+  long step = 0;
+  bool ended = false;
+  while(!reader.atEnd() && !reader.error())
+  {
+    step+=(long)reader.varint();
+    uint8_t type = reader.byte();
+    if(type==CommandLog::s_end)
+    {
+      ended=true;
+      break;
+    }
+    if(type>Command::SET_TO_DRAW) // the last type
+    {
+      std::cerr<<_path<<" has an unknown command "<<(int)type<<std::endl;
+      return false;
+    }
+    Command command((Command::Type)type);
+    command.m_x=(int)reader.zigzag();
+    command.m_y=(int)reader.zigzag();
+    command.m_w=(int)reader.zigzag();
+    command.m_h=(int)reader.zigzag();
+    if(reader.error()) break;
+    if(CommandLog::isCheckpointKey(command))
+    {
+      std::cerr<<_path<<" saves or loads checkpoint.ppck, which can't be replayed"<<std::endl;
+      return false;
+    }
+    m_steps.push_back(step);
+    m_commands.push_back(command);
+  }
+
+  // A log cut short by a crash still replays up to its last command
+  if(!ended) std::cerr<<_path<<" has no end record, replaying up to the last command"<<std::endl;
+  m_endStep=step;
+  return true;
+}
+
+void CommandReplayer::start(World &_world)
+{
+  _world.init();
+  _world.resizeWorld(m_width,m_height);
+  m_next=0;
+}
+
+int CommandReplayer::execute(World &_world)
+{
+  int howmany = 0;
+  while(m_next<m_commands.size() && m_steps[m_next]<=_world.getStep())
+  {
+    m_commands[m_next].execute(_world);
+    ++m_next;
+    ++howmany;
+  }
+  return howmany;
+}
+
+bool CommandReplayer::finished(const World &_world) const
+{
+  return m_next>=m_commands.size() && _world.getStep()>=m_endStep;
+}
@@ -0,0 +1,78 @@
+///
+///  @file Commands.cpp
+///  @brief commands from the main loop to the world and the queue that carries them to the simulation thread
+
+#include "include/Commands.h"
+#include "include/CommandLog.h"
+#include "include/World.h"
+
+void Command::execute(World &_world) const
+{
+  switch(m_type)
+  {
+    case CLEAR_WORLD:              _world.clearWorld(); break;
+    case MOUSE_ERASE:              _world.mouseErase(m_x,m_y); break;
+    case MOUSE_DRAW:               _world.mouseDraw(m_x,m_y); break;
+    case MOUSE_DRAG:               _world.mouseDrag(m_x,m_y); break;
+    case SELECT_DRAGGED_PARTICLES: _world.selectDraggedParticles(m_x,m_y); break;
+    case MOUSE_DRAG_END:           _world.mouseDragEnd(m_x,m_y); break;
+    case RESIZE_WORLD:             _world.resizeWorld(m_w,m_h); break;
+    case SET_3D:                   _world.set3D(m_x!=0); break;
+    case HANDLE_KEY:               _world.handleKeys((char)m_x); break;
+    case SET_RANDOM_TYPE:          _world.setRandomType(m_x); break;
+    case TOGGLE_RAIN:              _world.toggleRain(); break;
+    case TOGGLE_GRAVITY:           _world.toggleGravity(); break;
+    case SET_TO_DRAW:              _world.setToDraw(m_x); break;
+  }
+}
+
+CommandQueue::CommandQueue(size_t _capacity) :
+  m_head(0),
+  m_tail(0),
+  m_dropped(0),
+  m_recorder(nullptr)
+{
+  size_t capacity = 2;
+  while(capacity<_capacity) capacity*=2;
+  m_slots.resize(capacity);
+  m_mask=capacity-1;
+}
+
+bool CommandQueue::push(const Command &_command)
+{
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  if(tail-m_head.load(std::memory_order_acquire)>m_mask)
+  {
+    m_dropped.fetch_add(1,std::memory_order_relaxed);
+    return false;
+  }
+  m_slots[tail&m_mask]=_command;
+  m_tail.store(tail+1,std::memory_order_release);
+  return true;
+}
+
+bool CommandQueue::pop(Command &o_command)
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  if(head==m_tail.load(std::memory_order_acquire)) return false;
+  o_command=m_slots[head&m_mask];
+  m_head.store(head+1,std::memory_order_release);
+  return true;
+}
+
+int CommandQueue::execute(World &_world)
+{
+  // Only the commands already waiting, so a busy producer can't hold up the step
+  size_t tail = m_tail.load(std::memory_order_acquire);
+  size_t head = m_head.load(std::memory_order_relaxed);
+  int howmany = 0;
+  for(; head!=tail; ++head)
+  {
+    Command command = m_slots[head&m_mask];
+    m_head.store(head+1,std::memory_order_release);
+    if(m_recorder) m_recorder->record(_world.getStep(),command);
+    command.execute(_world);
+    ++howmany;
+  }
+  return howmany;
+}
@@ -8,6 +8,7 @@
 #endif
 
 #include <iostream>
+#include <string>
 
 #ifdef __APPLE__
   #include <OpenGL/gl.h>
@@ -30,6 +31,9 @@
 #include "include/World.h"
 #include "include/Toolbar.h"
 #include "include/Commands.h"
+#include "include/CommandLog.h"
+#include "include/Trajectory.h"
+#include "include/SimulationThread.h"
 
 
 
@@ -55,14 +59,15 @@ bool leftMouseOnToolbar = false;
 bool leftMouseOnWorldPrevious=false;
 bool rightMouseButton = false;
 bool pookd = false;
-bool updateinprogress = false;
-bool drawInTimer=false;
 
-int frame=0;
-int previousframe=0;
-int framedrawn=0;
+/// Commands from this loop to the simulation thread
+CommandQueue commands;
 
-std::vector<Command*> commands;
+/// Writes the commands to a log when started with --record <file>
+CommandRecorder recorder;
+
+/// Writes the particles of every step to a file when started with --trajectory <file>
+TrajectoryWriter trajectory;
 
 /**
  * @brief initSDL fires up the SDL window and readies it for OpenGL
@@ -102,43 +107,18 @@ int initSDL()
 }
 
 /**
- * @brief timerCallback an SDL2 callback function which will trigger whenever the timer has hit the elapsed time.
- * @param interval The elapsed time (not used - World uses it's own internal clock)
- * @return the elapsed time.
+ * @brief executeCommands runs the commands queued by the main loop, called on the simulation thread before each step
  */
-Uint32 timerCallback(Uint32 interval, void *) {
-    if (world != NULL)
-    {
-      for(auto& i : commands)
-      {
-        i->execute();
-      }
-      for(auto& i : commands)
-      {
-        delete i;
-      }
-      commands.clear();
-
-      if(world->getSnapshotMode()<2)
-        world->update(&updateinprogress);
-
-      if(drawInTimer)
-      {
-        SDL_GL_MakeCurrent(gWindow,gContext);
-        world->draw();
-        toolbar->drawToolbar(HEIGHT);
-        SDL_GL_SwapWindow( gWindow );
-      }
-
-    }
-    ++frame;
-    return interval;
+void executeCommands()
+{
+  commands.execute(*world);
 }
 
 /**
  * @brief main The main opengl loop is managed here
- * @param argc Not used
- * @param args Not used
+ * @param argc Number of arguments
+ * @param args --record <file> writes every command to a log that ParticlePanicReplay can play back,
+ *             --trajectory <file> writes the particles of every step for offline rendering
  * @return EXIT_SUCCESS if it went well!
  */
 
@@ -162,23 +142,34 @@ int main( int argc, char* args[] ) {
 
     toolbar = new Toolbar();
     toolbar->setWorld(world);
+    toolbar->setCommands(&commands);
 
     // Initialise the World
     world->init();
+    world->initGL();
 
     // Need an initial resize to make sure the projection matrix is initialised
     world->resizeWindow(WIDTH, HEIGHT);
     world->resizeWorld(WIDTH, HEIGHT);
+    // So the first frame is drawn at the size of the world, the simulation thread publishes the rest
+    world->publishSnapshot();
 
-    // Use a timer to update our World. This is the best way to handle updates,
-    // as the timer runs in a separate thread and is therefore not affected by the
-    // rendering performance.
-
-    SDL_TimerID timerID = SDL_AddTimer(30, /*elapsed time in milliseconds*/
-                                     timerCallback, /*callback function*/
-                                     (void*) NULL /*parameters (none)*/);
+    for(int a=1; a+1<argc; a+=2)
+    {
+      if(std::string(args[a])=="--record" && recorder.open(args[a+1],WIDTH,HEIGHT))
+      {
+        commands.setRecorder(&recorder);
+      }
+      else if(std::string(args[a])=="--trajectory" && trajectory.open(args[a+1]))
+      {
+        world->setTrajectory(&trajectory);
+      }
+    }
 
-    //glutTimerFunc(30, timerCallback, (void *) NULL);
+    // Update our World on its own thread every 30ms. The main loop only draws the snapshots it
+    // publishes, so drawing and updating never wait for each other.
+    SimulationThread simulation(world, 30);
+    simulation.start(executeCommands);
 
 
     //Main loop flag
@@ -202,10 +193,7 @@ int main( int argc, char* args[] ) {
             {
                 SDL_SetWindowSize(gWindow, e.window.data1, e.window.data2);
 
-                ResizeWorld *newcommand=new ResizeWorld();
-                newcommand->setwh(e.window.data1, e.window.data2);
-                newcommand->setWorld(world);
-                commands.push_back(newcommand);
+                commands.push(Command(Command::RESIZE_WORLD,0,0,e.window.data1,e.window.data2));
 
                 world->resizeWindow(e.window.data1, e.window.data2);
                 WIDTH=e.window.data1;
@@ -248,33 +236,18 @@ int main( int argc, char* args[] ) {
                   bool toSet3D = false;
                   if(e.text.text[0]=='p') toSet3D=true;
 
-                  ClearWorld *newcommand2=new ClearWorld();
-                  newcommand2->setWorld(world);
-                  commands.push_back(newcommand2);
-
-                  Set3D *newcommand=new Set3D();
-                  newcommand->setBool(toSet3D);
-                  newcommand->setWorld(world);
-                  commands.push_back(newcommand);
-
-                  ResizeWorld *newcommand3=new ResizeWorld();
-                  newcommand3->setwh(WIDTH,HEIGHT);
-                  newcommand3->setWorld(world);
-                  commands.push_back(newcommand3);
+                  commands.push(Command(Command::CLEAR_WORLD));
+                  commands.push(Command(Command::SET_3D,toSet3D));
+                  commands.push(Command(Command::RESIZE_WORLD,0,0,WIDTH,HEIGHT));
                 }
               }
               else if(e.text.text[0]=='<' || e.text.text[0]=='>')
               {
-                ClearWorld *newcommand2=new ClearWorld();
-                newcommand2->setWorld(world);
-                commands.push_back(newcommand2);
-
-                ResizeWorld *newcommand3=new ResizeWorld();
-                newcommand3->setwh(WIDTH,HEIGHT);
-                newcommand3->setWorld(world);
-                commands.push_back(newcommand3);
+                commands.push(Command(Command::CLEAR_WORLD));
+                commands.push(Command(Command::RESIZE_WORLD,0,0,WIDTH,HEIGHT));
               }
-              world->handleKeys( e.text.text[ 0 ] );
+              world->handleRenderKeys(e.text.text[ 0 ]);
+              commands.push(Command(Command::HANDLE_KEY,e.text.text[ 0 ]));
               if(!world->getSnapshotMode())
                 toolbar->handleKeys( e.text.text[ 0 ] );
             }
@@ -318,10 +291,7 @@ int main( int argc, char* args[] ) {
                     int x = 0, y = 0;
                     SDL_GetMouseState( &x, &y );
 
-                    MouseDragEnd *newcommand=new MouseDragEnd();
-                    newcommand->setxy(x,y);
-                    newcommand->setWorld(world);
-                    commands.push_back(newcommand);
+                    commands.push(Command(Command::MOUSE_DRAG_END,x,y));
                   }
                 }
                 else if(leftMouseOnToolbar)
@@ -342,7 +312,7 @@ int main( int argc, char* args[] ) {
 
         }
 
-        if(leftMouseOnWorld && !world->get3D())
+        if(leftMouseOnWorld && !world->getDrawnView().m_3d)
         {
           int x = 0, y = 0;
           SDL_GetMouseState(&x, &y);
@@ -350,62 +320,46 @@ int main( int argc, char* args[] ) {
           {
             if(!leftMouseOnWorldPrevious)
             {
-              SelectDraggedParticles *newcommand=new SelectDraggedParticles();
-              newcommand->setWorld(world);
-              newcommand->setxy(x,y);
-              commands.push_back(newcommand);
+              commands.push(Command(Command::SELECT_DRAGGED_PARTICLES,x,y));
 
               leftMouseOnWorldPrevious=true;
             }
 
-            MouseDrag *newcommand=new MouseDrag();
-            newcommand->setWorld(world);
-            newcommand->setxy(x,y);
-            commands.push_back(newcommand);
+            commands.push(Command(Command::MOUSE_DRAG,x,y));
           }
           else if(toolbar->getDraw())
           {
-            MouseDraw *newcommand=new MouseDraw();
-            newcommand->setWorld(world);
-            newcommand->setxy(x,y);
-            commands.push_back(newcommand);
+            commands.push(Command(Command::MOUSE_DRAW,x,y));
           }
           else if(toolbar->getErase())
           {
-            MouseErase *newcommand=new MouseErase();
-            newcommand->setWorld(world);
-            newcommand->setxy(x,y);
-            commands.push_back(newcommand);
+            commands.push(Command(Command::MOUSE_ERASE,x,y));
           }
         }
 
-        else if(rightMouseButton && !world->get3D())
+        else if(rightMouseButton && !world->getDrawnView().m_3d)
         {
           int x = 0, y = 0;
           SDL_GetMouseState(&x, &y);
           std::cout<<"heyboos"<<std::endl;
 
-          MouseDraw *newcommand=new MouseDraw();
-          newcommand->setWorld(world);
-          newcommand->setxy(x,y);
-          commands.push_back(newcommand);
+          commands.push(Command(Command::MOUSE_DRAW,x,y));
         }
 
-        if(!drawInTimer)
-        {
-          world->draw();
+        world->draw();
 
-          toolbar->drawToolbar(HEIGHT);
+        toolbar->drawToolbar(HEIGHT);
 
-          SDL_GL_SwapWindow( gWindow );
-        }
+        SDL_GL_SwapWindow( gWindow );
     }
 
     //Disable text input
     SDL_StopTextInput();
 
-    // Disable our timer
-    SDL_RemoveTimer(timerID);
+    // Stop updating
+    simulation.stop();
+    recorder.close(world->getStep());
+    trajectory.close();
 
     world->clearWorld();
 
@@ -8,15 +8,15 @@
 /// The following section is modified from :-
 /// Paul Bourke (1994). Polygonising a scalar field [online]. [Accessed 2016].
 /// Available from: <http://paulbourke.net/geometry/polygonise/>.
-void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vector<float>>> renderGrid, ParticleProperties p)
+void MarchingAlgorithms::calculateMarchingCubes(const FieldBuffer &renderGrid, const ParticleProperties &p)
 {
   float red = p.getRed();
   float green = p.getGreen();
   float blue = p.getBlue();
 
-  int render3dwidth=renderGrid.size()-1;
-  int render3dheight=renderGrid[0].size()-1;
-  int render3ddepth=renderGrid[0][0].size()-1;
+  int render3dwidth=renderGrid.size(0)-1;
+  int render3dheight=renderGrid.size(1)-1;
+  int render3ddepth=renderGrid.size(2)-1;
 
   float isolevel=m_render3dThreshold; //can set at initialization
 
@@ -29,15 +29,15 @@ void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vec
       {
         float gridvalue[8];
 
-        gridvalue[0]=renderGrid[w][h][d];     //0
-        gridvalue[1]=renderGrid[w+1][h][d];   //1
-        gridvalue[2]=renderGrid[w+1][h][d+1];   //2
-        gridvalue[3]=renderGrid[w][h][d+1];     //3
+        gridvalue[0]=renderGrid.at(w,h,d);     //0
+        gridvalue[1]=renderGrid.at(w+1,h,d);   //1
+        gridvalue[2]=renderGrid.at(w+1,h,d+1);   //2
+        gridvalue[3]=renderGrid.at(w,h,d+1);     //3
 
-        gridvalue[4]=renderGrid[w][h+1][d];     //4
-        gridvalue[5]=renderGrid[w+1][h+1][d];   //5
-        gridvalue[6]=renderGrid[w+1][h+1][d+1];     //6
-        gridvalue[7]=renderGrid[w][h+1][d+1];       //7
+        gridvalue[4]=renderGrid.at(w,h+1,d);     //4
+        gridvalue[5]=renderGrid.at(w+1,h+1,d);   //5
+        gridvalue[6]=renderGrid.at(w+1,h+1,d+1);     //6
+        gridvalue[7]=renderGrid.at(w,h+1,d+1);       //7
 
         float rendersquare=m_squaresize/m_render3dresolution;
 
@@ -151,7 +151,7 @@ void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vec
       {
         for(int d=0; d<render3ddepth; ++d)
         {
-          for(int k=0; k<m_snapshot3DTriangles[w][h][d].size(); k+=7)
+          for(int k=0; k<(int)m_snapshot3DTriangles[w][h][d].size(); k+=7)
           {
             for(int j=1; j<7; j+=2)
             {
@@ -165,7 +165,7 @@ void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vec
                        h+ha<render3dheight && h+ha>=0 &&
                        d+da<render3ddepth && d+da>=0)
                     {
-                      for(int p=0; p<m_snapshot3DTriangles[w+wa][h+ha][d+da].size(); p+=7)
+                      for(int p=0; p<(int)m_snapshot3DTriangles[w+wa][h+ha][d+da].size(); p+=7)
                       {
                         for(int l=1; l<7; l+=2)
                         {
@@ -201,7 +201,7 @@ void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vec
       {
         for(int d=0; d<render3ddepth-1; ++d)
         {
-          for(int k=0; k<m_snapshot3DTriangles[w][h][d].size(); k+=7)
+          for(int k=0; k<(int)m_snapshot3DTriangles[w][h][d].size(); k+=7)
           {
             for(int j=1; j<7; j+=2)
             {
@@ -216,8 +216,8 @@ void MarchingAlgorithms::calculateMarchingCubes(std::vector<std::vector<std::vec
 }
 /// end of Citation
 
-void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<float>> renderGrid,
-                                                  const ParticleProperties p,
+void MarchingAlgorithms::calculateMarchingSquares(const FieldBuffer &renderGrid,
+                                                  const ParticleProperties &p,
                                                   const bool inner)
 {
   float red = p.getRed();
@@ -226,8 +226,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
 
   float renderthreshold = m_render2dThreshold;
 
-  int renderheight = renderGrid.size()-1;
-  int renderwidth = renderGrid[0].size()-1;
+  int renderheight = renderGrid.size(0)-1;
+  int renderwidth = renderGrid.size(1)-1;
 
   if(inner)
   {
@@ -252,10 +252,10 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
 
 
       std::vector<bool> boolpoints;
-      boolpoints.push_back(renderGrid[currentrow][currentcolumn]>renderthreshold);
-      boolpoints.push_back(renderGrid[currentrow][currentcolumn+1]>renderthreshold);
-      boolpoints.push_back(renderGrid[currentrow+1][currentcolumn]>renderthreshold);
-      boolpoints.push_back(renderGrid[currentrow+1][currentcolumn+1]>renderthreshold);
+      boolpoints.push_back(renderGrid.at(currentrow,currentcolumn)>renderthreshold);
+      boolpoints.push_back(renderGrid.at(currentrow,currentcolumn+1)>renderthreshold);
+      boolpoints.push_back(renderGrid.at(currentrow+1,currentcolumn)>renderthreshold);
+      boolpoints.push_back(renderGrid.at(currentrow+1,currentcolumn+1)>renderthreshold);
 
       bool empty=false;
 
@@ -307,8 +307,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&!boolpoints[1]&&!boolpoints[2]&&boolpoints[3]) //0001 TICK
         {
-          float p6y=p2y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow][currentcolumn+1]));
-          float p7x=p3x+rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn]));
+          float p6y=p2y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p7x=p3x+rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -319,8 +319,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&!boolpoints[1]&&boolpoints[2]&&!boolpoints[3]) //0010 TICK
         {
-          float p8y=p1y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow][currentcolumn]));
-          float p7x=p4x-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow+1][currentcolumn+1]));
+          float p8y=p1y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow,currentcolumn)));
+          float p7x=p4x-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn+1)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -331,8 +331,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&!boolpoints[1]&&boolpoints[2]&&boolpoints[3]) //0011 TICk QUAD
         {
-          float p8y=p1y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow][currentcolumn]));
-          float p6y=p2y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow][currentcolumn+1]));
+          float p8y=p1y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow,currentcolumn)));
+          float p6y=p2y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn+1)));
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
           m_realtime2DTriangles.push_back(Vec3(p8x,p8y,-2.0f));
@@ -346,8 +346,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&boolpoints[1]&&!boolpoints[2]&&!boolpoints[3]) //0100 TICK
         {
-          float p6y=p4y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn+1]));
-          float p5x=p1x+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow][currentcolumn]));
+          float p6y=p4y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn+1)));
+          float p5x=p1x+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -358,8 +358,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&boolpoints[1]&&!boolpoints[2]&&boolpoints[3]) //0101 TICK QUAD
         {
-          float p5x=p1x+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow][currentcolumn]));
-          float p7x=p3x+rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn]));
+          float p5x=p1x+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn)));
+          float p7x=p3x+rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn)));
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
           m_realtime2DTriangles.push_back(Vec3(p5x,p5y,-2.0f));
@@ -373,10 +373,10 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&boolpoints[1]&&boolpoints[2]&&!boolpoints[3]) //0110 COULD CHANGE TO SEE
         {
-          float p5x=p1x+(p2x-p1x)*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow][currentcolumn]));
-          float p6y=p4y+(p2y-p4y)*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn+1]));
-          float p7x=p4x+(p3x-p4x)*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow+1][currentcolumn+1]));
-          float p8y=p1y+(p3y-p1y)*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow][currentcolumn]));
+          float p5x=p1x+(p2x-p1x)*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn)));
+          float p6y=p4y+(p2y-p4y)*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn+1)));
+          float p7x=p4x+(p3x-p4x)*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn+1)));
+          float p8y=p1y+(p3y-p1y)*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -403,8 +403,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(!boolpoints[0]&&boolpoints[1]&&boolpoints[2]&&boolpoints[3]) //0111 TICK
         {
-          float p5x=p1x+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow][currentcolumn]));
-          float p8y=p1y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow][currentcolumn]));
+          float p5x=p1x+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn)));
+          float p8y=p1y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -422,8 +422,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&!boolpoints[1]&&!boolpoints[2]&&!boolpoints[3]) //1000 TICK
         {
-          float p5x=p2x-rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow][currentcolumn+1]));
-          float p8y=p3y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow+1][currentcolumn]));
+          float p5x=p2x-rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p8y=p3y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -434,10 +434,10 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&!boolpoints[1]&&!boolpoints[2]&&boolpoints[3]) //1001 COULD CHANGE TO SEE
         {
-          float p5x=p2x+(p1x-p2x)*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow][currentcolumn+1]));
-          float p6y=p2y+(p4y-p2y)*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow][currentcolumn+1]));
-          float p7x=p3x+(p4x-p3x)*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn]));
-          float p8y=p3y+(p1y-p3y)*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow+1][currentcolumn]));
+          float p5x=p2x+(p1x-p2x)*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p6y=p2y+(p4y-p2y)*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p7x=p3x+(p4x-p3x)*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn)));
+          float p8y=p3y+(p1y-p3y)*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn)));
 
 
 
@@ -465,8 +465,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&!boolpoints[1]&&boolpoints[2]&&!boolpoints[3]) //1010 TICK QUAD
         {
-          float p5x=p2x-rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow][currentcolumn+1]));
-          float p7x=p4x-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow+1][currentcolumn+1]));
+          float p5x=p2x-rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p7x=p4x-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn+1)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -482,8 +482,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&!boolpoints[1]&&boolpoints[2]&&boolpoints[3]) //1011 TICK
         {
-          float p5x=p2x-rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow][currentcolumn+1]));
-          float p6y=p2y+rendersquare*((renderthreshold-renderGrid[currentrow][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow][currentcolumn+1]));
+          float p5x=p2x-rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow,currentcolumn+1)));
+          float p6y=p2y+rendersquare*((renderthreshold-renderGrid.at(currentrow,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow,currentcolumn+1)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -502,8 +502,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&boolpoints[1]&&!boolpoints[2]&&!boolpoints[3]) //1100 TICK QUAD
         {
-          float p6y=p4y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn+1]));
-          float p8y=p3y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow+1][currentcolumn]));
+          float p6y=p4y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn+1)));
+          float p8y=p3y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -518,8 +518,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&boolpoints[1]&&!boolpoints[2]&&boolpoints[3]) //1101 TICK
         {
-          float p7x=p3x+rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow+1][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn]));
-          float p8y=p3y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn])/(renderGrid[currentrow][currentcolumn]-renderGrid[currentrow+1][currentcolumn]));
+          float p7x=p3x+rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow+1,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn)));
+          float p8y=p3y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn))/(renderGrid.at(currentrow,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -538,8 +538,8 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
         }
         else if(boolpoints[0]&&boolpoints[1]&&boolpoints[2]&&!boolpoints[3]) //1110
         {
-          float p7x=p4x-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow+1][currentcolumn]-renderGrid[currentrow+1][currentcolumn+1]));
-          float p6y=p4y-rendersquare*((renderthreshold-renderGrid[currentrow+1][currentcolumn+1])/(renderGrid[currentrow][currentcolumn+1]-renderGrid[currentrow+1][currentcolumn+1]));
+          float p7x=p4x-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow+1,currentcolumn)-renderGrid.at(currentrow+1,currentcolumn+1)));
+          float p6y=p4y-rendersquare*((renderthreshold-renderGrid.at(currentrow+1,currentcolumn+1))/(renderGrid.at(currentrow,currentcolumn+1)-renderGrid.at(currentrow+1,currentcolumn+1)));
 
 
           m_realtime2DTriangles.push_back(Vec3(red,green,blue));
@@ -561,62 +561,6 @@ void MarchingAlgorithms::calculateMarchingSquares(const std::vector<std::vector<
   }
 }
 
-void MarchingAlgorithms::draw3DSnapshot()
-{
-  glBegin(GL_TRIANGLES);
-  for(auto& i : m_snapshot3DTriangles)
-  {
-    for(auto& j : i)
-    {
-      for(auto& k : j)
-      {
-        for(int l = 0; l<(int)k.size() ; l+=7)
-        {
-          glColor3f(k[l][0],k[l][1],k[l][2]);
-          glNormal3f(k[l+1][0],k[l+1][1],k[l+1][2]);
-          glVertex3f(k[l+2][0],k[l+2][1],k[l+2][2]);
-          glNormal3f(k[l+3][0],k[l+3][1],k[l+3][2]);
-          glVertex3f(k[l+4][0],k[l+4][1],k[l+4][2]);
-          glNormal3f(k[l+5][0],k[l+5][1],k[l+5][2]);
-          glVertex3f(k[l+6][0],k[l+6][1],k[l+6][2]);
-        }
-      }
-    }
-  }
-  glEnd();
-}
-
-void MarchingAlgorithms::draw3DRealtime()
-{
-  glBegin(GL_TRIANGLES);
-  for(int i =0; i<m_realtime3DTriangles.size(); i+=5)
-  {
-    glColor3f(m_realtime3DTriangles[i][0],m_realtime3DTriangles[i][1],m_realtime3DTriangles[i][2]);
-    glNormal3f(m_realtime3DTriangles[i+1][0],m_realtime3DTriangles[i+1][1],m_realtime3DTriangles[i+1][2]);
-    glVertex3f(m_realtime3DTriangles[i+2][0],m_realtime3DTriangles[i+2][1],m_realtime3DTriangles[i+2][2]);
-    glVertex3f(m_realtime3DTriangles[i+3][0],m_realtime3DTriangles[i+3][1],m_realtime3DTriangles[i+3][2]);
-    glVertex3f(m_realtime3DTriangles[i+4][0],m_realtime3DTriangles[i+4][1],m_realtime3DTriangles[i+4][2]);
-  }
-  glEnd();
-  clearRealtime3DTriangles();
-}
-
-void MarchingAlgorithms::draw2DRealtime()
-{
-  glDisable(GL_LIGHTING);
-  glBegin(GL_TRIANGLES);
-  for(int i =0; i<(int)m_realtime2DTriangles.size(); i+=4)
-  {
-    glColor3f(m_realtime2DTriangles[i][0],m_realtime2DTriangles[i][1],m_realtime2DTriangles[i][2]);
-    glVertex3f(m_realtime2DTriangles[i+1][0],m_realtime2DTriangles[i+1][1],m_realtime2DTriangles[i+1][2]);
-    glVertex3f(m_realtime2DTriangles[i+2][0],m_realtime2DTriangles[i+2][1],m_realtime2DTriangles[i+2][2]);
-    glVertex3f(m_realtime2DTriangles[i+3][0],m_realtime2DTriangles[i+3][1],m_realtime2DTriangles[i+3][2]);
-  }
-  glEnd();
-  glEnable(GL_LIGHTING);
-  clearRealtime2DTriangles();
-}
-
 /// The following section is modified from :-
 /// Paul Bourke (1994). Polygonising a scalar field [online]. [Accessed 2016].
 /// Available from: <http://paulbourke.net/geometry/polygonise/>.
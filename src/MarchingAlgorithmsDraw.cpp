@@ -0,0 +1,70 @@
+///
+///  @file    MarchingAlgorithmsDraw.cpp
+///  @brief   OpenGL drawing of the marching cube / square triangles. Kept apart from MarchingAlgorithms.cpp so the
+///           simulation core builds without OpenGL.
+
+#include "include/MarchingAlgorithms.h"
+
+#ifdef __APPLE__
+  #include <OpenGL/gl.h>
+  #include <OpenGL/glu.h>
+#else
+  #include <GL/gl.h>
+  #include <GL/glu.h>
+#endif
+
+void MarchingAlgorithms::draw3DSnapshot()
+{
+  glBegin(GL_TRIANGLES);
+  for(auto& i : m_snapshot3DTriangles)
+  {
+    for(auto& j : i)
+    {
+      for(auto& k : j)
+      {
+        for(int l = 0; l<(int)k.size() ; l+=7)
+        {
+          glColor3f(k[l][0],k[l][1],k[l][2]);
+          glNormal3f(k[l+1][0],k[l+1][1],k[l+1][2]);
+          glVertex3f(k[l+2][0],k[l+2][1],k[l+2][2]);
+          glNormal3f(k[l+3][0],k[l+3][1],k[l+3][2]);
+          glVertex3f(k[l+4][0],k[l+4][1],k[l+4][2]);
+          glNormal3f(k[l+5][0],k[l+5][1],k[l+5][2]);
+          glVertex3f(k[l+6][0],k[l+6][1],k[l+6][2]);
+        }
+      }
+    }
+  }
+  glEnd();
+}
+
+void MarchingAlgorithms::draw3DRealtime()
+{
+  glBegin(GL_TRIANGLES);
+  for(int i =0; i<(int)m_realtime3DTriangles.size(); i+=5)
+  {
+    glColor3f(m_realtime3DTriangles[i][0],m_realtime3DTriangles[i][1],m_realtime3DTriangles[i][2]);
+    glNormal3f(m_realtime3DTriangles[i+1][0],m_realtime3DTriangles[i+1][1],m_realtime3DTriangles[i+1][2]);
+    glVertex3f(m_realtime3DTriangles[i+2][0],m_realtime3DTriangles[i+2][1],m_realtime3DTriangles[i+2][2]);
+    glVertex3f(m_realtime3DTriangles[i+3][0],m_realtime3DTriangles[i+3][1],m_realtime3DTriangles[i+3][2]);
+    glVertex3f(m_realtime3DTriangles[i+4][0],m_realtime3DTriangles[i+4][1],m_realtime3DTriangles[i+4][2]);
+  }
+  glEnd();
+  clearRealtime3DTriangles();
+}
+
+void MarchingAlgorithms::draw2DRealtime()
+{
+  glDisable(GL_LIGHTING);
+  glBegin(GL_TRIANGLES);
+  for(int i =0; i<(int)m_realtime2DTriangles.size(); i+=4)
+  {
+    glColor3f(m_realtime2DTriangles[i][0],m_realtime2DTriangles[i][1],m_realtime2DTriangles[i][2]);
+    glVertex3f(m_realtime2DTriangles[i+1][0],m_realtime2DTriangles[i+1][1],m_realtime2DTriangles[i+1][2]);
+    glVertex3f(m_realtime2DTriangles[i+2][0],m_realtime2DTriangles[i+2][1],m_realtime2DTriangles[i+2][2]);
+    glVertex3f(m_realtime2DTriangles[i+3][0],m_realtime2DTriangles[i+3][1],m_realtime2DTriangles[i+3][2]);
+  }
+  glEnd();
+  glEnable(GL_LIGHTING);
+  clearRealtime2DTriangles();
+}
@@ -6,7 +6,7 @@
 
 #include "include/Mat3.h"
 
-Mat3::Mat3(GLfloat _s) :
+Mat3::Mat3(float _s) :
   m_00(_s),
   m_01(0.0f),
   m_02(0.0f),
@@ -25,7 +25,7 @@ Mat3::Mat3(float input[9])
   }
 }
 
-GLfloat & Mat3::operator [](int _i)
+float & Mat3::operator [](int _i)
 {
   assert(_i>=0 && _i<=8);
   return m_openGL[_i];
@@ -0,0 +1,93 @@
+///
+///  @file NeighbourList.cpp
+///  @brief per particle list of neighbours with cached distances, shared by the spring and double density passes
+
+#include "include/NeighbourList.h"
+
+#include <cmath>
+
+void NeighbourList::beginBuild(int _count)
+{
+  m_count=_count;
+  m_start.assign(_count+1,0);
+  m_neighbours.clear();
+  m_distance.clear();
+  m_valid=false;
+}
+
+void NeighbourList::endBuild(const ParticleStore &_store)
+{
+  m_start[m_count]=(int)m_neighbours.size();
+  m_builtx.assign(_store.m_x.begin(),_store.m_x.begin()+m_count);
+  m_builty.assign(_store.m_y.begin(),_store.m_y.begin()+m_count);
+  m_builtz.assign(_store.m_z.begin(),_store.m_z.begin()+m_count);
+  m_valid=true;
+}
+
+float NeighbourList::maxDisplacementSquared(const ParticleStore &_store) const
+{
+  float result = 0.0f;
+  for(int i=0; i<m_count; ++i)
+  {
+    float dx = _store.m_x[i]-m_builtx[i];
+    float dy = _store.m_y[i]-m_builty[i];
+    float dz = _store.m_z[i]-m_builtz[i];
+    float moved = dx*dx + dy*dy + dz*dz;
+    if(moved>result) result=moved;
+  }
+  return result;
+}
+
+void NeighbourList::refreshDistances(const ParticleStore &_store)
+{
+  const float *x = _store.m_x.data();
+  const float *y = _store.m_y.data();
+  const float *z = _store.m_z.data();
+  for(int i=0; i<m_count; ++i)
+  {
+    for(int e=m_start[i]; e<m_start[i+1]; ++e)
+    {
+      int j = m_neighbours[e];
+      float rijx = x[j]-x[i];
+      float rijy = y[j]-y[i];
+      float rijz = z[j]-z[i];
+      m_distance[e]=sqrt(rijx*rijx + rijy*rijy + rijz*rijz);
+    }
+  }
+}
+
+void NeighbourList::reorder(const std::vector<int> &_order, const std::vector<int> &_remap)
+{
+  m_scratchStart.resize(m_count+1);
+  m_scratchNeighbours.resize(m_neighbours.size());
+  m_scratchDistance.resize(m_distance.size());
+
+  int e = 0;
+  for(int k=0; k<m_count; ++k)
+  {
+    int old = _order[k];
+    m_scratchStart[k]=e;
+    for(int oe=m_start[old]; oe<m_start[old+1]; ++oe)
+    {
+      m_scratchNeighbours[e]=_remap[m_neighbours[oe]];
+      m_scratchDistance[e]=m_distance[oe];
+      ++e;
+    }
+  }
+  m_scratchStart[m_count]=e;
+
+  m_start.swap(m_scratchStart);
+  m_neighbours.swap(m_scratchNeighbours);
+  m_distance.swap(m_scratchDistance);
+
+  std::vector<float> *built[3] = {&m_builtx, &m_builty, &m_builtz};
+  for(auto& b : built)
+  {
+    m_scratchBuilt.resize(m_count);
+    for(int k=0; k<m_count; ++k)
+    {
+      m_scratchBuilt[k]=(*b)[_order[k]];
+    }
+    b->swap(m_scratchBuilt);
+  }
+}
@@ -4,38 +4,6 @@
 
 #include "include/Particle.h"
 
-void Particle::drawParticle(const float _pointsize)
-{
-  if(!m_wall)
-  {
-    float fast=m_velocity.length()*5;
-
-    if(fast>1.0f) fast=1.0f;
-
-    if(m_properties->getColourEffect())
-      glColor3f(m_properties->getRed()+fast,m_properties->getGreen()+fast,m_properties->getBlue()+fast);
-    else
-      glColor3f(m_properties->getRed(),m_properties->getGreen(),m_properties->getBlue());
-  }
-  else
-  {
-    glColor3f(1.0f,0.0f,0.0f);
-  }
-
-  glMatrixMode(GL_MODELVIEW);
-
-  glPushMatrix();
-  glTranslatef(m_position[0], m_position[1], m_position[2]);
-
-  GLUquadricObj *quadric;
-  quadric = gluNewQuadric();
-  gluQuadricDrawStyle(quadric, GLU_FILL );
-  gluSphere( quadric , 0.25*(_pointsize/10.f) , 16 , 16 );
-  gluDeleteQuadric(quadric);
-
-  glPopMatrix();
-}
-
 void Particle::updatePosition(double _elapsedtime, float _halfheight, float _halfwidth, bool is3D)
 {
   m_position+=m_velocity*_elapsedtime;
@@ -185,12 +153,12 @@ void Particle::setInit()
   m_init=true;
 }
 
-bool Particle::isInit()
+bool Particle::isInit() const
 {
   return m_init;
 }
 
-bool Particle::isObject()
+bool Particle::isObject() const
 {
   return m_isPartOfObject;
 }
@@ -200,7 +168,7 @@ void Particle::setAlive(bool _i)
   m_alive=_i;
 }
 
-bool Particle::getAlive()
+bool Particle::getAlive() const
 {
   return m_alive;
 }
@@ -210,7 +178,7 @@ void Particle::setIndex(int _i)
   m_index=_i;
 }
 
-int Particle::getIndex()
+int Particle::getIndex() const
 {
   return m_index;
 }
@@ -0,0 +1,45 @@
+///
+///  @file ParticleDraw.cpp
+///  @brief OpenGL drawing of a particle, kept apart from Particle.cpp so the simulation core builds without OpenGL.
+
+#include "include/Particle.h"
+
+#ifdef __APPLE__
+  #include <OpenGL/gl.h>
+  #include <OpenGL/glu.h>
+#else
+  #include <GL/gl.h>
+  #include <GL/glu.h>
+#endif
+
+void Particle::drawParticle(const float _pointsize)
+{
+  if(!m_wall)
+  {
+    float fast=m_velocity.length()*5;
+
+    if(fast>1.0f) fast=1.0f;
+
+    if(m_properties->getColourEffect())
+      glColor3f(m_properties->getRed()+fast,m_properties->getGreen()+fast,m_properties->getBlue()+fast);
+    else
+      glColor3f(m_properties->getRed(),m_properties->getGreen(),m_properties->getBlue());
+  }
+  else
+  {
+    glColor3f(1.0f,0.0f,0.0f);
+  }
+
+  glMatrixMode(GL_MODELVIEW);
+
+  glPushMatrix();
+  glTranslatef(m_position[0], m_position[1], m_position[2]);
+
+  GLUquadricObj *quadric;
+  quadric = gluNewQuadric();
+  gluQuadricDrawStyle(quadric, GLU_FILL );
+  gluSphere( quadric , 0.25*(_pointsize/10.f) , 16 , 16 );
+  gluDeleteQuadric(quadric);
+
+  glPopMatrix();
+}
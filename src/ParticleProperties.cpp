@@ -4,57 +4,57 @@
 
 #include "include/ParticleProperties.h"
 
-GLfloat ParticleProperties::getAlpha() const
+float ParticleProperties::getAlpha() const
 {
   return m_alpha;
 }
 
-GLfloat ParticleProperties::getBeta() const
+float ParticleProperties::getBeta() const
 {
   return m_beta;
 }
 
-GLfloat ParticleProperties::getGamma() const
+float ParticleProperties::getGamma() const
 {
   return m_gamma;
 }
 
-GLfloat ParticleProperties::getSigma() const
+float ParticleProperties::getSigma() const
 {
   return m_sigma;
 }
 
-GLfloat ParticleProperties::getKnear() const
+float ParticleProperties::getKnear() const
 {
   return m_knear;
 }
 
-GLfloat ParticleProperties::getK() const
+float ParticleProperties::getK() const
 {
   return m_k;
 }
 
-GLfloat ParticleProperties::getKspring() const
+float ParticleProperties::getKspring() const
 {
   return m_kspring;
 }
 
-GLfloat ParticleProperties::getRed() const
+float ParticleProperties::getRed() const
 {
   return m_red;
 }
 
-GLfloat ParticleProperties::getBlue() const
+float ParticleProperties::getBlue() const
 {
   return m_blue;
 }
 
-GLfloat ParticleProperties::getGreen() const
+float ParticleProperties::getGreen() const
 {
   return m_green;
 }
 
-GLfloat ParticleProperties::getP0() const
+float ParticleProperties::getP0() const
 {
   return m_p0;
 }
@@ -0,0 +1,168 @@
+///
+///  @file ParticleStore.cpp
+///  @brief structure-of-arrays storage for all particles in the world
+
+#include "include/ParticleStore.h"
+
+#include <algorithm>
+
+void ParticleStore::resize(int _size)
+{
+  m_x.resize(_size,0.0f);
+  m_y.resize(_size,0.0f);
+  m_z.resize(_size,0.0f);
+  m_prevx.resize(_size,0.0f);
+  m_prevy.resize(_size,0.0f);
+  m_prevz.resize(_size,0.0f);
+  m_velx.resize(_size,0.0f);
+  m_vely.resize(_size,0.0f);
+  m_velz.resize(_size,0.0f);
+  m_type.resize(_size,0);
+  m_flags.resize(_size,0);
+  m_gridPosition.resize(_size,-1);
+  m_id.resize(_size,-1);
+  m_restx.resize(_size,0.0f);
+  m_resty.resize(_size,0.0f);
+  m_restz.resize(_size,0.0f);
+  m_restSteps.resize(_size,0);
+}
+
+void ParticleStore::clear()
+{
+  resize(0);
+}
+
+void ParticleStore::set(int _i, const Particle &_p, int _type)
+{
+  Vec3 position = _p.getPosition();
+  Vec3 prevposition = _p.getPrevPosition();
+  Vec3 velocity = _p.getVelocity();
+
+  m_x[_i]=position[0];
+  m_y[_i]=position[1];
+  m_z[_i]=position[2];
+  m_prevx[_i]=prevposition[0];
+  m_prevy[_i]=prevposition[1];
+  m_prevz[_i]=prevposition[2];
+  m_velx[_i]=velocity[0];
+  m_vely[_i]=velocity[1];
+  m_velz[_i]=velocity[2];
+  m_type[_i]=_type;
+  m_gridPosition[_i]=-1;
+  resetRest(_i);
+
+  m_flags[_i]=0;
+  setFlag(_i,ALIVE,_p.getAlive());
+  setFlag(_i,WALL,_p.getWall());
+  setFlag(_i,DRAG,_p.getDrag());
+  setFlag(_i,OBJECT,_p.isObject());
+  setFlag(_i,INIT,_p.isInit());
+}
+
+void ParticleStore::move(int _from, int _to)
+{
+  m_x[_to]=m_x[_from];
+  m_y[_to]=m_y[_from];
+  m_z[_to]=m_z[_from];
+  m_prevx[_to]=m_prevx[_from];
+  m_prevy[_to]=m_prevy[_from];
+  m_prevz[_to]=m_prevz[_from];
+  m_velx[_to]=m_velx[_from];
+  m_vely[_to]=m_vely[_from];
+  m_velz[_to]=m_velz[_from];
+  m_type[_to]=m_type[_from];
+  m_flags[_to]=m_flags[_from];
+  m_gridPosition[_to]=m_gridPosition[_from];
+  m_id[_to]=m_id[_from];
+  m_restx[_to]=m_restx[_from];
+  m_resty[_to]=m_resty[_from];
+  m_restz[_to]=m_restz[_from];
+  m_restSteps[_to]=m_restSteps[_from];
+
+  m_flags[_from]=0;
+}
+
+namespace
+{
+  template <typename T>
+  void gather(std::vector<T> &io_array, std::vector<T> &io_scratch, const std::vector<int> &_order, int _count)
+  {
+    io_scratch.resize(io_array.size());
+    for(int k=0; k<_count; ++k)
+    {
+      io_scratch[k]=io_array[_order[k]];
+    }
+    io_array.swap(io_scratch);
+  }
+}
+
+void ParticleStore::reorder(const std::vector<int> &_order, int _count)
+{
+  gather(m_x,m_scratchFloat,_order,_count);
+  gather(m_y,m_scratchFloat,_order,_count);
+  gather(m_z,m_scratchFloat,_order,_count);
+  gather(m_prevx,m_scratchFloat,_order,_count);
+  gather(m_prevy,m_scratchFloat,_order,_count);
+  gather(m_prevz,m_scratchFloat,_order,_count);
+  gather(m_velx,m_scratchFloat,_order,_count);
+  gather(m_vely,m_scratchFloat,_order,_count);
+  gather(m_velz,m_scratchFloat,_order,_count);
+  gather(m_type,m_scratchInt,_order,_count);
+  gather(m_gridPosition,m_scratchInt,_order,_count);
+  gather(m_id,m_scratchInt,_order,_count);
+  gather(m_restx,m_scratchFloat,_order,_count);
+  gather(m_resty,m_scratchFloat,_order,_count);
+  gather(m_restz,m_scratchFloat,_order,_count);
+  gather(m_restSteps,m_scratchInt,_order,_count);
+
+  gather(m_flags,m_scratchFlags,_order,_count);
+  std::fill(m_flags.begin()+_count,m_flags.end(),0);
+}
+
+void ParticleStore::addPosition(int _i, float _dx, float _dy, float _dz, float _halfheight, float _halfwidth, bool _is3D)
+{
+  float smallen = 1.0f;
+  if(_is3D) smallen = 0.4f;
+
+  float x = m_x[_i]+_dx;
+  float y = m_y[_i]+_dy;
+  float z = m_z[_i]+_dz;
+
+  if(x>(_halfwidth-0.5f)*smallen) x=(_halfwidth-0.5f)*smallen;
+  else if(x<(-_halfwidth+0.5f)*smallen) x=(-_halfwidth+0.5f)*smallen;
+
+  if(y<-_halfheight+0.5f) y=-_halfheight+0.5f;
+  else if(y>_halfheight-1.5f) y=_halfheight-1.5f;
+
+  if(z>(_halfwidth-0.5f)*smallen) z=(_halfwidth-0.5f)*smallen;
+  else if(z<(-_halfwidth+0.5f)*smallen) z=(-_halfwidth+0.5f)*smallen;
+
+  m_x[_i]=x;
+  m_y[_i]=y;
+  m_z[_i]=z;
+}
+
+void ParticleStore::updatePosition(int _i, float _timestep, float _halfheight, float _halfwidth, bool _is3D)
+{
+  float smallen = 1.0f;
+  if(_is3D) smallen = 0.4f;
+
+  float x = m_x[_i]+m_velx[_i]*_timestep;
+  float y = m_y[_i]+m_vely[_i]*_timestep;
+  float z = m_z[_i]+m_velz[_i]*_timestep;
+
+  if(x>(_halfwidth-0.5f)*smallen) x=(_halfwidth-0.5f)*smallen;
+  else if(x<(-_halfwidth+0.5f)*smallen) x=(-_halfwidth+0.5f)*smallen;
+
+  if(y<-_halfheight+0.5f) y=-_halfheight+0.5f;
+  else if(y>_halfheight-1.5f) y=_halfheight-1.5f;
+
+  // The z test is not scaled by smallen, same as Particle::updatePosition
+  if(z>(_halfwidth-0.5f)) z=(_halfwidth-0.5f)*smallen;
+  else if(z<(-_halfwidth+0.5f)) z=(-_halfwidth+0.5f)*smallen;
+
+  m_x[_i]=x;
+  m_y[_i]=y;
+  m_z[_i]=z;
+}
+
@@ -0,0 +1,112 @@
+///
+///  @file PhaseTimer.cpp
+///  @brief times each phase of World::update and keeps the last few frames in a ring buffer
+
+#include "include/PhaseTimer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+PhaseTimer::PhaseTimer(int _frames)
+{
+  setFrames(_frames);
+}
+
+void PhaseTimer::setFrames(int _frames)
+{
+  m_frames=std::max(1,_frames);
+  m_ring.assign(m_frames*PHASE_COUNT,0.0);
+  clear();
+}
+
+void PhaseTimer::clear()
+{
+  m_recorded=0;
+  m_next=0;
+  std::fill(m_current,m_current+PHASE_COUNT,0.0);
+}
+
+void PhaseTimer::beginFrame()
+{
+  std::fill(m_current,m_current+PHASE_COUNT,0.0);
+}
+
+void PhaseTimer::endFrame()
+{
+  std::copy(m_current,m_current+PHASE_COUNT,m_ring.begin()+m_next*PHASE_COUNT);
+  m_next=(m_next+1)%m_frames;
+  if(m_recorded<m_frames) ++m_recorded;
+}
+
+void PhaseTimer::add(Phase _phase, std::chrono::steady_clock::duration _time)
+{
+  m_current[_phase]+=std::chrono::duration<double,std::milli>(_time).count();
+}
+
+PhaseTimer::Stats PhaseTimer::statsOf(std::vector<double> &io_times) const
+{
+  Stats stats = {0.0,0.0,0.0};
+  if(io_times.empty()) return stats;
+
+  std::sort(io_times.begin(),io_times.end());
+  double sum = 0.0;
+  for(double t : io_times) sum+=t;
+
+  // Nearest rank: the smallest time that at least 99% of the frames are at or below
+  int rank = (int)((99*io_times.size()+99)/100)-1;
+
+  stats.min=io_times.front();
+  stats.mean=sum/io_times.size();
+  stats.p99=io_times[std::max(0,rank)];
+  return stats;
+}
+
+PhaseTimer::Stats PhaseTimer::getStats(Phase _phase) const
+{
+  m_sorted.resize(m_recorded);
+  for(int f=0; f<m_recorded; ++f)
+  {
+    m_sorted[f]=m_ring[f*PHASE_COUNT+_phase];
+  }
+  return statsOf(m_sorted);
+}
+
+PhaseTimer::Stats PhaseTimer::getTotalStats() const
+{
+  m_sorted.assign(m_recorded,0.0);
+  for(int f=0; f<m_recorded; ++f)
+  {
+    for(int p=0; p<PHASE_COUNT; ++p)
+    {
+      m_sorted[f]+=m_ring[f*PHASE_COUNT+p];
+    }
+  }
+  return statsOf(m_sorted);
+}
+
+const char *PhaseTimer::getPhaseName(Phase _phase)
+{
+  static const char *names[PHASE_COUNT] =
+  {
+    "rain", "gravity", "viscosity", "position", "hash", "neighbours",
+    "spring adjust", "spring relax", "density", "velocity", "boundary"
+  };
+  if(_phase<0 || _phase>=PHASE_COUNT) return "";
+  return names[_phase];
+}
+
+void PhaseTimer::dump(std::ostream &_out) const
+{
+  char line[128];
+  snprintf(line,sizeof(line),"%-14s %9s %9s %9s   (ms over %d frames)\n","phase","min","mean","p99",m_recorded);
+  _out<<line;
+  for(int p=0; p<PHASE_COUNT; ++p)
+  {
+    Stats stats = getStats((Phase)p);
+    snprintf(line,sizeof(line),"%-14s %9.3f %9.3f %9.3f\n",getPhaseName((Phase)p),stats.min,stats.mean,stats.p99);
+    _out<<line;
+  }
+  Stats total = getTotalStats();
+  snprintf(line,sizeof(line),"%-14s %9.3f %9.3f %9.3f\n","total",total.min,total.mean,total.p99);
+  _out<<line;
+}
@@ -0,0 +1,58 @@
+///
+///  @file SimulationThread.cpp
+///  @brief runs World::update on its own thread at a fixed rate
+
+#include "include/SimulationThread.h"
+#include "include/World.h"
+
+#include <chrono>
+
+SimulationThread::SimulationThread(World *_world, int _intervalms) :
+  m_world(_world),
+  m_intervalms(_intervalms),
+  m_running(false),
+  m_steps(0)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+  stop();
+}
+
+void SimulationThread::start(std::function<void()> _beforeStep)
+{
+  if(m_running) return;
+  m_beforeStep=_beforeStep;
+  m_running=true;
+  m_thread=std::thread(&SimulationThread::run,this);
+}
+
+void SimulationThread::stop()
+{
+  m_running=false;
+  if(m_thread.joinable()) m_thread.join();
+}
+
+void SimulationThread::run()
+{
+  std::chrono::milliseconds interval(m_intervalms);
+  auto next = std::chrono::steady_clock::now();
+  bool updateinprogress = false;
+
+  while(m_running)
+  {
+    if(m_beforeStep) m_beforeStep();
+
+    // The 3D snapshot is built from a still world
+    if(m_world->getSnapshotMode()<2) m_world->update(&updateinprogress);
+    ++m_steps;
+
+    next += interval;
+    auto now = std::chrono::steady_clock::now();
+
+    // If a step took longer than the interval start counting again from now rather than trying to catch up
+    if(next<now) next=now;
+    std::this_thread::sleep_until(next);
+  }
+}
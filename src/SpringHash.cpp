@@ -0,0 +1,138 @@
+///
+///  @file SpringHash.cpp
+///  @brief open addressing hash table from an unordered pair of particles to the spring between them
+
+#include "include/SpringHash.h"
+
+#include <algorithm>
+
+namespace
+{
+  const int s_initialSize = 1024;
+}
+
+SpringHash::SpringHash() :
+  m_mask(s_initialSize-1),
+  m_size(0)
+{
+  Entry empty = {s_empty,-1};
+  m_table.assign(s_initialSize,empty);
+}
+
+uint64_t SpringHash::makeKey(int _i, int _j)
+{
+  uint32_t low = (uint32_t)std::min(_i,_j);
+  uint32_t high = (uint32_t)std::max(_i,_j);
+  return ((uint64_t)low<<32) | high;
+}
+
+uint64_t SpringHash::mix(uint64_t _key)
+{
+  // Finaliser of splitmix64, spreads neighbouring pairs over the whole table
+  _key ^= _key>>30;
+  _key *= 0xbf58476d1ce4e5b9ULL;
+  _key ^= _key>>27;
+  _key *= 0x94d049bb133111ebULL;
+  _key ^= _key>>31;
+  return _key;
+}
+
+void SpringHash::clear()
+{
+  for(auto& entry : m_table)
+  {
+    entry.key=s_empty;
+    entry.spring=-1;
+  }
+  m_size=0;
+}
+
+void SpringHash::reserve(int _springs)
+{
+  while(2*_springs>(int)m_table.size()) grow();
+}
+
+int SpringHash::find(int _i, int _j) const
+{
+  uint64_t key = makeKey(_i,_j);
+  for(uint64_t slot = mix(key)&m_mask; ; slot=(slot+1)&m_mask)
+  {
+    const Entry &entry = m_table[slot];
+    if(entry.key==key) return entry.spring;
+    if(entry.key==s_empty) return -1;
+  }
+}
+
+void SpringHash::insert(int _i, int _j, int _spring)
+{
+  if(2*(m_size+1)>(int)m_table.size()) grow();
+
+  uint64_t key = makeKey(_i,_j);
+  for(uint64_t slot = mix(key)&m_mask; ; slot=(slot+1)&m_mask)
+  {
+    Entry &entry = m_table[slot];
+    if(entry.key==key)
+    {
+      entry.spring=_spring;
+      return;
+    }
+    if(entry.key==s_empty)
+    {
+      entry.key=key;
+      entry.spring=_spring;
+      ++m_size;
+      return;
+    }
+  }
+}
+
+void SpringHash::erase(int _i, int _j, int _spring)
+{
+  uint64_t key = makeKey(_i,_j);
+  uint64_t slot = mix(key)&m_mask;
+  while(m_table[slot].key!=key)
+  {
+    if(m_table[slot].key==s_empty) return;
+    slot=(slot+1)&m_mask;
+  }
+  if(m_table[slot].spring!=_spring) return;
+
+  // Shift the following entries back so no probe sequence runs into a hole
+  uint64_t hole = slot;
+  for(uint64_t next = (hole+1)&m_mask; m_table[next].key!=s_empty; next=(next+1)&m_mask)
+  {
+    uint64_t home = mix(m_table[next].key)&m_mask;
+    // The entry can fill the hole if its home slot is not between the hole and where it sits now
+    if(((next-home)&m_mask) >= ((next-hole)&m_mask))
+    {
+      m_table[hole]=m_table[next];
+      hole=next;
+    }
+  }
+  m_table[hole].key=s_empty;
+  m_table[hole].spring=-1;
+  --m_size;
+}
+
+void SpringHash::grow()
+{
+  std::vector<Entry> old;
+  old.swap(m_table);
+  Entry empty = {s_empty,-1};
+  m_table.assign(old.size()*2,empty);
+  m_mask=m_table.size()-1;
+  m_size=0;
+  for(auto& entry : old)
+  {
+    if(entry.key==s_empty) continue;
+    for(uint64_t slot = mix(entry.key)&m_mask; ; slot=(slot+1)&m_mask)
+    {
+      if(m_table[slot].key==s_empty)
+      {
+        m_table[slot]=entry;
+        ++m_size;
+        break;
+      }
+    }
+  }
+}
@@ -6,7 +6,7 @@
 
 void Toolbar::drawToolbar(int _h) const
 {
-  bool current_3d = m_world->get3D();
+  bool current_3d = m_world->getDrawnView().m_3d;
   glDisable(GL_LIGHTING);
   glEnable(GL_TEXTURE_2D);
 
@@ -48,8 +48,8 @@ void Toolbar::drawToolbar(int _h) const
 
   // ------------------------DRAW----------------------
 
-  float halfheight = m_world->getHalfHeight();
-  float halfwidth = m_world->getHalfWidth();
+  float halfheight = m_world->getDrawnView().m_halfheight;
+  float halfwidth = m_world->getDrawnView().m_halfwidth;
 
   float Width = ((halfheight*2)/_h)*65;
   float Height = ((halfheight*2)/_h)*50;
@@ -507,7 +507,7 @@ void Toolbar::drawToolbar(int _h) const
 
   //----------------------CAMERA SNAPSHOT-----------------------
 
-  if(m_world->getSnapshotMode()!=1 && m_world->getSnapshotMode()!=2 && m_world->get3D())
+  if(m_world->getSnapshotMode()!=1 && m_world->getSnapshotMode()!=2 && m_world->getDrawnView().m_3d)
   {
   texW = 74.0f/425.0f;
   texH = 0.1f;
@@ -566,8 +566,8 @@ void Toolbar::drawToolbar(int _h) const
 bool Toolbar::handleClickDown(int _x, int _y, int _WIDTH, int _HEIGHT)
 {
 
-  float halfwidth = m_world->getHalfWidth();
-  float halfheight = m_world->getHalfHeight();
+  float halfwidth = m_world->getDrawnView().m_halfwidth;
+  float halfheight = m_world->getDrawnView().m_halfheight;
 
   float Width = ((halfheight*2)/_HEIGHT)*65;
   float Height = ((halfheight*2)/_HEIGHT)*50;
@@ -656,7 +656,8 @@ void Toolbar::handleClickUp()
   if (m_clickdownbutton==9)
   {
     toggleBool(&m_camera);
-    m_world->handleKeys('t');
+    // 't' only changes how the world is drawn, so it is handled here rather than queued for the simulation thread
+    m_world->handleRenderKeys('t');
   }
 }
 
@@ -712,14 +713,14 @@ void Toolbar::pressDrag()
 void Toolbar::pressTap()
 {
   toggleBool(&m_tap);
-  m_world->toggleRain();
+  m_commands->push(Command(Command::TOGGLE_RAIN));
   m_clickdownbutton=3;
 }
 
 void Toolbar::pressGravity()
 {
   toggleBool(&m_gravity);
-  m_world->toggleGravity();
+  m_commands->push(Command(Command::TOGGLE_GRAVITY));
   m_clickdownbutton=4;
 }
 
@@ -727,7 +728,7 @@ void Toolbar::pressClear()
 {
   toggleBool(&m_clear);
   m_clickdownbutton=5;
-  m_world->clearWorld();
+  m_commands->push(Command(Command::CLEAR_WORLD));
 }
 
 void Toolbar::pressHelp()
@@ -753,7 +754,7 @@ void Toolbar::pressRandomize()
     m_randomSeed.push_back(p);
   }
   int intRandomSeed = atoi(m_randomSeed.c_str());
-  m_world->setRandomType(intRandomSeed);
+  m_commands->push(Command(Command::SET_RANDOM_TYPE,intRandomSeed));
 }
 
 void Toolbar::pressCamera()
@@ -767,6 +768,11 @@ void Toolbar::setWorld(World *_world)
   m_world=_world;
 }
 
+void Toolbar::setCommands(CommandQueue *_commands)
+{
+  m_commands=_commands;
+}
+
 void Toolbar::handleKeys(char _input)
 {
   switch(_input)
@@ -811,7 +817,7 @@ void Toolbar::handleKeys(char _input)
 void Toolbar::drawNumbers(float _x, float _y, int _h, std::string _numbers) const
 {
 
-  float halfheight = m_world->getHalfHeight();
+  float halfheight = m_world->getDrawnView().m_halfheight;
 
   float gap = ((halfheight*2)/_h)*12;
   float height = ((halfheight*2)/_h)*23;
@@ -957,8 +963,8 @@ bool Toolbar::getdropdownopen()
 
 void Toolbar::handleClickDropDown(int _x, int _y, int _WIDTH, int _HEIGHT)
 {
-  float halfwidth = m_world->getHalfWidth();
-  float halfheight = m_world->getHalfHeight();
+  float halfwidth = m_world->getDrawnView().m_halfwidth;
+  float halfheight = m_world->getDrawnView().m_halfheight;
 
   float Width = ((halfheight*2)/_HEIGHT)*65;
   float Height = ((halfheight*2)/_HEIGHT)*50;
@@ -995,7 +1001,7 @@ void Toolbar::handleClickDropDown(int _x, int _y, int _WIDTH, int _HEIGHT)
     pressDropDownMenu();
   }
 
-  m_world->setToDraw(m_dropdownselect);
+  m_commands->push(Command(Command::SET_TO_DRAW,m_dropdownselect));
 
 }
 
@@ -1008,7 +1014,7 @@ void Toolbar::addNumber(char p)
   if(m_randomSeed.size()==9)
   {
     int intRandomSeed = atoi(m_randomSeed.c_str());
-    m_world->setRandomType(intRandomSeed);
+    m_commands->push(Command(Command::SET_RANDOM_TYPE,intRandomSeed));
   }
 }
 
@@ -1057,8 +1063,8 @@ void Toolbar::drawHelpScreen(float _buttonwidth) const
 
   // end of Citation
 
-  float x = -m_world->getHalfWidth()+0.1f;
-  float y = m_world->getHalfHeight()-_buttonwidth*0.5;
+  float x = -m_world->getDrawnView().m_halfwidth+0.1f;
+  float y = m_world->getDrawnView().m_halfheight-_buttonwidth*0.5;
 
   float width = _buttonwidth*6;
   float height = _buttonwidth*3.4;
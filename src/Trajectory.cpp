@@ -0,0 +1,415 @@
+///
+///  @file Trajectory.cpp
+///  @brief streams the particles of every step to a compact binary file and reads any frame of it back
+
+#include "include/Trajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+  /// Fields per particle in the quantised frames: id, type, x, y, z, velx, vely, velz
+  const int s_fields = 8;
+  /// Trailer: index offset, frames, magic
+  const int s_trailer = 16;
+
+  void putVarint(std::vector<char> &io_out, uint64_t _value)
+  {
+    while(_value>=0x80)
+    {
+      io_out.push_back((char)((_value&0x7f)|0x80));
+      _value>>=7;
+    }
+    io_out.push_back((char)_value);
+  }
+
+  void putSigned(std::vector<char> &io_out, int64_t _value)
+  {
+    putVarint(io_out,((uint64_t)_value<<1) ^ (uint64_t)(_value>>63));
+  }
+
+  bool getVarint(const char *&io_data, const char *_end, uint64_t &o_value)
+  {
+    o_value=0;
+    for(int shift=0; shift<64 && io_data<_end; shift+=7)
+    {
+      uint8_t byte = (uint8_t)*io_data++;
+      o_value |= uint64_t(byte&0x7f)<<shift;
+      if(!(byte&0x80)) return true;
+    }
+    return false;
+  }
+
+  bool getSigned(const char *&io_data, const char *_end, int64_t &o_value)
+  {
+    uint64_t value;
+    if(!getVarint(io_data,_end,value)) return false;
+    o_value=(int64_t)(value>>1) ^ -(int64_t)(value&1);
+    return true;
+  }
+
+  template <typename T>
+  void putRaw(std::ostream &_out, T _value)
+  {
+    _out.write(reinterpret_cast<const char *>(&_value),sizeof(T));
+  }
+
+  template <typename T>
+  bool getRaw(std::istream &_in, T &o_value)
+  {
+    return (bool)_in.read(reinterpret_cast<char *>(&o_value),sizeof(T));
+  }
+}
+
+void TrajectoryFrame::resize(int _count)
+{
+  m_count=_count;
+  m_id.resize(_count);
+  m_type.resize(_count);
+  m_x.resize(_count);
+  m_y.resize(_count);
+  m_z.resize(_count);
+  m_velx.resize(_count);
+  m_vely.resize(_count);
+  m_velz.resize(_count);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TrajectoryWriter::TrajectoryWriter() :
+  m_positionStep(1.0f),
+  m_velocityStep(1.0f),
+  m_keyframe(1),
+  m_stopping(false),
+  m_dropped(0)
+{
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+  if(m_file.is_open()) close();
+}
+
+bool TrajectoryWriter::open(const std::string &_path, float _positionStep, float _velocityStep, int _keyframe,
+                            int _buffers)
+{
+  m_file.open(_path.c_str(),std::ios::out|std::ios::binary|std::ios::trunc);
+  if(!m_file.is_open())
+  {
+    std::cerr<<"Could not open "<<_path<<" to write the trajectory"<<std::endl;
+    return false;
+  }
+  m_positionStep=_positionStep;
+  m_velocityStep=_velocityStep;
+  m_keyframe=std::max(1,_keyframe);
+
+  m_file.write(Trajectory::s_magic,4);
+  m_file.put((char)Trajectory::s_version);
+  putRaw<uint32_t>(m_file,m_keyframe);
+  putRaw<float>(m_file,m_positionStep);
+  putRaw<float>(m_file,m_velocityStep);
+
+  m_frames.assign(std::max(1,_buffers),TrajectoryFrame());
+  m_free.clear();
+  for(int i=0; i<(int)m_frames.size(); ++i) m_free.push_back(i);
+  m_queued.clear();
+  m_previous.clear();
+  m_index.clear();
+  m_indexSteps.clear();
+  m_dropped=0;
+  m_stopping=false;
+  m_thread=std::thread(&TrajectoryWriter::run,this);
+  return true;
+}
+
+void TrajectoryWriter::push(long _step, const ParticleStore &_particles, int _slots)
+{
+  if(!m_file.is_open()) return;
+
+  int buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_free.empty())
+    {
+      ++m_dropped;
+      return;
+    }
+    buffer=m_free.back();
+    m_free.pop_back();
+  }
+
+  // The buffers keep their memory so this only allocates while the particle count grows
+  TrajectoryFrame &frame = m_frames[buffer];
+  frame.resize(_slots);
+  frame.m_step=_step;
+  int k = 0;
+  for(int i=0; i<_slots; ++i)
+  {
+    if(!_particles.getAlive(i)) continue;
+    frame.m_id[k]=_particles.m_id[i];
+    frame.m_type[k]=_particles.m_type[i];
+    frame.m_x[k]=_particles.m_x[i];
+    frame.m_y[k]=_particles.m_y[i];
+    frame.m_z[k]=_particles.m_z[i];
+    frame.m_velx[k]=_particles.m_velx[i];
+    frame.m_vely[k]=_particles.m_vely[i];
+    frame.m_velz[k]=_particles.m_velz[i];
+    ++k;
+  }
+  frame.m_count=k;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queued.push_back(buffer);
+  }
+  m_wake.notify_one();
+}
+
+void TrajectoryWriter::close()
+{
+  if(!m_file.is_open()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping=true;
+  }
+  m_wake.notify_one();
+  if(m_thread.joinable()) m_thread.join();
+
+  uint64_t indexOffset = (uint64_t)m_file.tellp();
+  for(size_t f=0; f<m_index.size(); ++f)
+  {
+    putRaw<uint64_t>(m_file,m_index[f]);
+    putRaw<int64_t>(m_file,m_indexSteps[f]);
+  }
+  putRaw<uint64_t>(m_file,indexOffset);
+  putRaw<uint32_t>(m_file,(uint32_t)m_index.size());
+  m_file.write(Trajectory::s_magic,4);
+  m_file.close();
+}
+
+void TrajectoryWriter::run()
+{
+  for(;;)
+  {
+    int buffer;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock,[this]{ return m_stopping || !m_queued.empty(); });
+      if(m_queued.empty()) return;
+      buffer=m_queued.front();
+      m_queued.pop_front();
+    }
+
+    encode(m_frames[buffer]);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(buffer);
+  }
+}
+
+void TrajectoryWriter::encode(const TrajectoryFrame &_frame)
+{
+  int count = _frame.m_count;
+  float position = 1.0f/m_positionStep;
+  float velocity = 1.0f/m_velocityStep;
+
+  // World keeps its particles sorted by grid cell, the chunk has them sorted by id so that each one can be matched
+  // with itself in the previous frame by walking both frames together
+  m_order.resize(count);
+  for(int k=0; k<count; ++k) m_order[k]=k;
+  std::sort(m_order.begin(),m_order.end(),[&_frame](int _a, int _b) { return _frame.m_id[_a]<_frame.m_id[_b]; });
+
+  m_current.resize(count*s_fields);
+  for(int k=0; k<count; ++k)
+  {
+    int i = m_order[k];
+    int *q = &m_current[k*s_fields];
+    q[0]=_frame.m_id[i];
+    q[1]=_frame.m_type[i];
+    q[2]=(int)lrintf(_frame.m_x[i]*position);
+    q[3]=(int)lrintf(_frame.m_y[i]*position);
+    q[4]=(int)lrintf(_frame.m_z[i]*position);
+    q[5]=(int)lrintf(_frame.m_velx[i]*velocity);
+    q[6]=(int)lrintf(_frame.m_vely[i]*velocity);
+    q[7]=(int)lrintf(_frame.m_velz[i]*velocity);
+  }
+
+  bool keyframe = m_index.size()%m_keyframe==0;
+  int previousCount = keyframe ? 0 : (int)m_previous.size()/s_fields;
+  static const int zero[s_fields] = {0,0,0,0,0,0,0,0};
+
+  m_payload.clear();
+  int lastId = -1;
+  int p = 0;
+  for(int k=0; k<count; ++k)
+  {
+    const int *q = &m_current[k*s_fields];
+    while(p<previousCount && m_previous[p*s_fields]<q[0]) ++p;
+    const int *base = zero;
+    if(p<previousCount && m_previous[p*s_fields]==q[0]) base=&m_previous[p*s_fields];
+
+    putVarint(m_payload,(uint64_t)((int64_t)q[0]-lastId));
+    lastId=q[0];
+    for(int f=1; f<s_fields; ++f)
+    {
+      putSigned(m_payload,(int64_t)q[f]-base[f]);
+    }
+  }
+
+  m_index.push_back((uint64_t)m_file.tellp());
+  m_indexSteps.push_back(_frame.m_step);
+  putRaw<uint32_t>(m_file,(uint32_t)m_payload.size());
+  putRaw<uint32_t>(m_file,(uint32_t)count);
+  putRaw<int64_t>(m_file,_frame.m_step);
+  m_file.write(m_payload.data(),m_payload.size());
+
+  m_previous.swap(m_current);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool TrajectoryReader::open(const std::string &_path)
+{
+  m_file.open(_path.c_str(),std::ios::in|std::ios::binary);
+  if(!m_file.is_open())
+  {
+    std::cerr<<"Could not open the trajectory "<<_path<<std::endl;
+    return false;
+  }
+
+  char magic[4];
+  uint8_t version = 0;
+  uint32_t keyframe = 0;
+  m_file.read(magic,4);
+  getRaw(m_file,version);
+  getRaw(m_file,keyframe);
+  getRaw(m_file,m_positionStep);
+  getRaw(m_file,m_velocityStep);
+  if(!m_file || memcmp(magic,Trajectory::s_magic,4)!=0)
+  {
+    std::cerr<<_path<<" is not a trajectory"<<std::endl;
+    return false;
+  }
+  if(version!=Trajectory::s_version || keyframe==0)
+  {
+    std::cerr<<_path<<" is a version "<<(int)version<<" trajectory, this reads version "
+             <<(int)Trajectory::s_version<<std::endl;
+    return false;
+  }
+  m_keyframe=(int)keyframe;
+
+  // The index is found from the end of the file, a writer that never closed leaves none
+  uint64_t indexOffset = 0;
+  uint32_t frames = 0;
+  m_file.seekg(-s_trailer,std::ios::end);
+  getRaw(m_file,indexOffset);
+  getRaw(m_file,frames);
+  m_file.read(magic,4);
+  if(!m_file || memcmp(magic,Trajectory::s_magic,4)!=0)
+  {
+    std::cerr<<_path<<" has no frame index, it was not closed"<<std::endl;
+    return false;
+  }
+
+  m_offsets.resize(frames);
+  m_steps.resize(frames);
+  m_file.seekg(indexOffset);
+  for(uint32_t f=0; f<frames; ++f)
+  {
+    getRaw(m_file,m_offsets[f]);
+    getRaw(m_file,m_steps[f]);
+  }
+  if(!m_file)
+  {
+    std::cerr<<_path<<" has a broken frame index"<<std::endl;
+    return false;
+  }
+  m_decoded=-1;
+  return true;
+}
+
+bool TrajectoryReader::read(int _frame, TrajectoryFrame &o_frame)
+{
+  if(_frame<0 || _frame>=getFrameCount()) return false;
+
+  // Carry on from the frame decoded last if it is between the keyframe and _frame, else start at the keyframe
+  int first = _frame-_frame%m_keyframe;
+  if(m_decoded>=first && m_decoded<=_frame) first=m_decoded+1;
+  for(int f=first; f<=_frame; ++f)
+  {
+    if(!decode(f))
+    {
+      m_decoded=-1;
+      return false;
+    }
+  }
+
+  int count = (int)m_previous.size()/s_fields;
+  o_frame.resize(count);
+  o_frame.m_step=(long)m_steps[_frame];
+  for(int k=0; k<count; ++k)
+  {
+    const int *q = &m_previous[k*s_fields];
+    o_frame.m_id[k]=q[0];
+    o_frame.m_type[k]=q[1];
+    o_frame.m_x[k]=q[2]*m_positionStep;
+    o_frame.m_y[k]=q[3]*m_positionStep;
+    o_frame.m_z[k]=q[4]*m_positionStep;
+    o_frame.m_velx[k]=q[5]*m_velocityStep;
+    o_frame.m_vely[k]=q[6]*m_velocityStep;
+    o_frame.m_velz[k]=q[7]*m_velocityStep;
+  }
+  return true;
+}
+
+bool TrajectoryReader::decode(int _frame)
+{
+  uint32_t bytes = 0;
+  uint32_t count = 0;
+  int64_t step = 0;
+  m_file.clear();
+  m_file.seekg(m_offsets[_frame]);
+  getRaw(m_file,bytes);
+  getRaw(m_file,count);
+  getRaw(m_file,step);
+  m_payload.resize(bytes);
+  m_file.read(m_payload.data(),bytes);
+  if(!m_file || step!=m_steps[_frame]) return false;
+
+  bool keyframe = _frame%m_keyframe==0;
+  int previousCount = keyframe ? 0 : (int)m_previous.size()/s_fields;
+  static const int zero[s_fields] = {0,0,0,0,0,0,0,0};
+
+  m_current.resize((size_t)count*s_fields);
+  const char *data = m_payload.data();
+  const char *end = data+bytes;
+  int64_t lastId = -1;
+  int p = 0;
+  for(uint32_t k=0; k<count; ++k)
+  {
+    int *q = &m_current[k*s_fields];
+    uint64_t gap;
+    if(!getVarint(data,end,gap)) return false;
+    lastId+=(int64_t)gap;
+    q[0]=(int)lastId;
+
+    while(p<previousCount && m_previous[p*s_fields]<q[0]) ++p;
+    const int *base = zero;
+    if(p<previousCount && m_previous[p*s_fields]==q[0]) base=&m_previous[p*s_fields];
+
+    for(int f=1; f<s_fields; ++f)
+    {
+      int64_t delta;
+      if(!getSigned(data,end,delta)) return false;
+      q[f]=(int)(base[f]+delta);
+    }
+  }
+
+  m_previous.swap(m_current);
+  m_decoded=_frame;
+  return true;
+}
@@ -48,7 +48,7 @@ void Vec3::normalize()
 
 //}
 
-Vec3 Vec3::operator *(GLfloat _rhs) const
+Vec3 Vec3::operator *(float _rhs) const
 {
   return Vec3(m_x * _rhs,
               m_y * _rhs,
@@ -56,14 +56,14 @@ Vec3 Vec3::operator *(GLfloat _rhs) const
               );
 }
 
-void Vec3::operator *=(GLfloat _rhs)
+void Vec3::operator *=(float _rhs)
 {
   m_x *= _rhs;
   m_y *= _rhs;
   m_z *= _rhs;
 }
 
-Vec3 Vec3::operator /(GLfloat _rhs) const
+Vec3 Vec3::operator /(float _rhs) const
 {
   return Vec3(m_x / _rhs,
               m_y / _rhs,
@@ -71,7 +71,7 @@ Vec3 Vec3::operator /(GLfloat _rhs) const
               );
 }
 
-void Vec3::operator /=(GLfloat _rhs)
+void Vec3::operator /=(float _rhs)
 {
   m_x /= _rhs;
   m_y /= _rhs;
@@ -119,24 +119,19 @@ bool Vec3::operator ==(const Vec3 &_rhs) const
   else return false;
 }
 
-GLfloat & Vec3::operator [](int _i)
+float & Vec3::operator [](int _i)
 {
   assert(_i>=0 && _i<=2);
   return m_openGL[_i];
 }
 
-void Vec3::set(GLfloat _x, GLfloat _y, GLfloat _z)
+void Vec3::set(float _x, float _y, float _z)
 {
   m_x=_x;
   m_y=_y;
   m_z=_z;
 }
 
-void Vec3::vertexGL() const
-{
-  glVertex3f(m_x,m_y,m_z);
-}
-
 Vec3 Vec3::operator *(Mat3 &_rhs)
 {
   return Vec3(_rhs[0]*m_x+_rhs[1]*m_y+_rhs[2]*m_z,
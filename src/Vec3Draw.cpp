@@ -0,0 +1,18 @@
+///
+///  @file Vec3Draw.cpp
+///  @brief OpenGL helpers for Vec3, kept apart from Vec3.cpp so the simulation core builds without OpenGL.
+
+#include "include/Vec3.h"
+
+#ifdef __APPLE__
+  #include <OpenGL/gl.h>
+  #include <OpenGL/glu.h>
+#else
+  #include <GL/gl.h>
+  #include <GL/glu.h>
+#endif
+
+void Vec3::vertexGL() const
+{
+  glVertex3f(m_x,m_y,m_z);
+}
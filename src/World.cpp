@@ -3,29 +3,66 @@
 ///  @brief contains all particles and methods to draw and update them
 
 #include "include/World.h"
+#include "include/Checkpoint.h"
+#include "include/Trajectory.h"
+
+#include <climits>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 World::World() :
   m_isInit(false),
-  m_startTime(0.0),
-  m_elapsedTime(0.0),
+  m_timestep(1.0f),
+  m_particlesPoolSize(5000),
+  m_particleLimit(1000000),
+  m_particlePoolGrowths(0),
+  m_droppedParticles(0),
+  m_useNeighbourList(true),
+  m_neighbourSkin(0.1f),
+  m_neighbourListBuilds(0),
+  m_parallelViscosity(true),
+  m_parallelDensity(true),
+  m_worldHalfHeight(5.0f),
   m_interactionradius(1.0f),
   m_squaresize(1.0f),
-  m_timestep(1.0f),
   m_pointsize(10.0f),
-  m_mainrender2dthreshold(90.0f),
   m_mainrender3dthreshold(100.0f),
+  m_mainrender2dthreshold(90.0f),
   m_render2DResolution(4),
+  m_render2dwidth(0),
+  m_render2dheight(0),
   m_render3dresolution(2),
+  m_render3dwidth(0),
+  m_render3dheight(0),
   m_renderoption(1),
+  m_snapshotmultiplier(4),
   m_rain(false),
   m_drawwall(false),
   m_gravity(true),
-  m_springsize(500000),
-  m_particlesPoolSize(5000),
   m_3d(false),
+  m_snapshotMode(0),
   m_boundaryMultiplier(1.0f),
   m_boundaryType(2),  // Have a go at changing if you want (values 0, 1, 2)
-  m_snapshotmultiplier(4)
+  m_parallelRender(true),
+  m_compactMetaballs(false),
+  m_timingDumpInterval(0),
+  m_step(0),
+  m_adaptiveTimestep(false),
+  m_cflNumber(0.25f),
+  m_maxSubsteps(8),
+  m_frameBudgetms(20.0),
+  m_substepCostms(0.0),
+  m_substepCount(0),
+  m_lastSubsteps(1),
+  m_sparseGrid(true),
+  m_sleeping(false),
+  m_sleepDistance(0.05f),
+  m_sleepSteps(10),
+  m_sleepingParticles(0),
+  m_trajectory(nullptr)
 {
 }
 
@@ -36,42 +73,18 @@ void World::init() {
 
   if (m_isInit) return;
 
-
-  glEnable(GL_TEXTURE_2D);
-
-  glFrontFace(GL_CCW);
-
-  glEnable(GL_LIGHTING);
-  glEnable(GL_NORMALIZE);
-  glEnable(GL_LIGHT0);
-  glEnable(GL_LIGHT_MODEL_AMBIENT);
-
-  GLfloat ambientColor[] = {0.2f, 0.2f, 0.2f, 1.0f}; //Color(0.2, 0.2, 0.2)
-  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
-
-  glEnable( GL_MULTISAMPLE_ARB);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_COLOR_MATERIAL);
-  glPointSize(m_pointsize);
-
-  // Set the background colour
-  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-
   m_particles.clear();
   m_springs.clear();
 
-  Particle defaultparticle;
-  defaultparticle.setAlive(false);
-  m_particles.resize(m_particlesPoolSize,defaultparticle);
+  m_particles.resize(m_particlesPoolSize);
   m_firstFreeParticle=0;
   m_lastTakenParticle=-1;
   m_howManyAliveParticles=0;
+  m_nextParticleId=0;
 
-  Particle::Spring defaultspring;
-  defaultspring.alive=false;
-  m_springs.resize(m_springsize,defaultspring);
-  m_firstFreeSpring=0;
-  m_lastTakenSpring=-1;
+  m_freeSprings.clear();
+  m_springHash.clear();
+  m_springListsValid=false;
 
   // DEFAULT PARTICLE PROPERTIES
   m_particleTypes.push_back(ParticleProperties()); //water
@@ -88,6 +101,8 @@ void World::init() {
 
   m_camerarotatey=0.0f;
   m_camerarotatex=0.0f;
+  m_cameramousex=-10;
+  m_cameramousey=-10;
 
   m_isInit = true;
 }
@@ -99,7 +114,7 @@ void World::resizeWorld(int w, int h)
   m_pixelheight=h;
   m_pixelwidth=w;
 
-  float i = 5;
+  float i = m_worldHalfHeight;
   float ara = float(w)/float(h);
 
   m_halfheight=i;
@@ -109,342 +124,230 @@ void World::resizeWorld(int w, int h)
   m_gridheight=ceil((m_halfheight*2)/m_squaresize);
   m_griddepth=m_gridwidth;
 
-  m_cellsContainingParticles.clear();
-  m_grid.clear();
-
-  if(!m_3d)
-  {
-    m_grid.resize(m_gridheight*m_gridwidth);
-    m_cellsContainingParticles.resize(m_gridheight*m_gridwidth,false);
-  }
-  else
-  {
-    if(m_marching.getSnapshotMode()==3)
-    {
-      handleKeys('t');
-    }
-    m_grid.resize(m_gridheight*m_gridwidth*m_griddepth);
-    m_cellsContainingParticles.resize(m_gridheight*m_gridwidth*m_griddepth,false);
-  }
-
-  m_render2dwidth=m_gridwidth*m_render2DResolution;
-  m_render2dheight=m_gridheight*m_render2DResolution;
-
-  m_render3dwidth=m_gridwidth*m_render3dresolution;
-  m_render3dheight=m_gridheight*m_render3dresolution;
-
+  // The renderer sees the new size in the next snapshot and rebuilds its grids then, see draw()
   hashParticles();
 
 }
 
-void World::resizeWindow(int w, int h) {
-
-  m_howmanytimesrandomized=0;
-  if (!m_isInit) return;
-
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-
-  m_pixelheight=h;
-  m_pixelwidth=w;
-
-  float i = 5;
-  float ara = float(w)/float(h);
-
-  glOrtho(-i*ara,i*ara,-i,i,0.1, 5000.0);
-
-  m_halfheight=i;
-  m_halfwidth=i*ara;
-
-  glViewport(0,0,w,h);
-
-  glMatrixMode(GL_MODELVIEW);
-
-  m_marching=MarchingAlgorithms( m_mainrender2dthreshold, m_mainrender3dthreshold, m_squaresize,
-                                 m_render2DResolution,m_render3dresolution,m_halfwidth,m_halfheight,
+void World::resizeRender(const RenderView &_view)
+{
+  // A high resolution 3D snapshot does not survive the rebuild, go back to the realtime resolution
+  if(m_marching.getSnapshotMode()>2) m_render3dresolution/=m_snapshotmultiplier;
+
+  m_renderView=_view;
+  m_render2dwidth=_view.m_gridwidth*m_render2DResolution;
+  m_render2dheight=_view.m_gridheight*m_render2DResolution;
+  m_render3dwidth=_view.m_gridwidth*m_render3dresolution;
+  m_render3dheight=_view.m_gridheight*m_render3dresolution;
+  m_marching=MarchingAlgorithms( m_mainrender2dthreshold, m_mainrender3dthreshold, _view.m_squaresize,
+                                 m_render2DResolution,m_render3dresolution,_view.m_halfwidth,_view.m_halfheight,
                                  m_snapshotmultiplier);
+  m_snapshotMode=m_marching.getSnapshotMode();
+}
 
-  }
-
-void World::draw() {
+void World::update(bool *updateinprogress) {
   if (!m_isInit) return;
+  *updateinprogress = true;
 
-  glMatrixMode(GL_MODELVIEW);
-
-  bool current_3d=m_3d;
-  if(current_3d && m_marching.getSnapshotMode()!=1)
-  {
-    glPushMatrix();
-    glTranslatef(0.0f,2.0f,-10.0f);
-    glTranslatef(0.0f, 0.0f, -2.0f); // move back to focus of gluLookAt
-    glRotatef(m_camerarotatex,0.0f,1.0f,0.0f); //  rotate around center
-    glRotatef(m_camerarotatey,1.0f,0.0f,0.0f); //  rotate around center
-    glTranslatef(0.0f, 0.0f, 2.0f); //move object to center
-  }
-
-  glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+  // Counted per world rather than in a static so that a replayed session rains on the same steps
+  long everyother = m_step+1;
 
-  if(m_renderoption==1){
-    for(int i=0; i<m_lastTakenParticle+1; ++i){
-      if(m_particles[i].getAlive())
-        m_particles[i].drawParticle(m_pointsize);
-    }
-  }
+  // Each phase below is timed by a scope on the stack, see PhaseTimer
+  m_phaseTimer.beginFrame();
 
+  //make it rain
 
-  else if(m_renderoption==2)
+  // 2d/3d different
   {
-    if(!m_3d)
-    {
-      for(auto& i : m_particleTypes)
-      {
-        std::vector<std::vector<float>> waterRenderGrid = renderGrid(&i);
-        m_marching.calculateMarchingSquares(waterRenderGrid,i,false);
-        m_marching.calculateMarchingSquares(waterRenderGrid,i,true);
-      }
-      m_marching.draw2DRealtime();
-    }
-    else
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::RAIN);
+    if(m_rain)
     {
-      // DRAW LOADING SCREEN
-      if(m_marching.getSnapshotMode()==1)
-      {
-        drawLoading();
-        m_marching.setSnapshotMode(2);
-      }
-
-      // SNAPSHOT MODE PROCESSING
-      else if(m_marching.getSnapshotMode()==2)
-      {
-        m_render3dresolution*=m_snapshotmultiplier;
-        m_render3dwidth=m_gridwidth*m_render3dresolution;
-        m_render3dheight=m_gridheight*m_render3dresolution;
-        m_marching.toggle3DResolution();
-        m_marching.clearSnapshot3DTriangles();
-        for(auto& i : m_particleTypes)
+      if(everyother%2==0){
+        if(!m_3d)
         {
-          std::vector<std::vector<std::vector<float>>> waterRender3dGrid = render3dGrid(&i);
-          m_marching.calculateMarchingCubes(waterRender3dGrid,i);
+          for(int i = 0; i<6; ++i)
+          {
+            Particle newParticle;
+            if(m_interactionradius==1.0f)
+            {
+              newParticle = Particle(Vec3(-3.0f+i*0.3f,m_halfheight/2+0.5f,-2.0f),&m_particleTypes[m_todraw]);
+              newParticle.addVelocity(Vec3(3*0.03f-i*0.03f,-0.1f,0.0f));
+            }
+            else{
+              newParticle = Particle(Vec3(-3.0f+i*0.1f,m_halfheight/2+0.5f,-2.0f),&m_particleTypes[m_todraw]);
+              newParticle.addVelocity(Vec3(0,-0.1f,0.0f));
+            }
+            insertParticle(newParticle);
+          }
         }
-        m_marching.setSnapshotMode(3);
-      }
-
-      // DRAW THE GENERATED SNAPSHOT
-      else if(m_marching.getSnapshotMode()>2)
-      {
-        m_marching.draw3DSnapshot();
-      }
-
-      // DRAW REAL-TIME FLUID MARCHING CUBES
-      else
-      {
-        m_marching.clearSnapshot3DTriangles();
-        for(auto& i : m_particleTypes)
+        else
         {
-          std::vector<std::vector<std::vector<float>>> waterRender3dGrid = render3dGrid(&i);
-          m_marching.calculateMarchingCubes(waterRender3dGrid,i);
+          for(int j = 0; j< 5; ++j)
+          {
+            for(int i = 0; i<5; ++i)
+            {
+              Particle newParticle =Particle(Vec3(i*0.3f,m_halfheight/5,-2.0+j*0.3f),&m_particleTypes[m_todraw]);
+              newParticle.addVelocity(Vec3(0.0f,0.0f,0.0f));
+              insertParticle(newParticle);
+            }
+          }
         }
-        m_marching.draw3DRealtime();
       }
     }
   }
 
-  if(current_3d) glPopMatrix();
-}
-
-void World::update(bool *updateinprogress) {
-  if (!m_isInit) return;
-  *updateinprogress = true;
-
-  // Some stuff we need to perform timings
-  struct timeval tim;
+  // Several smaller steps when the fluid is moving fast, see chooseSubsteps()
+  int substeps = 1;
+  if(m_adaptiveTimestep) substeps = chooseSubsteps();
 
-  // Retrieve the current time in nanoseconds (accurate to 10ns)
-  //gettimeofday(&tim, NULL);
-  //double now =tim.tv_sec+(tim.tv_usec * 1e-6);
+  double frametime = m_timestep;
+  m_timestep = frametime/substeps;
+  auto start = std::chrono::steady_clock::now();
+  for(int s=0; s<substeps; ++s)
+  {
+    substep(++m_substepCount);
+  }
+  double spent = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+  m_timestep = frametime;
 
-  // Increment the rotation based on the time elapsed since we started running
-  //m_elapsedTime = m_startTime - now;
+  // Running average of what one substep costs, for the budget in chooseSubsteps()
+  double cost = spent/substeps;
+  if(m_substepCostms==0.0) m_substepCostms=cost;
+  else m_substepCostms=0.8*m_substepCostms+0.2*cost;
+  m_lastSubsteps=substeps;
 
-  //make it rain
+  //----------------------------------CLEANUP ------------------------------------------------
 
-  // 2d/3d different
+  m_phaseTimer.endFrame();
 
-  static int everyother = 0;
-  everyother++;
+  ++m_step;
+  publishSnapshot();
+  if(m_trajectory) m_trajectory->push(m_step,m_particles,m_lastTakenParticle+1);
 
-  if(m_rain)
+  if(m_timingDumpInterval>0 && everyother%m_timingDumpInterval==0)
   {
-    if(everyother%2==0){
-      if(!m_3d)
-      {
-        for(int i = 0; i<6; ++i)
-        {
-          Particle newParticle;
-          if(m_interactionradius==1.0f)
-          {
-            newParticle = Particle(Vec3(-3.0f+i*0.3f,m_halfheight/2+0.5f,-2.0f),&m_particleTypes[m_todraw]);
-            newParticle.addVelocity(Vec3(3*0.03f-i*0.03f,-0.1f,0.0f));
-          }
-          else{
-            newParticle = Particle(Vec3(-3.0f+i*0.1f,m_halfheight/2+0.5f,-2.0f),&m_particleTypes[m_todraw]);
-            newParticle.addVelocity(Vec3(0,-0.1f,0.0f));
-          }
-          insertParticle(newParticle);
-        }
-      }
-      else
-      {
-        for(int j = 0; j< 5; ++j)
-        {
-          for(int i = 0; i<5; ++i)
-          {
-            Particle newParticle =Particle(Vec3(i*0.3f,m_halfheight/5,-2.0+j*0.3f),&m_particleTypes[m_todraw]);
-            newParticle.addVelocity(Vec3(0.0f,0.0f,0.0f));
-            insertParticle(newParticle);
-          }
-        }
-      }
-    }
+    std::cout<<"Particles: "<<m_howManyAliveParticles<<std::endl;
+    m_phaseTimer.dump(std::cout);
   }
 
+  *updateinprogress = false;
+}
+
+void World::substep(int _step)
+{
+  // The passes below work straight on the arrays of the particle store
+  std::vector<float> &x = m_particles.m_x;
+  std::vector<float> &y = m_particles.m_y;
+  std::vector<float> &z = m_particles.m_z;
+  std::vector<float> &velx = m_particles.m_velx;
+  std::vector<float> &vely = m_particles.m_vely;
+  std::vector<float> &velz = m_particles.m_velz;
+  std::vector<int> &type = m_particles.m_type;
+
   // ------------------------------GRAVITY --------------------------------------------
-  if(m_gravity)
   {
-    Vec3 gravityvel = Vec3(0.0f,-0.008*m_timestep,0.0f);
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::GRAVITY);
+    if(m_gravity)
+    {
+      float gravityvel = -0.008f*m_timestep;
 
-    // The line below rotates the gravity when in 3D according to how far you tip the box.
-    // gravityvel.rotateAroundXAxisf(-m_camerarotatey*(M_PI/180.0f));
+      // The line below rotates the gravity when in 3D according to how far you tip the box.
+      // gravityvel.rotateAroundXAxisf(-m_camerarotatey*(M_PI/180.0f));
 
-    for(int i=0; i<m_lastTakenParticle+1; ++i)
-    {
-      if(m_particles[i].getAlive()) m_particles[i].addVelocity(gravityvel);
+      for(int i=0; i<m_lastTakenParticle+1; ++i)
+      {
+        if(m_particles.getAlive(i) && !m_particles.getSleep(i)) vely[i]+=gravityvel;
+      }
     }
   }
 
   // ------------------------------VISCOSITY--------------------------------------------
-  // TODO : Implement spatial hash for loop here
 
+  {
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::VISCOSITY);
+    if(m_parallelViscosity) viscosityParallel();
+    else viscositySerial();
+  }
 
-  int choo = 0;
+  //------------------------------------------POSITION----------------------------------------
 
-  //#pragma omp parallel for ordered schedule(dynamic)
-  for(auto k = 0; k<(int)m_grid.size(); ++k)
   {
-    int ploo = 0;
-    for(auto& i : m_grid[k])
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::POSITION);
+    for(int i=0; i<m_lastTakenParticle+1; ++i)
     {
-      if(!(i->getWall()))
+      if(m_particles.getAlive(i))
       {
-        std::vector<Particle *> surroundingParticles = getSurroundingParticles(choo,1,false);
-        int cloo = 0;
-        for(auto& j : surroundingParticles)
-        {
-          if(cloo>ploo && !(j->getWall()))
-          {
-            Vec3 rij=(j->getPosition()-i->getPosition());
-            float q = rij.length()/m_interactionradius;
-            if(q<1 && q!=0)
-            {
-              rij.normalize();
-              float u = (i->getVelocity()-j->getVelocity()).dot(rij);
-              if(u>0)
-              {
-                ParticleProperties *thisproperties = i->getProperties();
-                float sig = thisproperties->getSigma();
-                float bet = thisproperties->getBeta();
-                Vec3 impulse = rij*((1-q)*(sig*u + bet*u*u))*m_timestep;
-                i->addVelocity(-impulse/2.0f);
-                j->addVelocity(impulse/2.0f);
-              }
-            }
-
-          }
-          cloo++;
-        }
-        ploo++;
-
+        m_particles.m_prevx[i]=x[i];
+        m_particles.m_prevy[i]=y[i];
+        m_particles.m_prevz[i]=z[i];
+        if(!m_particles.getDrag(i) && !m_particles.getWall(i) && !m_particles.getSleep(i))
+          m_particles.updatePosition(i,m_timestep,m_halfheight,m_halfwidth,m_3d);
       }
     }
-    choo++;
   }
-  // */
+  {
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::HASH);
+    hashParticles();
+  }
 
-  //------------------------------------------POSITION----------------------------------------
+  //--------------------------------------NEIGHBOUR LIST-----------------------------------------------
 
-  for(int i=0; i<m_lastTakenParticle+1; ++i)
   {
-    if(m_particles[i].getAlive())
-    {
-      m_particles[i].updatePrevPosition();
-      if(!(m_particles[i].getDrag())&&!(m_particles[i].getWall()))
-        m_particles[i].updatePosition(m_timestep,m_halfheight,m_halfwidth,m_3d);
-    }
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::NEIGHBOURS);
+    if(m_useNeighbourList) updateNeighbourList();
   }
-  hashParticles();
 
   //--------------------------------------SPRING ALGORITMNS-----------------------------------------------
 
-  for(int k=0; k<m_gridheight*m_gridwidth; ++k)
   {
-    if(m_cellsContainingParticles[k])
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::SPRING_ADJUST);
+    NeighbourRanges ranges;
+    for(int k=0; k<(int)m_occupiedKeys.size(); ++k)
     {
-      std::vector<Particle *> surroundingParticles = getSurroundingParticles(k,3,false);
+      if(!m_cellAwake[k]) continue;
+      if(!m_useNeighbourList) getNeighbourRanges(m_occupiedKeys[k],1,ranges);
 
-      for(auto& i : m_grid[k])
+      for(int i=m_occupiedStart[k]; i<m_occupiedStart[k+1]; ++i)
       {
-        if(i->getProperties()->getSpring() && (!i->isObject() || (i->isObject() && !i->isInit()) ) && !i->getWall())
+        const ParticleProperties &iproperties = m_particleTypes[type[i]];
+        bool isobject = m_particles.hasFlag(i,ParticleStore::OBJECT);
+        bool isinit = m_particles.hasFlag(i,ParticleStore::INIT);
+        if(iproperties.getSpring() && (!isobject || (isobject && !isinit)) && !m_particles.getWall(i))
         {
-          for(auto& j : surroundingParticles)
+          // Nothing has moved since the neighbour list was built so its distances can be used as they are
+          int howmany = gatherCandidates(i,ranges,true,m_candidates,m_candidateDistance);
+          for(int c=0; c<howmany; ++c)
           {
-            if(j->getProperties()==i->getProperties()) // They only cling when same type
+            int j = m_candidates[c];
+            if(type[j]==type[i]) // They only cling when same type
             {
-              Vec3 rij=(j->getPosition()-i->getPosition());
-              float rijmag = rij.length();
+              float rijmag = m_candidateDistance[c];
               float q = rijmag/m_interactionradius;
 
               if(q<1 && q!=0)
               {
                 // FINDING / CREATING THE SPRING
-                bool quiter = false;
-                int thisspring;
-
-                for(auto& spring : i->m_particleSprings)
-                {
-                  if(((m_springs[spring].indexi==i->getIndex()) && (m_springs[spring].indexj==j->getIndex())) ||
-                     ((m_springs[spring].indexi==j->getIndex()) && (m_springs[spring].indexj==i->getIndex())))
-                  {
-                    // FOUND EXISTING SPRING
-                    m_springs[spring].alive=true;
-                    thisspring=spring;
-                    quiter=true;
-                    break;
-                  }
-                }
+                int thisspring = m_springHash.find(i,j);
 
-                if(!quiter)
+                if(thisspring==-1)
                 {
                   // HAVE TO CREATE A NEW SPRING
                   Particle::Spring newspring;
-                  newspring.indexi=i->getIndex();
-                  newspring.indexj=j->getIndex();
-                  newspring.count=everyother-1;
+                  newspring.indexi=i;
+                  newspring.indexj=j;
+                  newspring.count=_step-1;
                   newspring.alive=true;
                   newspring.L = m_interactionradius;
 
                   thisspring = insertSpring(newspring);
-                  if(thisspring==-1) break;
-
-                  i->m_particleSprings.push_back(thisspring);
-                  j->m_particleSprings.push_back(thisspring);
                 }
 
                 // MAKING SURE EACH SPRING IS ONLY UPDATED ONCE PER FRAME with count
-                if(m_springs[thisspring].count!=everyother)
+                if(m_springs[thisspring].count!=_step)
                 {
-                  GLfloat L = m_springs[thisspring].L;
-                  GLfloat d= L*i->getProperties()->getGamma();
-                  GLfloat alpha = i->getProperties()->getAlpha();
+                  float L = m_springs[thisspring].L;
+                  float d= L*iproperties.getGamma();
+                  float alpha = iproperties.getAlpha();
 
                   if(rijmag>L+d)
                   {
@@ -459,342 +362,1316 @@ void World::update(bool *updateinprogress) {
               }
             }
           }
-          i->setInit();
+          m_particles.setFlag(i,ParticleStore::INIT,true);
         }
       }
     }
   }
 
-  int count=0;
-  for(auto& i : m_springs)
-  {
-    if(i.alive){
-      Vec3 rij = (m_particles[i.indexj].getPosition() - m_particles[i.indexi].getPosition());
-      float rijmag = rij.length();
-
-      // WE DELETE SPRING IF PARTICLES TOO FAR APART
-      if(rijmag>m_interactionradius && !m_particles[i.indexi].isObject())
-      {
-        deleteSpring(count);
-      }
-
-      // ELSE WE MOVE THE PARTICLE ACCORDING TO SPRING
-      else
-      {
-        rij.normalize();
-        Vec3 D = rij*m_timestep*m_timestep*m_particles[i.indexi].getProperties()->getKspring()*(1-(i.L/m_interactionradius))*(i.L-rijmag);
-        m_particles[i.indexi].addPosition(-D/2,m_halfheight,m_halfwidth,m_3d);
-        m_particles[i.indexj].addPosition(D/2,m_halfheight,m_halfwidth,m_3d);   // HERE
-      }
-
-    }
-    count++;
-  }
-  defragSprings();
-
-  //----------------------------------DOUBLEDENSITY------------------------------------------
-  count =0;
-
-  for(int k = 0; k<(int)m_grid.size(); ++k)
   {
-    std::vector<Particle *> neighbours=getSurroundingParticles(count,1,false);
-
-    for(auto& i : m_grid[k])
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::SPRING_RELAX);
+    for(int s=0; s<(int)m_springs.size(); ++s)
     {
-      float density =0;
-      float neardensity=0;
-      for(auto& j : neighbours)
-      {
-        Vec3 rij = j->getPosition()-i->getPosition();
-        float rijmag = rij.length();
-        float q = rijmag/m_interactionradius;
-        if(q<1 && q!=0) // q==0 when same particle
+      Particle::Spring &spring = m_springs[s];
+      if(spring.alive){
+        int i = spring.indexi;
+        int j = spring.indexj;
+        if(m_particles.getSleep(i) && m_particles.getSleep(j)) continue;
+        float rijx = x[j]-x[i];
+        float rijy = y[j]-y[i];
+        float rijz = z[j]-z[i];
+        float rijmag = sqrt(rijx*rijx + rijy*rijy + rijz*rijz);
+
+        // WE DELETE SPRING IF PARTICLES TOO FAR APART
+        if(rijmag>m_interactionradius && !m_particles.hasFlag(i,ParticleStore::OBJECT))
         {
-          density+=(1.0f-q)*(1.0f-q);
-          neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+          deleteSpring(s);
         }
-      }
-
 
-      // MODIFY DENSITY AT BOUNDARIES when boundary type == 1
-      if(m_boundaryType==1)
-      {
-        // BOTTOM
-        float distance = m_halfheight + i->getPosition()[1];
-        float q = distance/(m_boundaryMultiplier*m_interactionradius);
-        if(q<1 && q!=0) // q==0 when same particle
-        {
-          density+=(1.0f-q)*(1.0f-q);
-          neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
-        }
-        // RIGHT
-        distance = m_halfwidth - i->getPosition()[0];
-        q = distance/(m_boundaryMultiplier*m_interactionradius);
-        if(q<1 && q!=0) // q==0 when same particle
+        // ELSE WE MOVE THE PARTICLE ACCORDING TO SPRING
+        else
         {
-          density+=(1.0f-q)*(1.0f-q);
-          neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+          if(rijmag!=0.0f)
+          {
+            rijx/=rijmag;
+            rijy/=rijmag;
+            rijz/=rijmag;
+          }
+          float D = m_timestep*m_timestep*m_particleTypes[type[i]].getKspring()*
+                    (1-(spring.L/m_interactionradius))*(spring.L-rijmag)/2.0f;
+          m_particles.addPosition(i,-rijx*D,-rijy*D,-rijz*D,m_halfheight,m_halfwidth,m_3d);
+          m_particles.addPosition(j,rijx*D,rijy*D,rijz*D,m_halfheight,m_halfwidth,m_3d);
         }
 
-        // LEFT
-        distance = i->getPosition()[0] + m_halfwidth ;
-        q = distance/(m_boundaryMultiplier*m_interactionradius);
-        if(q<1 && q!=0) // q==0 when same particle
-        {
-          density+=(1.0f-q)*(1.0f-q);
-          neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
-        }
       }
+    }
+  }
 
-      float p0 = i->getProperties()->getP0();
-      float k = i->getProperties()->getK();
-      float knear = i->getProperties()->getKnear();
+  //----------------------------------DOUBLEDENSITY------------------------------------------
 
-      float P = k*(density -p0);
-      float Pnear = knear * neardensity;
-      Vec3 dx = Vec3();
-      for(auto& j : neighbours)
-      {
-        Vec3 rij = j->getPosition()-i->getPosition();
-        float rijmag = rij.length();
-        float q = rijmag/m_interactionradius;
-        if(q<1 && q!=0)
-        {
-          rij.normalize();
-          Vec3 D = rij*(m_timestep*m_timestep*(P*(1.0f-q))+Pnear*(1.0f-q)*(1.0f-q));
-          if(!(j->getWall())) j->addPosition(D/2, m_halfheight, m_halfwidth,m_3d);
-          dx-=(D/2);
-        }
-      }
-      if(!(i->getWall())) i->addPosition(dx, m_halfheight, m_halfwidth,m_3d);
-    }
-    count++;
+  {
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::DENSITY);
+    if(m_parallelDensity) relaxDensityParallel();
+    else relaxDensitySerial();
   }
 
   //----------------------------------MAKE NEW VELOCITY-------------------------------------
 
-  for(auto& list : m_grid)
   {
-    for(auto& i : list)
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::VELOCITY);
+    float sleepdistance = m_sleepDistance*m_interactionradius;
+    sleepdistance*=sleepdistance;
+    for(int i=0; i<m_lastTakenParticle+1; ++i)
     {
-      i->setVelocity((i->getPosition()-i->getPrevPosition())/m_timestep);
+      if(m_particles.getAlive(i))
+      {
+        velx[i]=(x[i]-m_particles.m_prevx[i])/m_timestep;
+        vely[i]=(y[i]-m_particles.m_prevy[i])/m_timestep;
+        velz[i]=(z[i]-m_particles.m_prevz[i])/m_timestep;
+
+        // Settled fluid still jitters a little, so a particle counts as at rest while it stays close to where
+        // its rest began rather than while its velocity is zero. The window is small enough that fluid creeping
+        // along at more than m_sleepDistance/m_sleepSteps a step leaves it before it may sleep. A sleeping
+        // particle pushed away by a neighbour starts again.
+        if(m_sleeping)
+        {
+          float dx = x[i]-m_particles.m_restx[i];
+          float dy = y[i]-m_particles.m_resty[i];
+          float dz = z[i]-m_particles.m_restz[i];
+          if(dx*dx + dy*dy + dz*dz<sleepdistance)
+            m_particles.m_restSteps[i]=std::min(m_particles.m_restSteps[i]+1,m_sleepSteps);
+          else
+            m_particles.resetRest(i);
+        }
+      }
     }
   }
 
   //----------------------------------BOUNDARIES --------------------------------------------
 
-  // 2d/3d different
-  float smallen = 0.4f;
-  if(!m_3d) smallen=1.0f;
+  {
+    PhaseTimer::Scope timer(m_phaseTimer,PhaseTimer::BOUNDARY);
+    // 2d/3d different
+    float smallen = 0.4f;
+    if(!m_3d) smallen=1.0f;
 
 
-  // I found that the particles glitch and jump as they are being drawn in the middle of update
-  // So we see the particles before this boundary algorithm has been run.
+    // I found that the particles glitch and jump as they are being drawn in the middle of update
+    // So we see the particles before this boundary algorithm has been run.
 
-  // So these boundary algorithms have been replaced by the new and improved
-  // addPosition and updatePosition in Particle.cpp. Means they never leave the boundary when
-  // position is updated.
-  for(int i=0; i<m_lastTakenParticle+1; ++i)
-  {
-    if(m_particles[i].getAlive())
+    // So these boundary algorithms have been replaced by the new and improved
+    // addPosition and updatePosition in Particle.cpp. Means they never leave the boundary when
+    // position is updated.
+    for(int i=0; i<m_lastTakenParticle+1; ++i)
     {
-      if(m_boundaryType==0)
+      if(m_particles.getAlive(i) && !m_particles.getSleep(i))
       {
-        //------------------------------------BOTTOM------------------------------
-        if(m_particles[i].getPosition()[1]-0.5f<-m_halfheight)
+        if(m_boundaryType==0)
         {
-          m_particles[i].setPosition(Vec3(m_particles[i].getPosition()[0],-m_halfheight+0.5f,m_particles[i].getPosition()[2]));
-          m_particles[i].setVelocity(Vec3(m_particles[i].getVelocity()[0],-0.8f*m_particles[i].getVelocity()[1],0.0f));
-        }
-        //------------------------------------TOP------------------------------
+          //------------------------------------BOTTOM------------------------------
+          if(y[i]-0.5f<-m_halfheight)
+          {
+            y[i]=-m_halfheight+0.5f;
+            vely[i]=-0.8f*vely[i];
+            velz[i]=0.0f;
+          }
+          //------------------------------------TOP------------------------------
 
-        if(m_particles[i].getPosition()[1]+1.5f>m_halfheight)
-        {
-          m_particles[i].setPosition(Vec3(m_particles[i].getPosition()[0],m_halfheight-1.5f,m_particles[i].getPosition()[2]));
-          m_particles[i].addVelocity(Vec3(0.0f,-0.8f*m_particles[i].getVelocity()[1],0.0f));
-        }
+          if(y[i]+1.5f>m_halfheight)
+          {
+            y[i]=m_halfheight-1.5f;
+            vely[i]+=-0.8f*vely[i];
+          }
 
-        //------------------------------------RIGHT------------------------------
-        if(m_particles[i].getPosition()[0]>(m_halfwidth-0.5f)*smallen)
-        {
-          m_particles[i].setPosition(Vec3(smallen*(m_halfwidth-0.5f),m_particles[i].getPosition()[1],m_particles[i].getPosition()[2]));
-          m_particles[i].addVelocity(Vec3(-0.8f*m_particles[i].getVelocity()[0],0.0f));
-        }
-        //------------------------------------LEFT------------------------------
-        if(m_particles[i].getPosition()[0]<(-m_halfwidth+0.5f)*smallen)
-        {
-          m_particles[i].setPosition(Vec3(smallen*(-m_halfwidth+0.5f),m_particles[i].getPosition()[1],m_particles[i].getPosition()[2]));
-          m_particles[i].addVelocity(Vec3(-0.8f*m_particles[i].getVelocity()[0],0.0f));
-        }
+          //------------------------------------RIGHT------------------------------
+          if(x[i]>(m_halfwidth-0.5f)*smallen)
+          {
+            x[i]=smallen*(m_halfwidth-0.5f);
+            velx[i]+=-0.8f*velx[i];
+          }
+          //------------------------------------LEFT------------------------------
+          if(x[i]<(-m_halfwidth+0.5f)*smallen)
+          {
+            x[i]=smallen*(-m_halfwidth+0.5f);
+            velx[i]+=-0.8f*velx[i];
+          }
 
-        if(m_particles[i].getPosition()[2]<-2-(m_halfwidth+0.5f)*smallen)
-        {
-          m_particles[i].setPosition(Vec3(m_particles[i].getPosition()[0],m_particles[i].getPosition()[1],-2-(m_halfwidth+0.5)*smallen));
-          m_particles[i].addVelocity(Vec3(0.0f,0.0f,-0.8f*m_particles[i].getVelocity()[2]));
+          if(z[i]<-2-(m_halfwidth+0.5f)*smallen)
+          {
+            z[i]=-2-(m_halfwidth+0.5)*smallen;
+            velz[i]+=-0.8f*velz[i];
+          }
+          if(z[i]>-2+(m_halfwidth-0.5f)*smallen)
+          {
+            z[i]=-2+(m_halfwidth-0.5f)*smallen;
+            velz[i]+=-0.8f*velz[i];
+          }
         }
-        if(m_particles[i].getPosition()[2]>-2+(m_halfwidth-0.5f)*smallen)
+
+        if(m_boundaryType==1)
         {
-          m_particles[i].setPosition(Vec3(m_particles[i].getPosition()[0],m_particles[i].getPosition()[1],-2+(m_halfwidth-0.5f)*smallen));
-          m_particles[i].addVelocity(Vec3(0.0f,0.0f,-0.8f*m_particles[i].getVelocity()[2]));
-        }
-      }
+          // This version would have a higher velocity added to the particle as it got closer to the
+          // boundary. However I got lots of unwanted effects to the overall blob of fluid. Such as
+          // a "bubbling" effect like water emerging after a bubble has risen.
 
-      if(m_boundaryType==1)
-      {
-        // This version would have a higher velocity added to the particle as it got closer to the
-        // boundary. However I got lots of unwanted effects to the overall blob of fluid. Such as
-        // a "bubbling" effect like water emerging after a bubble has risen.
+          float fmult = 1.0f;
 
-        float fmult = 1.0f;
+          float distance = - y[i] + m_halfheight - 0.5f;
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            vely[i]-=sqrt(fmult*force);
+          }
 
-        float distance = - m_particles[i].getPosition()[1] + m_halfheight - 0.5f;
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(0.0f,-sqrt(fmult*force),0.0f));
-        }
+          distance = m_halfheight + y[i];
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            vely[i]+=sqrt(fmult*force);
+          }
 
-        distance = m_halfheight + m_particles[i].getPosition()[1];
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(0.0f,sqrt(fmult*force),0.0f));
-        }
+          distance = x[i] + m_halfwidth*smallen;
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            velx[i]+=sqrt(fmult*force);
+          }
 
-        distance = m_particles[i].getPosition()[0] + m_halfwidth*smallen;
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(sqrt(fmult*force),0.0f,0.0f));
-        }
+          distance = m_halfwidth*smallen - x[i];
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            velx[i]-=sqrt(fmult*force);
+          }
 
-        distance = m_halfwidth*smallen - m_particles[i].getPosition()[0];
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(-sqrt(fmult*force),0.0f,0.0f));
-        }
+          distance = z[i] - (-2-m_halfwidth*smallen);
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            velz[i]+=sqrt(fmult*force);
+          }
 
-        distance = m_particles[i].getPosition()[2] - (-2-m_halfwidth*smallen);
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(0.0f,0.0f,sqrt(fmult*force)));
-        }
+          distance = (-2+m_halfwidth*smallen) - z[i];
+          if(distance<(m_boundaryMultiplier*m_interactionradius))
+          {
+            float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
+            velz[i]-=sqrt(fmult*force);
+          }
 
-        distance = (-2+m_halfwidth*smallen) - m_particles[i].getPosition()[2] ;
-        if(distance<(m_boundaryMultiplier*m_interactionradius))
-        {
-          float force = ((m_boundaryMultiplier*m_interactionradius)-distance)/(m_timestep*m_timestep);
-          m_particles[i].addVelocity(Vec3(0.0f,0.0f,-sqrt(fmult*force)));
-        }
 
+        }
 
       }
+    }
+  }
+}
 
+int World::chooseSubsteps()
+{
+  float maxspeed = 0.0f;
+  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  {
+    if(m_particles.getAlive(i))
+    {
+      float vx = m_particles.m_velx[i];
+      float vy = m_particles.m_vely[i];
+      float vz = m_particles.m_velz[i];
+      maxspeed = std::max(maxspeed,vx*vx + vy*vy + vz*vz);
     }
   }
-
-  //----------------------------------CLEANUP ------------------------------------------------
-
-  if(everyother%30==0)
+  maxspeed = sqrt(maxspeed);
+
+  // CFL condition: no particle should move more than m_cflNumber of the interaction radius in one substep
+  int substeps = (int)ceil(maxspeed*m_timestep/(m_cflNumber*m_interactionradius));
+  substeps = std::max(1,std::min(substeps,m_maxSubsteps));
+
+  // Don't plan more substeps than fit in the wall-clock budget at the recent cost of one
+  if(m_frameBudgetms>0.0 && m_substepCostms>0.0)
+  {
+    int affordable = std::max(1,(int)(m_frameBudgetms/m_substepCostms));
+    substeps = std::min(substeps,affordable);
+  }
+  return substeps;
+}
+
+long World::getStep() const
+{
+  return m_step;
+}
+
+void World::setAdaptiveTimestep(bool _adaptive)
+{
+  m_adaptiveTimestep=_adaptive;
+}
+
+bool World::getAdaptiveTimestep() const
+{
+  return m_adaptiveTimestep;
+}
+
+void World::setCFLNumber(float _cfl)
+{
+  if(_cfl>0.0f) m_cflNumber=_cfl;
+}
+
+void World::setMaxSubsteps(int _max)
+{
+  m_maxSubsteps=std::max(1,_max);
+}
+
+void World::setFrameBudget(double _ms)
+{
+  m_frameBudgetms=_ms;
+}
+
+int World::getLastSubsteps() const
+{
+  return m_lastSubsteps;
+}
+
+//---------------------------------HASH FUNCTIONS--------------------------------------------------------
+
+void World::setSparseGrid(bool _sparse)
+{
+  m_sparseGrid=_sparse;
+  hashParticles();
+}
+
+bool World::getSparseGrid() const
+{
+  return m_sparseGrid;
+}
+
+int World::getCellKey(int _i) const
+{
+  int column = floor((m_particles.m_x[_i]+m_halfwidth)/m_squaresize);
+  int row = floor((m_particles.m_y[_i]+m_halfheight)/m_squaresize);
+  column = std::max(0,std::min(column,m_gridwidth-1));
+  row = std::max(0,std::min(row,m_gridheight-1));
+
+  int grid_cell = column + row*m_gridwidth;
+
+  if(m_3d)
+  {
+    int depth = floor((m_particles.m_z[_i]+m_halfwidth+2)/m_squaresize);
+    depth = std::max(0,std::min(depth,m_griddepth-1));
+    grid_cell += depth*m_gridwidth*m_gridheight;
+  }
+  return grid_cell;
+}
+
+int World::getGridSize() const
+{
+  if(!m_3d) return m_gridwidth*m_gridheight;
+  return m_gridwidth*m_gridheight*m_griddepth;
+}
+
+void World::countCellsDense()
+{
+  int gridSize = getGridSize();
+
+  // assign() keeps the capacity so none of these allocate once the grid size has settled
+  m_cellStart.assign(gridSize+1,0);
+
+  // FIRST PASS : find each particle's cell and count the particles per cell
+  int howmany = 0;
+  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  {
+    if(m_particles.getAlive(i))
+    {
+      int grid_cell = getCellKey(i);
+      m_particles.m_gridPosition[i]=grid_cell;
+      ++m_cellStart[grid_cell+1];
+      ++howmany;
+    }
+  }
+
+  m_occupiedKeys.clear();
+  m_occupiedStart.clear();
+  for(int k=0; k<gridSize; ++k)
+  {
+    if(m_cellStart[k+1]>0)
+    {
+      m_occupiedKeys.push_back(k);
+      m_occupiedStart.push_back(m_cellStart[k]);
+    }
+    m_cellStart[k+1]+=m_cellStart[k];
+  }
+  m_occupiedStart.push_back(howmany);
+
+  // SECOND PASS : scatter the particle indices into one flat array ordered by cell
+  m_cellCursor.assign(m_cellStart.begin(),m_cellStart.end()-1);
+  m_cellParticles.resize(howmany);
+  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  {
+    if(m_particles.getAlive(i))
+    {
+      m_cellParticles[m_cellCursor[m_particles.m_gridPosition[i]]++]=i;
+    }
+  }
+}
+
+void World::countCellsSparse()
+{
+  // Nothing here is the size of the grid, only of the number of particles and occupied cells
+  m_cellStart.clear();
+  m_cellHash.clear(m_occupiedKeys.size());
+  m_occupiedKeys.clear();
+  m_cellCursor.clear();
+  m_particleCell.resize(m_particles.size());
+
+  // FIRST PASS : find each particle's cell, give new cells the next free slot and count the particles per slot
+  int howmany = 0;
+  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  {
+    if(m_particles.getAlive(i))
+    {
+      int grid_cell = getCellKey(i);
+      int slot = m_cellHash.find(grid_cell);
+      if(slot==-1)
+      {
+        slot = (int)m_occupiedKeys.size();
+        m_cellHash.insert(grid_cell,slot);
+        m_occupiedKeys.push_back(grid_cell);
+        m_cellCursor.push_back(0);
+      }
+      m_particles.m_gridPosition[i]=grid_cell;
+      m_particleCell[i]=slot;
+      ++m_cellCursor[slot];
+      ++howmany;
+    }
+  }
+
+  // The slots are in the order the cells were found. Sorting them by key gives the same particle order as the
+  // dense grid and keeps the cells of a row next to each other, which getNeighbourRanges() relies on.
+  int occupied = (int)m_occupiedKeys.size();
+  m_cellOrder.resize(occupied);
+  for(int k=0; k<occupied; ++k) m_cellOrder[k]=k;
+  std::sort(m_cellOrder.begin(),m_cellOrder.end(),
+            [this](int _a, int _b) { return m_occupiedKeys[_a]<m_occupiedKeys[_b]; });
+
+  m_cellRank.resize(occupied);
+  m_occupiedStart.resize(occupied+1);
+  m_occupiedStart[0]=0;
+  for(int k=0; k<occupied; ++k)
+  {
+    m_cellRank[m_cellOrder[k]]=k;
+    m_occupiedStart[k+1]=m_occupiedStart[k]+m_cellCursor[m_cellOrder[k]];
+  }
+  for(int k=0; k<occupied; ++k)
+  {
+    m_cellOrder[k]=m_occupiedKeys[m_cellOrder[k]];
+  }
+  m_occupiedKeys.swap(m_cellOrder);
+  for(int k=0; k<occupied; ++k)
+  {
+    m_cellHash.insert(m_occupiedKeys[k],k);
+  }
+
+  // SECOND PASS : scatter the particle indices into one flat array ordered by cell
+  m_cellCursor.assign(m_occupiedStart.begin(),m_occupiedStart.end()-1);
+  m_cellParticles.resize(howmany);
+  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  {
+    if(m_particles.getAlive(i))
+    {
+      m_cellParticles[m_cellCursor[m_cellRank[m_particleCell[i]]]++]=i;
+    }
+  }
+}
+
+void World::getCellRange(int _cell, int &o_first, int &o_last) const
+{
+  o_first=0;
+  o_last=0;
+  if(_cell<0 || _cell>=getGridSize()) return;
+  if(!m_cellStart.empty())
+  {
+    o_first=m_cellStart[_cell];
+    o_last=m_cellStart[_cell+1];
+    return;
+  }
+  int k = m_cellHash.find(_cell);
+  if(k!=-1)
+  {
+    o_first=m_occupiedStart[k];
+    o_last=m_occupiedStart[k+1];
+  }
+}
+
+void World::hashParticles()
+{
+  if(m_3d && m_sparseGrid) countCellsSparse();
+  else countCellsDense();
+  int howmany = m_occupiedStart.back();
+
+  // REORDER the particle data by cell so that the neighbour loops walk contiguous memory.
+  // Anything that stores a particle index has to be remapped afterwards.
+  m_particleRemap.assign(m_particles.size(),-1);
+  for(int k=0; k<howmany; ++k)
+  {
+    m_particleRemap[m_cellParticles[k]]=k;
+  }
+  m_particles.reorder(m_cellParticles,howmany);
+
+  // A list with a skin can be carried over to the new order, otherwise it is rebuilt after hashing
+  if(m_neighbourList.isValid() && m_neighbourSkin>0.0f && m_neighbourList.count()==howmany)
+  {
+    m_neighbourList.reorder(m_cellParticles,m_particleRemap);
+  }
+  else
+  {
+    m_neighbourList.invalidate();
+  }
+
+  // The keys of the spring hash are particle indices so it is refilled with the new ones
+  m_springHash.clear();
+  for(int s=0; s<(int)m_springs.size(); ++s)
+  {
+    if(m_springs[s].alive)
+    {
+      m_springs[s].indexi=m_particleRemap[m_springs[s].indexi];
+      m_springs[s].indexj=m_particleRemap[m_springs[s].indexj];
+      m_springHash.insert(m_springs[s].indexi,m_springs[s].indexj,s);
+    }
+  }
+  m_springListsValid=false;
+  for(auto& i : m_draggedParticles)
+  {
+    i=m_particleRemap[i];
+  }
+  m_draggedParticles.erase(std::remove(m_draggedParticles.begin(),m_draggedParticles.end(),-1),
+                           m_draggedParticles.end());
+
+  m_firstFreeParticle=howmany;
+  m_lastTakenParticle=howmany-1;
+  m_howManyAliveParticles=howmany;
+
+  updateSleep();
+}
+
+void World::restoreCells()
+{
+  // Particles inserted since the last hash have no cell yet and may sit in a freed slot in the middle of another
+  // cell's run, then the cells have to be found again from the positions
+  int howmany = m_lastTakenParticle+1;
+  int previous = 0;
+  for(int i=0; i<howmany; ++i)
+  {
+    if(!m_particles.getAlive(i)) continue;
+    if(m_particles.m_gridPosition[i]<previous)
+    {
+      // The list is still the one of the world that was replaced
+      m_neighbourList.invalidate();
+      hashParticles();
+      return;
+    }
+    previous=m_particles.m_gridPosition[i];
+  }
+
+  // Otherwise the particles are still in the order of the hash that gave them their cells, so each cell is one run
+  bool dense = !(m_3d && m_sparseGrid);
+  m_occupiedKeys.clear();
+  m_occupiedStart.clear();
+  m_cellHash.clear(howmany);
+  for(int i=0; i<howmany; ++i)
+  {
+    // A particle deleted since that hash stays in the run it was in
+    if(!m_particles.getAlive(i)) continue;
+    if(m_occupiedKeys.empty() || m_particles.m_gridPosition[i]!=m_occupiedKeys.back())
+    {
+      if(!dense) m_cellHash.insert(m_particles.m_gridPosition[i],(int)m_occupiedKeys.size());
+      m_occupiedKeys.push_back(m_particles.m_gridPosition[i]);
+      m_occupiedStart.push_back(m_occupiedKeys.size()==1 ? 0 : i);
+    }
+  }
+  m_occupiedStart.push_back(howmany);
+
+  m_cellStart.clear();
+  if(dense)
+  {
+    int gridSize = getGridSize();
+    m_cellStart.assign(gridSize+1,0);
+    for(int k=0; k<(int)m_occupiedKeys.size(); ++k)
+    {
+      m_cellStart[m_occupiedKeys[k]+1]=m_occupiedStart[k+1]-m_occupiedStart[k];
+    }
+    for(int k=0; k<gridSize; ++k)
+    {
+      m_cellStart[k+1]+=m_cellStart[k];
+    }
+  }
+
+  // Only searched by the spring pass, after the hashParticles() of its substep has filled it again
+  m_springHash.clear();
+  m_neighbourList.invalidate();
+}
+
+//---------------------------------SLEEP FUNCTIONS-------------------------------------------------------
+
+void World::setSleeping(bool _sleeping)
+{
+  m_sleeping=_sleeping;
+  wakeParticles();
+}
+
+bool World::getSleeping() const
+{
+  return m_sleeping;
+}
+
+void World::setSleepThreshold(float _distance, int _steps)
+{
+  m_sleepDistance=_distance;
+  m_sleepSteps=std::max(1,_steps);
+  wakeParticles();
+}
+
+int World::getSleepingParticles() const
+{
+  return m_sleepingParticles;
+}
+
+void World::wakeParticles()
+{
+  for(int i=0; i<m_particles.size(); ++i)
+  {
+    m_particles.resetRest(i);
+    m_particles.setFlag(i,ParticleStore::SLEEP,false);
+  }
+  m_cellAwake.assign(m_occupiedKeys.size(),1);
+  m_sleepingParticles=0;
+}
+
+void World::updateSleep()
+{
+  int cells = (int)m_occupiedKeys.size();
+  m_cellAwake.assign(cells,1);
+  if(!m_sleeping)
+  {
+    if(m_sleepingParticles>0) wakeParticles();
+    return;
+  }
+
+  // A cell is restless if any of its particles has moved in the last m_sleepSteps steps or is being dragged
+  m_cellRestless.assign(cells,0);
+  for(int k=0; k<cells; ++k)
+  {
+    for(int i=m_occupiedStart[k]; i<m_occupiedStart[k+1]; ++i)
+    {
+      if(m_particles.m_restSteps[i]<m_sleepSteps || m_particles.getDrag(i))
+      {
+        m_cellRestless[k]=1;
+        break;
+      }
+    }
+  }
+
+  // Only cells with no restless cell around them sleep. The occupied cells are sorted by key so the cells of
+  // one row of the block around a restless cell are a single run of m_occupiedKeys.
+  std::fill(m_cellAwake.begin(),m_cellAwake.end(),0);
+  int layer = m_gridwidth*m_gridheight;
+  for(int k=0; k<cells; ++k)
+  {
+    if(!m_cellRestless[k]) continue;
+    int key = m_occupiedKeys[k];
+    int column = key%m_gridwidth;
+    int row = (key/m_gridwidth)%m_gridheight;
+    int depth = key/layer;
+    int firstcolumn = std::max(column-1,0);
+    int lastcolumn = std::min(column+1,m_gridwidth-1);
+    int firstdepth = m_3d ? std::max(depth-1,0) : 0;
+    int lastdepth = m_3d ? std::min(depth+1,m_griddepth-1) : 0;
+    for(int d=firstdepth; d<=lastdepth; ++d)
+    {
+      for(int r=std::max(row-1,0); r<=std::min(row+1,m_gridheight-1); ++r)
+      {
+        int rowcell = r*m_gridwidth + d*layer;
+        auto first = std::lower_bound(m_occupiedKeys.begin(),m_occupiedKeys.end(),rowcell+firstcolumn);
+        auto last = std::upper_bound(first,m_occupiedKeys.end(),rowcell+lastcolumn);
+        std::fill(m_cellAwake.begin()+(first-m_occupiedKeys.begin()),m_cellAwake.begin()+(last-m_occupiedKeys.begin()),1);
+      }
+    }
+  }
+
+  m_sleepingParticles=0;
+  for(int k=0; k<cells; ++k)
+  {
+    bool asleep = !m_cellAwake[k];
+    for(int i=m_occupiedStart[k]; i<m_occupiedStart[k+1]; ++i)
+    {
+      m_particles.setFlag(i,ParticleStore::SLEEP,asleep);
+    }
+    if(asleep) m_sleepingParticles+=m_occupiedStart[k+1]-m_occupiedStart[k];
+  }
+}
+
+void World::getNeighbourRanges(int thiscell, int rings, NeighbourRanges &o_ranges) const
+{
+  int layer = m_gridwidth*m_gridheight;
+  int column = thiscell%m_gridwidth;
+  int row = (thiscell/m_gridwidth)%m_gridheight;
+  int depth = thiscell/layer;
+
+  // Clamp the block to the grid so it never wraps round onto the other side of a row
+  int firstcolumn = std::max(column-rings,0);
+  int lastcolumn = std::min(column+rings,m_gridwidth-1);
+  int firstrow = std::max(row-rings,0);
+  int lastrow = std::min(row+rings,m_gridheight-1);
+  int firstdepth = 0;
+  int lastdepth = 0;
+  if(m_3d)
+  {
+    firstdepth = std::max(depth-rings,0);
+    lastdepth = std::min(depth+rings,m_griddepth-1);
+  }
+
+  // The cells of one row of the block are next to each other in m_cellStart and the particles are sorted
+  // by cell, so each row of the block is a single range of particle slots. m_cellStart is empty for the sparse grid.
+  o_ranges.count=0;
+  for(int d=firstdepth; d<=lastdepth; ++d)
+  {
+    for(int r=firstrow; r<=lastrow; ++r)
+    {
+      int rowcell = r*m_gridwidth + d*layer;
+      if(!m_cellStart.empty())
+      {
+        o_ranges.first[o_ranges.count]=m_cellStart[rowcell+firstcolumn];
+        o_ranges.last[o_ranges.count]=m_cellStart[rowcell+lastcolumn+1];
+        ++o_ranges.count;
+        continue;
+      }
+
+      // Sparse grid : the occupied cells are sorted by key as well, so the row runs from the first occupied
+      // cell of the row to the end of the last one
+      int first = -1;
+      int last = -1;
+      for(int c=firstcolumn; c<=lastcolumn; ++c)
+      {
+        int k = m_cellHash.find(rowcell+c);
+        if(k==-1) continue;
+        if(first==-1) first=m_occupiedStart[k];
+        last=m_occupiedStart[k+1];
+      }
+      if(first==-1) continue;
+      o_ranges.first[o_ranges.count]=first;
+      o_ranges.last[o_ranges.count]=last;
+      ++o_ranges.count;
+    }
+  }
+}
+
+std::vector<int> World::getSurroundingParticles(int thiscell, int /*numsur*/, bool dragselect) const
+{
+  std::vector<int> surroundingParticles;
+  if(thiscell<0 || thiscell>=getGridSize()) return surroundingParticles;
+
+  NeighbourRanges ranges;
+  getNeighbourRanges(thiscell,1,ranges);
+  for(int r=0; r<ranges.count; ++r)
+  {
+    for(int p=ranges.first[r]; p<ranges.last[r]; ++p)
+    {
+      if((dragselect && !m_particles.getWall(p)) || !dragselect) surroundingParticles.push_back(p);
+    }
+  }
+
+  return surroundingParticles;
+}
+
+//---------------------------------CHECKPOINT FUNCTIONS--------------------------------------------------
+
+bool World::saveCheckpoint(const std::string &_path) const
+{
+  static_assert(sizeof(int)==4 && sizeof(float)==4, "checkpoints store int and float as 4 bytes");
+  static_assert(sizeof(Particle::Spring)==20, "the spring layout changed, bump CheckpointHeader::s_version");
+
+  int n = m_lastTakenParticle+1;
+
+  // Same order as the arguments of the ParticleProperties constructor
+  std::vector<float> types;
+  for(auto& t : m_particleTypes)
+  {
+    float values[13] = {float(t.getSpring()), t.getSigma(), t.getBeta(), t.getGamma(), t.getAlpha(), t.getKnear(),
+                        t.getK(), t.getKspring(), t.getP0(), t.getRed(), t.getGreen(), t.getBlue(),
+                        float(t.getColourEffect())};
+    types.insert(types.end(),values,values+13);
+  }
+
+  CheckpointHeader header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.m_magic,"PPCK",4);
+  header.m_version=CheckpointHeader::s_version;
+  header.m_headerSize=sizeof(CheckpointHeader);
+  header.m_byteOrder=CheckpointHeader::s_byteOrder;
+  header.m_particles=n;
+  header.m_springs=(int)m_springs.size();
+  header.m_freeSprings=(int)m_freeSprings.size();
+  header.m_types=(int)m_particleTypes.size();
+  header.m_gridwidth=m_gridwidth;
+  header.m_gridheight=m_gridheight;
+  header.m_griddepth=m_griddepth;
+  header.m_halfwidth=m_halfwidth;
+  header.m_halfheight=m_halfheight;
+  header.m_worldHalfHeight=m_worldHalfHeight;
+  header.m_interactionradius=m_interactionradius;
+  header.m_squaresize=m_squaresize;
+  header.m_pointsize=m_pointsize;
+  header.m_boundaryMultiplier=m_boundaryMultiplier;
+  header.m_boundaryType=m_boundaryType;
+  header.m_todraw=m_todraw;
+  header.m_substepCount=m_substepCount;
+  header.m_timestep=m_timestep;
+  header.m_step=m_step;
+  header.m_3d=m_3d;
+  header.m_gravity=m_gravity;
+  header.m_rain=m_rain;
+  header.m_drawwall=m_drawwall;
+  header.m_nextParticleId=m_nextParticleId;
+
+  CheckpointWriter writer;
+  if(!writer.open(_path)) return false;
+  writer.write(&header,sizeof(header));
+  const std::vector<float> *floats[9] = {&m_particles.m_x, &m_particles.m_y, &m_particles.m_z,
+                                         &m_particles.m_prevx, &m_particles.m_prevy, &m_particles.m_prevz,
+                                         &m_particles.m_velx, &m_particles.m_vely, &m_particles.m_velz};
+  for(auto& f : floats)
+  {
+    writer.write(f->data(),n*sizeof(float));
+  }
+  writer.write(m_particles.m_type.data(),n*sizeof(int));
+  writer.write(m_particles.m_gridPosition.data(),n*sizeof(int));
+  writer.write(m_particles.m_id.data(),n*sizeof(int));
+  writer.write(m_particles.m_flags.data(),n);
+  writer.write(m_springs.data(),m_springs.size()*sizeof(Particle::Spring));
+  writer.write(m_freeSprings.data(),m_freeSprings.size()*sizeof(int));
+  writer.write(types.data(),types.size()*sizeof(float));
+  return writer.close();
+}
+
+bool World::loadCheckpoint(const std::string &_path)
+{
+  CheckpointReader reader;
+  if(!reader.open(_path)) return false;
+  const CheckpointHeader &header = reader.header();
+  int n = header.m_particles;
+
+  // Find every array first so a short or broken file leaves the world as it was
+  const float *floats[9];
+  for(auto& f : floats)
+  {
+    f=static_cast<const float *>(reader.read(n*sizeof(float)));
+  }
+  const int *type = static_cast<const int *>(reader.read(n*sizeof(int)));
+  const int *cell = static_cast<const int *>(reader.read(n*sizeof(int)));
+  const int *id = static_cast<const int *>(reader.read(n*sizeof(int)));
+  const unsigned char *flags = static_cast<const unsigned char *>(reader.read(n));
+  const void *springs = reader.read(header.m_springs*sizeof(Particle::Spring));
+  const int *freeSprings = static_cast<const int *>(reader.read(header.m_freeSprings*sizeof(int)));
+  const float *types = static_cast<const float *>(reader.read(header.m_types*13*sizeof(float)));
+  if(!types || !freeSprings || !springs || !flags || !id || !cell || !type || !floats[8])
+  {
+    std::cerr<<_path<<" is cut short"<<std::endl;
+    return false;
+  }
+  if(header.m_gridwidth<=0 || header.m_gridheight<=0 || header.m_griddepth<=0)
+  {
+    std::cerr<<_path<<" has an empty grid"<<std::endl;
+    return false;
+  }
+  long long gridsize = (long long)header.m_gridwidth*header.m_gridheight;
+  if(header.m_3d) gridsize*=header.m_griddepth;
+  for(int i=0; i<n; ++i)
+  {
+    if(type[i]<0 || type[i]>=header.m_types)
+    {
+      std::cerr<<_path<<" has a particle of unknown type "<<type[i]<<std::endl;
+      return false;
+    }
+    // -1 is a particle inserted since the last hash, restoreCells() finds its cell
+    if(cell[i]<-1 || cell[i]>=gridsize)
+    {
+      std::cerr<<_path<<" has a particle outside the grid"<<std::endl;
+      return false;
+    }
+  }
+  const Particle::Spring *springArray = static_cast<const Particle::Spring *>(springs);
+  for(int k=0; k<header.m_springs; ++k)
+  {
+    const Particle::Spring &spring = springArray[k];
+    if(!spring.alive) continue;
+    if(spring.indexi<0 || spring.indexi>=n || spring.indexj<0 || spring.indexj>=n ||
+       !(flags[spring.indexi]&ParticleStore::ALIVE) || !(flags[spring.indexj]&ParticleStore::ALIVE))
+    {
+      std::cerr<<_path<<" has a spring between missing particles"<<std::endl;
+      return false;
+    }
+  }
+  for(int f=0; f<header.m_freeSprings; ++f)
+  {
+    if(freeSprings[f]<0 || freeSprings[f]>=header.m_springs)
+    {
+      std::cerr<<_path<<" has a free spring that does not exist"<<std::endl;
+      return false;
+    }
+  }
+
+  // WORLD
+  m_gridwidth=header.m_gridwidth;
+  m_gridheight=header.m_gridheight;
+  m_griddepth=header.m_griddepth;
+  m_halfwidth=header.m_halfwidth;
+  m_halfheight=header.m_halfheight;
+  m_worldHalfHeight=header.m_worldHalfHeight;
+  m_interactionradius=header.m_interactionradius;
+  m_squaresize=header.m_squaresize;
+  m_pointsize=header.m_pointsize;
+  m_boundaryMultiplier=header.m_boundaryMultiplier;
+  m_boundaryType=header.m_boundaryType;
+  m_substepCount=header.m_substepCount;
+  m_timestep=header.m_timestep;
+  m_step=header.m_step;
+  m_3d=header.m_3d!=0;
+  m_gravity=header.m_gravity!=0;
+  m_rain=header.m_rain!=0;
+  m_drawwall=header.m_drawwall!=0;
+  m_nextParticleId=header.m_nextParticleId;
+  // The skin is limited by the cell size, which may not be the one it was set for
+  setNeighbourList(m_useNeighbourList,m_neighbourSkin);
+
+  m_particleTypes.resize(header.m_types);
+  for(int t=0; t<header.m_types; ++t)
+  {
+    const float *v = types+13*t;
+    m_particleTypes[t]=ParticleProperties(v[0]!=0.0f,v[1],v[2],v[3],v[4],v[5],v[6],v[7],v[8],v[9],v[10],v[11],
+                                          v[12]!=0.0f);
+  }
+  m_todraw=std::max(0,std::min(header.m_todraw,header.m_types-1));
+
+  // PARTICLES, one copy per array
+  m_particles.resize(std::max(n,m_particlesPoolSize));
+  std::fill(m_particles.m_flags.begin()+n,m_particles.m_flags.end(),0);
+  m_particleLimit=std::max(m_particleLimit,m_particles.size());
+  std::vector<float> *arrays[9] = {&m_particles.m_x, &m_particles.m_y, &m_particles.m_z,
+                                   &m_particles.m_prevx, &m_particles.m_prevy, &m_particles.m_prevz,
+                                   &m_particles.m_velx, &m_particles.m_vely, &m_particles.m_velz};
+  for(int a=0; a<9; ++a)
+  {
+    memcpy(arrays[a]->data(),floats[a],n*sizeof(float));
+  }
+  memcpy(m_particles.m_type.data(),type,n*sizeof(int));
+  memcpy(m_particles.m_gridPosition.data(),cell,n*sizeof(int));
+  memcpy(m_particles.m_id.data(),id,n*sizeof(int));
+  memcpy(m_particles.m_flags.data(),flags,n);
+  for(int i=0; i<n; ++i)
+  {
+    m_particles.setFlag(i,ParticleStore::DRAG,false);
+  }
+  m_draggedParticles.clear();
+  m_springListsValid=false;
+
+  m_springs.resize(header.m_springs);
+  memcpy(m_springs.data(),springs,header.m_springs*sizeof(Particle::Spring));
+  m_freeSprings.assign(freeSprings,freeSprings+header.m_freeSprings);
+
+  m_lastTakenParticle=n-1;
+  while(m_lastTakenParticle>-1 && !m_particles.getAlive(m_lastTakenParticle)) --m_lastTakenParticle;
+  m_firstFreeParticle=0;
+  while(m_firstFreeParticle<m_particles.size() && m_particles.getAlive(m_firstFreeParticle)) ++m_firstFreeParticle;
+  m_howManyAliveParticles=0;
+  for(int i=0; i<n; ++i)
+  {
+    if(m_particles.getAlive(i)) ++m_howManyAliveParticles;
+  }
+
+  // The renderer picks up the new size, dimension and types from the next snapshot
+  restoreCells();
+  wakeParticles();
+  return true;
+}
+
+//---------------------------------VISCOSITY FUNCTIONS----------------------------------------------
+
+void World::setParallelViscosity(bool _parallel)
+{
+  m_parallelViscosity=_parallel;
+}
+
+void World::viscositySerial()
+{
+  NeighbourRanges ranges;
+  for(int k = 0; k<(int)m_occupiedKeys.size(); ++k)
+  {
+    viscosityCell(k,ranges);
+  }
+}
+
+void World::viscosityParallel()
+{
+  int colours = colourCells(1);
+
+  // The impulses of a cell only reach the cells around it, so the cells of one colour are independent and the
+  // result is the same for any number of threads
+  #pragma omp parallel
+  {
+    NeighbourRanges ranges;
+    for(int c=0; c<colours; ++c)
+    {
+      #pragma omp for schedule(dynamic,4)
+      for(int n=m_colourStart[c]; n<m_colourStart[c+1]; ++n)
+      {
+        viscosityCell(m_colourCells[n],ranges);
+      }
+    }
+  }
+}
+
+void World::viscosityCell(int _cell, NeighbourRanges &io_ranges)
+{
+  const std::vector<float> &x = m_particles.m_x;
+  const std::vector<float> &y = m_particles.m_y;
+  const std::vector<float> &z = m_particles.m_z;
+  std::vector<float> &velx = m_particles.m_velx;
+  std::vector<float> &vely = m_particles.m_vely;
+  std::vector<float> &velz = m_particles.m_velz;
+  const std::vector<int> &type = m_particles.m_type;
+
+  if(!m_cellAwake[_cell]) return;
+  getNeighbourRanges(m_occupiedKeys[_cell],1,io_ranges);
+
+  // Each pair is visited once, from the particle with the lower index
+  for(int i=m_occupiedStart[_cell]; i<m_occupiedStart[_cell+1]; ++i)
+  {
+    if(m_particles.getWall(i)) continue;
+
+    const ParticleProperties &thisproperties = m_particleTypes[type[i]];
+    float sig = thisproperties.getSigma();
+    float bet = thisproperties.getBeta();
+
+    for(int r=0; r<io_ranges.count; ++r)
+    {
+      for(int j=std::max(io_ranges.first[r],i+1); j<io_ranges.last[r]; ++j)
+      {
+        if(m_particles.getWall(j)) continue;
+
+        float rijx = x[j]-x[i];
+        float rijy = y[j]-y[i];
+        float rijz = z[j]-z[i];
+        float rijmag = sqrt(rijx*rijx + rijy*rijy + rijz*rijz);
+        float q = rijmag/m_interactionradius;
+        if(q<1 && q!=0)
+        {
+          rijx/=rijmag;
+          rijy/=rijmag;
+          rijz/=rijmag;
+          float u = (velx[i]-velx[j])*rijx + (vely[i]-vely[j])*rijy + (velz[i]-velz[j])*rijz;
+          if(u>0)
+          {
+            float impulse = ((1-q)*(sig*u + bet*u*u))*m_timestep/2.0f;
+            velx[i]-=rijx*impulse;
+            vely[i]-=rijy*impulse;
+            velz[i]-=rijz*impulse;
+            velx[j]+=rijx*impulse;
+            vely[j]+=rijy*impulse;
+            velz[j]+=rijz*impulse;
+          }
+        }
+      }
+    }
+  }
+}
+
+//---------------------------------DOUBLE DENSITY FUNCTIONS----------------------------------------------
+
+void World::setParallelDensity(bool _parallel)
+{
+  m_parallelDensity=_parallel;
+}
+
+void World::relaxDensitySerial()
+{
+  NeighbourRanges ranges;
+  for(int k = 0; k<(int)m_occupiedKeys.size(); ++k)
+  {
+    relaxDensityCell(k,ranges,m_candidates,m_candidateDistance);
+  }
+}
+
+void World::relaxDensityParallel()
+{
+  int reach = 1;
+  if(m_useNeighbourList && m_neighbourSkin>0.0f) reach=2;
+  int colours = colourCells(reach);
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  m_threadCandidates.resize(threads);
+  m_threadCandidateDistance.resize(threads);
+
+  // Within a cell the particles are relaxed in order exactly like the serial pass. The cells of one colour don't
+  // interact and the colours run in a fixed order, so the result is the same for any number of threads.
+  #pragma omp parallel
+  {
+    int thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#endif
+    NeighbourRanges ranges;
+    for(int c=0; c<colours; ++c)
+    {
+      #pragma omp for schedule(dynamic,4)
+      for(int n=m_colourStart[c]; n<m_colourStart[c+1]; ++n)
+      {
+        relaxDensityCell(m_colourCells[n],ranges,m_threadCandidates[thread],m_threadCandidateDistance[thread]);
+      }
+    }
+  }
+}
+
+void World::relaxDensityCell(int _cell, NeighbourRanges &io_ranges, std::vector<int> &io_candidates, std::vector<float> &io_distance)
+{
+  std::vector<float> &x = m_particles.m_x;
+  std::vector<float> &y = m_particles.m_y;
+  std::vector<float> &z = m_particles.m_z;
+  const std::vector<int> &type = m_particles.m_type;
+
+  if(!m_cellAwake[_cell]) return;
+  if(!m_useNeighbourList) getNeighbourRanges(m_occupiedKeys[_cell],1,io_ranges);
+
+  for(int i=m_occupiedStart[_cell]; i<m_occupiedStart[_cell+1]; ++i)
+  {
+    // The springs have moved the particles so the distances are worked out again, but only once as nothing
+    // moves between the density loop and the displacement loop
+    int howmany = gatherCandidates(i,io_ranges,false,io_candidates,io_distance);
+
+    float density =0;
+    float neardensity=0;
+    for(int c=0; c<howmany; ++c)
+    {
+      float q = io_distance[c]/m_interactionradius;
+      if(q<1 && q!=0) // q==0 when same particle
+      {
+        density+=(1.0f-q)*(1.0f-q);
+        neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+      }
+    }
+    boundaryDensity(i,density,neardensity);
+
+    const ParticleProperties &iproperties = m_particleTypes[type[i]];
+    float p0 = iproperties.getP0();
+    float k = iproperties.getK();
+    float knear = iproperties.getKnear();
+
+    float P = k*(density -p0);
+    float Pnear = knear * neardensity;
+    float dxx = 0.0f, dxy = 0.0f, dxz = 0.0f;
+    for(int c=0; c<howmany; ++c)
+    {
+      int j = io_candidates[c];
+      float rijx = x[j]-x[i];
+      float rijy = y[j]-y[i];
+      float rijz = z[j]-z[i];
+      float rijmag = io_distance[c];
+      float q = rijmag/m_interactionradius;
+      if(q<1 && q!=0)
+      {
+        double dt2 = m_timestep*m_timestep;
+        float D = (dt2*(P*(1.0f-q))+dt2*(Pnear*(1.0f-q)*(1.0f-q)))/(2.0f*rijmag);
+        if(!m_particles.getWall(j))
+          m_particles.addPosition(j,rijx*D,rijy*D,rijz*D,m_halfheight,m_halfwidth,m_3d);
+        dxx-=rijx*D;
+        dxy-=rijy*D;
+        dxz-=rijz*D;
+      }
+    }
+    if(!m_particles.getWall(i)) m_particles.addPosition(i,dxx,dxy,dxz,m_halfheight,m_halfwidth,m_3d);
+  }
+}
+
+void World::boundaryDensity(int i, float &io_density, float &io_neardensity) const
+{
+  const std::vector<float> &x = m_particles.m_x;
+  const std::vector<float> &y = m_particles.m_y;
+
+  // MODIFY DENSITY AT BOUNDARIES when boundary type == 1
+  if(m_boundaryType==1)
+  {
+    // BOTTOM
+    float distance = m_halfheight + y[i];
+    float q = distance/(m_boundaryMultiplier*m_interactionradius);
+    if(q<1 && q!=0) // q==0 when same particle
+    {
+      io_density+=(1.0f-q)*(1.0f-q);
+      io_neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+    }
+    // RIGHT
+    distance = m_halfwidth - x[i];
+    q = distance/(m_boundaryMultiplier*m_interactionradius);
+    if(q<1 && q!=0) // q==0 when same particle
+    {
+      io_density+=(1.0f-q)*(1.0f-q);
+      io_neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+    }
+
+    // LEFT
+    distance = x[i] + m_halfwidth ;
+    q = distance/(m_boundaryMultiplier*m_interactionradius);
+    if(q<1 && q!=0) // q==0 when same particle
+    {
+      io_density+=(1.0f-q)*(1.0f-q);
+      io_neardensity+=(1.0f-q)*(1.0f-q)*(1.0f-q);
+    }
+  }
+}
+
+int World::colourCells(int reach)
+{
+  // Two cells at least 2*reach+1 apart along some axis can't touch the same particles, so the cells are split
+  // into that many colours per axis and the cells of one colour can be worked on at the same time
+  int stride = 2*reach+1;
+  int colours = stride*stride;
+  if(m_3d) colours*=stride;
+
+  int cells = (int)m_occupiedKeys.size();
+  int layer = m_gridwidth*m_gridheight;
+
+  // Counting sort of the occupied cells by colour, same as hashParticles()
+  m_colourStart.assign(colours+1,0);
+  m_cellColour.resize(cells);
+  for(int k=0; k<cells; ++k)
+  {
+    int key = m_occupiedKeys[k];
+    int column = key%m_gridwidth;
+    int row = (key/m_gridwidth)%m_gridheight;
+    int depth = key/layer;
+    m_cellColour[k]=column%stride + stride*(row%stride + stride*(depth%stride));
+    m_colourStart[m_cellColour[k]+1]++;
+  }
+  for(int c=0; c<colours; ++c)
+  {
+    m_colourStart[c+1]+=m_colourStart[c];
+  }
+  m_colourCells.resize(m_colourStart[colours]);
+  m_colourCursor.assign(m_colourStart.begin(),m_colourStart.end()-1);
+  for(int k=0; k<cells; ++k)
   {
-    std::cout<<"Numebr:"<<m_howManyAliveParticles<<std::endl;
+    m_colourCells[m_colourCursor[m_cellColour[k]]++]=k;
   }
-
-  *updateinprogress = false;
+  return colours;
 }
 
-//---------------------------------HASH FUNCTIONS--------------------------------------------------------
+//---------------------------------NEIGHBOUR LIST FUNCTIONS----------------------------------------------
 
-void World::hashParticles()
+void World::setNeighbourList(bool _enabled, float _skin)
+{
+  m_useNeighbourList=_enabled;
+  // The list is built from the 5x5 block of cells when there is a skin and relaxDensityParallel() colours the cells
+  // two apart. A pair is within r+skin when the list is built and each particle moves up to skin/2 before it is
+  // rebuilt, so r+2*skin must stay inside two cells or a reused pair could be written by two threads at once.
+  m_neighbourSkin=std::max(0.0f,std::min(_skin,(2.0f*m_squaresize-m_interactionradius)/2.0f));
+  m_neighbourList.invalidate();
+}
+
+void World::updateNeighbourList()
 {
-  int gridSize;
-  if(!m_3d) gridSize = m_gridwidth*m_gridheight;
-  else gridSize = m_gridwidth*m_gridheight*m_griddepth;
+  // hashParticles() has packed the alive particles to the left
+  int howmany = m_lastTakenParticle+1;
 
-  m_cellsContainingParticles.assign(gridSize,false);
-  std::vector<Particle *> newvector;
-  m_grid.assign(gridSize,newvector);
-  int grid_cell;
-  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  if(m_neighbourSkin>0.0f && m_neighbourList.isValid() && m_neighbourList.count()==howmany)
   {
-    if(m_particles[i].getAlive())
+    float halfskin = m_neighbourSkin/2.0f;
+    if(m_neighbourList.maxDisplacementSquared(m_particles)<halfskin*halfskin)
     {
-      float positionx = m_particles[i].getPosition()[0];
-      float positiony = m_particles[i].getPosition()[1];
-      float positionz = m_particles[i].getPosition()[2];
-
-      if(positionx<-m_halfwidth) positionx=m_halfwidth;
-      else if (positionx>m_halfwidth) positionx=m_halfwidth;
-      if(positiony<-m_halfheight) positiony=m_halfheight;
-      else if (positiony>m_halfheight) positiony=m_halfheight;
-      if(positionz<-2-m_halfwidth) positionz=-2-m_halfwidth;
-      else if (positionz>-2+m_halfwidth) positionz=-2+m_halfwidth;
-
-
-      grid_cell=
-          floor((positionx+m_halfwidth)/m_squaresize)+
-          floor((positiony+m_halfheight)/m_squaresize)*m_gridwidth;
+      m_neighbourList.refreshDistances(m_particles);
+      return;
+    }
+  }
 
+  float radius = m_interactionradius+m_neighbourSkin;
+  int rings = 1;
+  if(m_neighbourSkin>0.0f) rings=2;
 
-      if(m_3d) grid_cell+=floor((positionz+m_halfwidth+2)/m_squaresize)*m_gridwidth*m_gridheight;
+  const std::vector<float> &x = m_particles.m_x;
+  const std::vector<float> &y = m_particles.m_y;
+  const std::vector<float> &z = m_particles.m_z;
 
-      m_particles[i].setGridPosition(grid_cell);
+  m_neighbourList.beginBuild(howmany);
+  NeighbourRanges ranges;
+  for(int k=0; k<(int)m_occupiedKeys.size(); ++k)
+  {
+    getNeighbourRanges(m_occupiedKeys[k],rings,ranges);
 
-      if(grid_cell>=0 && grid_cell<gridSize)
+    for(int i=m_occupiedStart[k]; i<m_occupiedStart[k+1]; ++i)
+    {
+      m_neighbourList.m_start[i]=(int)m_neighbourList.m_neighbours.size();
+      for(int r=0; r<ranges.count; ++r)
       {
-        m_cellsContainingParticles[grid_cell]=true;
-        m_grid[grid_cell].push_back(&m_particles[i]);
+        for(int j=ranges.first[r]; j<ranges.last[r]; ++j)
+        {
+          if(j==i) continue;
+          float rijx = x[j]-x[i];
+          float rijy = y[j]-y[i];
+          float rijz = z[j]-z[i];
+          float rijmag = sqrt(rijx*rijx + rijy*rijy + rijz*rijz);
+          if(rijmag<radius)
+          {
+            m_neighbourList.m_neighbours.push_back(j);
+            m_neighbourList.m_distance.push_back(rijmag);
+          }
+        }
       }
     }
   }
+  m_neighbourList.endBuild(m_particles);
+  ++m_neighbourListBuilds;
 }
 
-std::vector<Particle *> World::getSurroundingParticles(int thiscell, int numsur, bool dragselect) const
+int World::gatherCandidates(int i, const NeighbourRanges &ranges, bool cached, std::vector<int> &o_candidates, std::vector<float> &o_distance) const
 {
-  int numSurrounding=1;
-  std::vector<Particle *> surroundingParticles;
-  if(!m_3d)
+  const std::vector<float> &x = m_particles.m_x;
+  const std::vector<float> &y = m_particles.m_y;
+  const std::vector<float> &z = m_particles.m_z;
+
+  o_candidates.clear();
+  o_distance.clear();
+
+  if(m_useNeighbourList)
   {
-    for(int i = -numSurrounding; i <= numSurrounding; ++i)
+    for(int e=m_neighbourList.m_start[i]; e<m_neighbourList.m_start[i+1]; ++e)
     {
-      for(int j = -numSurrounding; j <= numSurrounding; ++j)
+      int j = m_neighbourList.m_neighbours[e];
+      o_candidates.push_back(j);
+      if(cached)
       {
-        int grid_cell = thiscell+ i + j*m_gridwidth;
-        if(grid_cell<(m_gridwidth*m_gridheight) && grid_cell>=0)
-        {
-          for(auto& p : m_grid[grid_cell])
-          {
-            if(dragselect && !p->getWall() || !dragselect) surroundingParticles.push_back(p);
-          }
-        }
+        o_distance.push_back(m_neighbourList.m_distance[e]);
+      }
+      else
+      {
+        float rijx = x[j]-x[i];
+        float rijy = y[j]-y[i];
+        float rijz = z[j]-z[i];
+        o_distance.push_back(sqrt(rijx*rijx + rijy*rijy + rijz*rijz));
       }
     }
   }
   else
   {
-    for(int i = -numSurrounding; i <= numSurrounding; ++i)
+    for(int r=0; r<ranges.count; ++r)
     {
-      for(int j = -numSurrounding; j <= numSurrounding; ++j)
+      for(int j=ranges.first[r]; j<ranges.last[r]; ++j)
       {
-        for(int k = -numSurrounding; k <= numSurrounding; ++k)
-        {
-          int grid_cell = thiscell+ i + j*m_gridwidth + k*m_gridwidth*m_gridheight;
-
-          if(grid_cell<(m_gridwidth*m_gridheight*m_griddepth) && grid_cell>=0)
-          {
-            for(auto& p : m_grid[grid_cell])
-            {
-              if(dragselect && !p->getWall() || !dragselect) surroundingParticles.push_back(p);
-            }
-          }
-        }
+        if(j==i) continue;
+        float rijx = x[j]-x[i];
+        float rijy = y[j]-y[i];
+        float rijz = z[j]-z[i];
+        o_candidates.push_back(j);
+        o_distance.push_back(sqrt(rijx*rijx + rijy*rijy + rijz*rijz));
       }
     }
   }
-
-  return surroundingParticles;
+  return (int)o_candidates.size();
 }
 
 //---------------------------------GRID FUNCTIONS--------------------------------------------------------
@@ -825,9 +1702,11 @@ void World::mouseDraw(int x, int y)
 
   bool drawparticle=true;
   int grid_cell=floor((correctedx+m_halfwidth)/m_squaresize)+floor((correctedy+m_halfheight)/m_squaresize)*m_gridwidth;
-  for(auto& i : m_grid[grid_cell])
+  int first, last;
+  getCellRange(grid_cell,first,last);
+  for(int i=first; i<last; ++i)
   {
-    if(i->getPosition()[0]==correctedx && i->getPosition()[1]==correctedy)
+    if(m_particles.m_x[i]==correctedx && m_particles.m_y[i]==correctedy)
     {
       drawparticle=false;
       break;
@@ -863,8 +1742,9 @@ void World::mouseDrag(int _x, int _y)
 
     for(auto& i : m_draggedParticles)
     {
-      i->addPosition(Vec3(toaddx,-toaddy,0.0f),m_halfheight,m_halfwidth,m_3d);
-      getbackhere(&(*i));
+      m_particles.addPosition(i,toaddx,-toaddy,0.0f,m_halfheight,m_halfwidth,m_3d);
+      m_particles.resetRest(i);
+      getbackhere(i);
     }
     hashParticles();
   }
@@ -885,28 +1765,33 @@ void World::selectDraggedParticles(int _x, int _y)
 
   for(auto& i : m_draggedParticles)
   {
-    i->setDrag(true);
+    m_particles.setFlag(i,ParticleStore::DRAG,true);
+    m_particles.resetRest(i);
   }
   m_previousmousex=_x;
   m_previousmousey=_y;
 }
 
-void World::getbackhere(Particle * p)
+void World::getbackhere(int p)
 {
-  if(p->getPosition()[0]>m_halfwidth-0.5f) p->getPosition()[0]=m_halfwidth-0.5f;
-  else if(p->getPosition()[0]<-m_halfwidth+0.5f) p->getPosition()[0]=-m_halfwidth+0.5f;
-  if(p->getPosition()[1]>m_halfheight-0.5f) p->getPosition()[1]=m_halfheight-0.5f;
-  else if(p->getPosition()[1]<-m_halfheight+0.5f) p->getPosition()[1]=-m_halfheight+0.5f;
+  float &x = m_particles.m_x[p];
+  float &y = m_particles.m_y[p];
+  if(x>m_halfwidth-0.5f) x=m_halfwidth-0.5f;
+  else if(x<-m_halfwidth+0.5f) x=-m_halfwidth+0.5f;
+  if(y>m_halfheight-0.5f) y=m_halfheight-0.5f;
+  else if(y<-m_halfheight+0.5f) y=-m_halfheight+0.5f;
 }
 
 void World::mouseDragEnd(int _x, int _y)
 {
-  Vec3 newVelocity = Vec3(_x-m_previousmousex,m_previousmousey-_y);
+  float newvelx = (_x-m_previousmousex)*0.05f;
+  float newvely = (m_previousmousey-_y)*0.05f;
 
   for(auto& i : m_draggedParticles)
   {
-    i->setDrag(false);
-    i->addVelocity(newVelocity*0.05f);
+    m_particles.setFlag(i,ParticleStore::DRAG,false);
+    m_particles.m_velx[i]+=newvelx;
+    m_particles.m_vely[i]+=newvely;
   }
   m_draggedParticles.clear();
   m_previousmousex=-10;
@@ -930,20 +1815,53 @@ void World::handleKeys(char _input)
       else m_drawwall=true;
     }
     break;
+
+  case 'c' :
+    drawCube();
+    break;
+
+  case 'a' :
+    setAdaptiveTimestep(!m_adaptiveTimestep);
+    break;
+
+  case 'z' :
+    setSleeping(!m_sleeping);
+    break;
+
+  case 'k' :
+    saveCheckpoint("checkpoint.ppck");
+    break;
+
+  case 'l' :
+    loadCheckpoint("checkpoint.ppck");
+    break;
+
+  default:
+    break;
+
+  }
+}
+
+void World::handleRenderKeys(char _input)
+{
+  // The world as last drawn, m_3d itself belongs to the simulation thread
+  bool current_3d=getDrawnView().m_3d;
+  switch(_input)
+  {
   case 'r':
     if(m_renderoption==1) m_renderoption=2;
     else m_renderoption=1;
     break;
 
   case 't':
-    if(m_3d)
+    if(current_3d)
     {
       if(m_renderoption==1) m_renderoption=2;
       if(m_marching.getSnapshotMode()>2)
       {
         m_render3dresolution/=m_snapshotmultiplier;
-        m_render3dwidth=m_gridwidth*m_render3dresolution;
-        m_render3dheight=m_gridheight*m_render3dresolution;
+        m_render3dwidth=m_renderView.m_gridwidth*m_render3dresolution;
+        m_render3dheight=m_renderView.m_gridheight*m_render3dresolution;
         m_marching.toggle3DResolution();
         m_marching.setSnapshotMode(0);
       }
@@ -956,9 +1874,9 @@ void World::handleKeys(char _input)
 
 
   case 'p':
-    if(!m_3d)
+    if(!current_3d)
     {
-      resizeWindow(m_pixelwidth,m_pixelheight);
+      resizeRender(m_renderView);
       if(m_renderoption==2) m_renderoption=1;
       m_camerarotatex=0.0f;
       m_camerarotatey=0.0f;
@@ -966,17 +1884,18 @@ void World::handleKeys(char _input)
     break;
 
   case 'o' :
-    resizeWindow(m_pixelwidth,m_pixelheight);
+    resizeRender(m_renderView);
     break;
 
-  case 'c' :
-    drawCube();
+  case 'm' :
+    setCompactMetaballs(!m_compactMetaballs);
     break;
 
   default:
     break;
 
   }
+  m_snapshotMode=m_marching.getSnapshotMode();
 }
 
 void World::mouseErase(int x, int y)
@@ -985,57 +1904,82 @@ void World::mouseErase(int x, int y)
   float worldx = ((float)x/(float)m_pixelwidth)*(m_halfwidth*2) - m_halfwidth;
   float worldy = -((float)y/(float)m_pixelheight)*(m_halfheight*2) + m_halfheight;
   int grid_cell=floor((worldx+m_halfwidth)/m_squaresize)+floor((worldy+m_halfheight)/m_squaresize)*m_gridwidth;
-  if (m_cellsContainingParticles[grid_cell])
+  int first, last;
+  getCellRange(grid_cell,first,last);
+  if (last>first)
   {
-    bool thereisanobject=false;
-    for(auto& i : m_grid[grid_cell])
+    for(int i=first; i<last; ++i)
     {
-      //if(!(i->isObject()))
-      deleteParticle(i->getIndex());
-      thereisanobject=true;
+      //if(!(m_particles.hasFlag(i,ParticleStore::OBJECT)))
+      deleteParticle(i);
     }
 
   }
   m_previousmousex=x;
   m_previousmousey=y;
-  defragParticles();
-  defragSprings();
+  hashParticles();
+
+  // The particles around the hole have to fall into it
+  if(m_sleeping)
+  {
+    for(auto& i : getSurroundingParticles(grid_cell,1,false))
+    {
+      m_particles.resetRest(i);
+    }
+    updateSleep();
+  }
 }
 
 //------------------------PARTICLES FUNCTIONS-------------------------------------
 
 void World::insertParticle(Particle particle)
 {
-  if(m_firstFreeParticle<m_particlesPoolSize-1)
+  if(m_firstFreeParticle>=m_particles.size()) growParticles();
+  if(m_firstFreeParticle>=m_particles.size())
+  {
+    ++m_droppedParticles;
+    return;
+  }
+
+  int type = particle.getProperties()-&m_particleTypes[0];
+  m_particles.set(m_firstFreeParticle,particle,type);
+  m_particles.m_id[m_firstFreeParticle]=m_nextParticleId++;
+  m_neighbourList.invalidate();
+  if(m_lastTakenParticle<m_firstFreeParticle)
   {
-    m_particles[m_firstFreeParticle]=particle;
-    m_particles[m_firstFreeParticle].setIndex(m_firstFreeParticle);
-    if(m_lastTakenParticle<m_firstFreeParticle)
+    ++m_lastTakenParticle;
+    ++m_firstFreeParticle;
+  }
+  else{
+    while(m_firstFreeParticle!=m_particles.size() && m_particles.getAlive(m_firstFreeParticle))
     {
-      ++m_lastTakenParticle;
       ++m_firstFreeParticle;
     }
-    else{
-      while(m_particles[m_firstFreeParticle].getAlive()==true && m_firstFreeParticle!=m_particlesPoolSize)
-      {
-        ++m_firstFreeParticle;
-      }
-    }
-    ++m_howManyAliveParticles;
   }
+  ++m_howManyAliveParticles;
 }
 
 void World::deleteParticle(int p)
 {
-  m_particles[p].setAlive(false);
-  for(auto& i : m_particles[p].m_particleSprings)
+  if(!m_particles.getAlive(p)) return;
+
+  m_particles.setFlag(p,ParticleStore::ALIVE,false);
+  m_neighbourList.invalidate();
+
+  if(!m_springListsValid) buildSpringLists();
+  // A particle past the end of the lists was inserted since they were built, and has no springs yet
+  if(p+1<(int)m_springListStart.size())
   {
-    deleteSpring(i);
+    for(int k=m_springListStart[p]; k<m_springListStart[p+1]; ++k)
+    {
+      const Particle::Spring &spring = m_springs[m_springList[k]];
+      if(spring.alive && (spring.indexi==p || spring.indexj==p)) deleteSpring(m_springList[k]);
+    }
   }
 
   if(m_lastTakenParticle==p)
   {
-    while(m_particles[m_lastTakenParticle].getAlive()==false && m_lastTakenParticle>-1)
+    while(m_lastTakenParticle>-1 && !m_particles.getAlive(m_lastTakenParticle))
     {
       --m_lastTakenParticle;
     }
@@ -1044,79 +1988,94 @@ void World::deleteParticle(int p)
   --m_howManyAliveParticles;
 }
 
-void World::defragParticles()
+void World::growParticles()
 {
-  for(int i=m_lastTakenParticle; i>m_firstFreeParticle; --i)
-  {
-    if(m_particles[i].getAlive())
-    {
-      for(auto& j : m_particles[i].m_particleSprings)
-      {
-        if(m_springs[j].indexi==i) m_springs[j].indexi=m_firstFreeParticle;
-        else if(m_springs[j].indexj==i) m_springs[j].indexj=m_firstFreeParticle;
-      }
-      insertParticle(m_particles[i]);
-      deleteParticle(i);
-    }
-  }
+  // Particles are only referred to by index so nothing is left dangling when the arrays move
+  int size = std::min(std::max(2*m_particles.size(),m_particlesPoolSize),m_particleLimit);
+  if(size<=m_particles.size()) return;
+  m_particles.resize(size);
+  ++m_particlePoolGrowths;
+}
+
+void World::setParticleLimit(int _limit)
+{
+  m_particleLimit=std::max(_limit,m_particles.size());
+}
+
+int World::getParticlePoolSize() const
+{
+  return m_particles.size();
+}
+
+int World::getParticlePoolGrowths() const
+{
+  return m_particlePoolGrowths;
+}
+
+int World::getDroppedParticles() const
+{
+  return m_droppedParticles;
 }
 
 //-------------------------SPRING FUNCTIONS----------------------------------------
 
 int World::insertSpring(Particle::Spring spring)
 {
-
-  if(m_firstFreeSpring<m_springsize-1)
+  int result;
+  if(!m_freeSprings.empty())
   {
-    int result = m_firstFreeSpring;
-    m_springs[m_firstFreeSpring]=spring;
-    if(m_lastTakenSpring<m_firstFreeSpring)
-    {
-      ++m_lastTakenSpring;
-      ++m_firstFreeSpring;
-    }
-    else{
-      while(m_springs[m_firstFreeSpring].alive)
-      {
-        ++m_firstFreeSpring;
-      }
-    }
-    return result;
+    result = m_freeSprings.back();
+    m_freeSprings.pop_back();
+    m_springs[result]=spring;
   }
   else
   {
-    return -1;
+    result = (int)m_springs.size();
+    m_springs.push_back(spring);
   }
+  m_springHash.insert(spring.indexi,spring.indexj,result);
+  m_springListsValid=false;
+  return result;
 }
 
 void World::deleteSpring(int s)
 {
   m_springs[s].alive=false;
-  m_particles[m_springs[s].indexi].updateSpringIndex(s,-1);
-  m_particles[m_springs[s].indexj].updateSpringIndex(s,-1);
-  if(m_lastTakenSpring==s)
-  {
-    while(m_springs[m_lastTakenSpring].alive==false && m_lastTakenSpring>-1)
-    {
-      --m_lastTakenSpring;
-    }
-  }
-  if(m_firstFreeSpring>s) m_firstFreeSpring=s;
+  m_springHash.erase(m_springs[s].indexi,m_springs[s].indexj,s);
+  m_freeSprings.push_back(s);
 }
 
-void World::defragSprings()
+void World::buildSpringLists()
 {
-  for(int i=m_lastTakenSpring; i>m_firstFreeSpring; --i)
+  // Counting sort of the two ends of every alive spring by particle
+  int particles = m_lastTakenParticle+1;
+  m_springListStart.assign(particles+1,0);
+  for(auto& spring : m_springs)
   {
-    if(m_springs[i].alive)
-    {
-      m_particles[m_springs[i].indexi].updateSpringIndex(i,m_firstFreeSpring);
-      m_particles[m_springs[i].indexj].updateSpringIndex(i,m_firstFreeSpring);
-      insertSpring(m_springs[i]);
-      deleteSpring(i);
-    }
+    if(!spring.alive) continue;
+    ++m_springListStart[spring.indexi+1];
+    ++m_springListStart[spring.indexj+1];
+  }
+  for(int i=0; i<particles; ++i)
+  {
+    m_springListStart[i+1]+=m_springListStart[i];
+  }
+  m_springList.resize(m_springListStart[particles]);
+  // Each particle's offset is used as its cursor and ends up at the next particle's, then they are shifted back
+  for(int s=0; s<(int)m_springs.size(); ++s)
+  {
+    if(!m_springs[s].alive) continue;
+    m_springList[m_springListStart[m_springs[s].indexi]++]=s;
+    m_springList[m_springListStart[m_springs[s].indexj]++]=s;
+  }
+  for(int i=particles; i>0; --i)
+  {
+    m_springListStart[i]=m_springListStart[i-1];
   }
+  m_springListStart[0]=0;
+  m_springListsValid=true;
 }
+
 //-------------------------GETTERS------------------------------
 
 float World::getHalfHeight() const
@@ -1151,6 +2110,7 @@ void World::toggleGravity()
 {
   if(m_gravity) m_gravity=false;
   else m_gravity=true;
+  wakeParticles();
 }
 
 void World::drawWith(int type)
@@ -1169,11 +2129,11 @@ void World::drawWith(int type)
 //--------------------------3D STUFF ------------------------------------------------
 
 void World::mouseMove(const int &x, const int &y, bool leftclick) {
-  if(m_3d)
+  if(getDrawnView().m_3d)
   {
     // only called when clicked
-    float dx = (float)(x - m_previousmousex);
-    float dy = (float)(y - m_previousmousey);
+    float dx = (float)(x - m_cameramousex);
+    float dy = (float)(y - m_cameramousey);
 
     if(leftclick)
     {
@@ -1182,57 +2142,201 @@ void World::mouseMove(const int &x, const int &y, bool leftclick) {
       std::cout<<m_camerarotatey<<std::endl;
     }
 
-    m_previousmousex=x;
-    m_previousmousey=y;
+    m_cameramousex=x;
+    m_cameramousey=y;
+  }
+}
+
+const FieldBuffer &World::renderGrid(const RenderSnapshot &_snapshot, ParticleProperties *p)
+{
+  int type = p-&m_particleTypes[0];
+  if(m_renderFields.size()<m_particleTypes.size()) m_renderFields.resize(m_particleTypes.size());
+
+  // Kept from frame to frame so this does not allocate once the window size has settled
+  FieldBuffer &rendergrid = m_renderFields[type];
+  rendergrid.reset(m_render2dheight+1,m_render2dwidth+1);
+  if(m_compactMetaballs)
+  {
+    m_metaballKernel.set(m_renderView.m_interactionradius,m_renderView.m_squaresize,m_mainrender2dthreshold);
+  }
+  for(int i=0; i<_snapshot.m_count; ++i)
+  {
+    if(_snapshot.m_type[i]==type) splat2D(_snapshot,i,rendergrid,0,INT_MAX);
   }
+  return rendergrid;
 }
 
-std::vector<std::vector<float>> World::renderGrid(ParticleProperties *p)
+void World::splat2D(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _firstRow, int _lastRow)
 {
-  std::vector<std::vector<float>> rendergrid;
-  rendergrid.clear();
-  rendergrid.resize(m_render2dheight+1);
-  for(auto& i : rendergrid)
+  if(m_compactMetaballs)
   {
-    i.resize(m_render2dwidth+1,0.0f);
+    splat2DCompact(_snapshot,_i,io_grid,_firstRow,_lastRow);
+    return;
   }
 
-  float rendersquare=m_squaresize/m_render2DResolution;
-  for(int i=0; i<m_lastTakenParticle+1; ++i)
+  float rendersquare=m_renderView.m_squaresize/m_render2DResolution;
+  int cell = _snapshot.m_gridPosition[_i];
+  Vec3 heightwidth = Vec3(cell%m_renderView.m_gridwidth,cell/m_renderView.m_gridwidth)*m_render2DResolution;
+  int firsty = std::max(-2*m_render2DResolution,_firstRow-(int)heightwidth[1]);
+  int lasty = std::min(4*m_render2DResolution,_lastRow-1-(int)heightwidth[1]);
+  for(int x = -2*m_render2DResolution; x<=4*m_render2DResolution; ++x)
   {
-    if(m_particles[i].getAlive()&&(m_particles[i].getProperties()==p))
+    for(int y = firsty; y<=lasty ; ++y)
     {
-      Vec3 heightwidth = getGridColumnRow(m_particles[i].getGridPosition())*m_render2DResolution;
-      for(int x = -2*m_render2DResolution; x<=4*m_render2DResolution; ++x)
-      {
-        for(int y = -2*m_render2DResolution; y<=4*m_render2DResolution ; ++y)
-        {
-          int currentcolumn=heightwidth[0]+x;
-          int currentrow=heightwidth[1]+y;
+      int currentcolumn=heightwidth[0]+x;
+      int currentrow=heightwidth[1]+y;
 
-          if(currentcolumn<m_render2dwidth && currentcolumn>0 &&
-             currentrow<m_render2dheight && currentrow>0)
-          {
-            float currentx = rendersquare*(float)currentcolumn - m_halfwidth;
-            float currenty = rendersquare*(float)currentrow - m_halfheight;
+      if(currentcolumn<m_render2dwidth && currentcolumn>0 &&
+         currentrow<m_render2dheight && currentrow>0)
+      {
+        float currentx = rendersquare*(float)currentcolumn - m_renderView.m_halfwidth;
+        float currenty = rendersquare*(float)currentrow - m_renderView.m_halfheight;
 
-            float metaballx = currentx-m_particles[i].getPosition()[0];
-            float metabally = currenty-m_particles[i].getPosition()[1];
+        float metaballx = currentx-_snapshot.m_x[_i];
+        float metabally = currenty-_snapshot.m_y[_i];
 
-            float metaballfloat = (m_interactionradius*m_interactionradius)/(metaballx*metaballx + metabally*metabally);
+        float metaballfloat = (m_renderView.m_interactionradius*m_renderView.m_interactionradius)/(metaballx*metaballx + metabally*metabally);
 
-            rendergrid[currentrow][currentcolumn]+=metaballfloat;
-          }
-        }
+        io_grid.at(currentrow,currentcolumn)+=metaballfloat;
       }
     }
   }
-  return rendergrid;
+}
+
+void World::splat2DCompact(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _firstRow, int _lastRow)
+{
+  float rendersquare=m_renderView.m_squaresize/m_render2DResolution;
+  float radius=m_metaballKernel.getRadius();
+  // Position from the bottom left corner of the world, where sample (0,0) is
+  float px=_snapshot.m_x[_i]+m_renderView.m_halfwidth;
+  float py=_snapshot.m_y[_i]+m_renderView.m_halfheight;
+
+  int firstrow = std::max(std::max(1,_firstRow),(int)std::ceil((py-radius)/rendersquare));
+  int lastrow = std::min(std::min(m_render2dheight-1,_lastRow-1),(int)std::floor((py+radius)/rendersquare));
+  for(int row=firstrow; row<=lastrow; ++row)
+  {
+    float dy = rendersquare*(float)row-py;
+    float halfchord2 = radius*radius-dy*dy;
+    if(halfchord2<=0.0f) continue;
+
+    // Only the samples of this row inside the circle
+    float halfchord = std::sqrt(halfchord2);
+    int firstcolumn = std::max(1,(int)std::ceil((px-halfchord)/rendersquare));
+    int lastcolumn = std::min(m_render2dwidth-1,(int)std::floor((px+halfchord)/rendersquare));
+    if(lastcolumn<firstcolumn) continue;
+
+    m_metaballKernel.addRow(&io_grid.at(row,firstcolumn),lastcolumn-firstcolumn+1,
+                            rendersquare*(float)firstcolumn-px,rendersquare,dy*dy);
+  }
+}
+
+void World::renderFields(const RenderSnapshot &_snapshot, bool _3d)
+{
+  int types = (int)_snapshot.m_types.size();
+  if((int)m_renderFields.size()<types) m_renderFields.resize(types);
+
+  // The grids are cut into tiles along their first index, one row of the spatial hash wide in 2D and one column
+  // in 3D. A metaball reaches from 2 cells before its own cell to 4 after, so the tile of hash row g only
+  // gathers from the particles in hash rows g-4 to g+2.
+  int resolution = _3d ? m_render3dresolution : m_render2DResolution;
+  int bands = _3d ? m_renderView.m_gridwidth : m_renderView.m_gridheight;
+  int reachbelow = 4;
+  int reachabove = 2;
+  if(!_3d && m_compactMetaballs)
+  {
+    // The compact metaball reaches its radius either way from the particle. The snapshot may have been taken
+    // after the particle left the cell it was hashed into, so allow one more row.
+    m_metaballKernel.set(m_renderView.m_interactionradius,m_renderView.m_squaresize,m_mainrender2dthreshold);
+    reachbelow = reachabove = (int)std::ceil(m_metaballKernel.getRadius()/m_renderView.m_squaresize)+1;
+  }
+
+  // Counting sort of the particles by type and then band, so the snapshot is read once for every type together
+  // and the particles a tile needs are one run
+  m_fieldBandStart.assign(types*bands+1,0);
+  m_fieldParticleBand.resize(_snapshot.m_count);
+  int gridwidth = m_renderView.m_gridwidth;
+  for(int i=0; i<_snapshot.m_count; ++i)
+  {
+    int band = _3d ? _snapshot.m_gridPosition[i]%gridwidth : _snapshot.m_gridPosition[i]/gridwidth;
+    band = _snapshot.m_type[i]*bands + std::max(0,std::min(band,bands-1));
+    m_fieldParticleBand[i]=band;
+    ++m_fieldBandStart[band+1];
+  }
+  for(int b=0; b<types*bands; ++b)
+  {
+    m_fieldBandStart[b+1]+=m_fieldBandStart[b];
+  }
+  m_fieldBandCursor.assign(m_fieldBandStart.begin(),m_fieldBandStart.end()-1);
+  m_fieldParticles.resize(_snapshot.m_count);
+  for(int i=0; i<_snapshot.m_count; ++i)
+  {
+    m_fieldParticles[m_fieldBandCursor[m_fieldParticleBand[i]]++]=i;
+  }
+  m_fieldTypeStart.resize(types+1);
+  for(int t=0; t<=types; ++t)
+  {
+    m_fieldTypeStart[t]=m_fieldBandStart[t*bands];
+  }
+
+  // Types without particles keep whatever their layer held, getRenderFieldCount() tells the caller to skip them
+  for(int t=0; t<types; ++t)
+  {
+    if(getRenderFieldCount(t)==0) continue;
+    if(_3d) m_renderFields[t].reset(m_render3dwidth+1,m_render3dheight+1,m_render3dwidth+1);
+    else m_renderFields[t].reset(m_render2dheight+1,m_render2dwidth+1);
+  }
+
+  // Every tile is written by one thread only, so no two threads add to the same value. Each value gets its
+  // particles in the same order whichever thread fills it, so the grids are the same for any number of threads.
+  #pragma omp parallel for schedule(dynamic) if(m_parallelRender)
+  for(int job=0; job<types*bands; ++job)
+  {
+    int t = job/bands;
+    int g = job%bands;
+    if(getRenderFieldCount(t)==0) continue;
+
+    int first = g*resolution;
+    int last = g==bands-1 ? INT_MAX : first+resolution;
+    int from = m_fieldBandStart[t*bands+std::max(0,g-reachbelow)];
+    int to = m_fieldBandStart[t*bands+std::min(bands-1,g+reachabove)+1];
+    for(int k=from; k<to; ++k)
+    {
+      if(_3d) splat3D(_snapshot,m_fieldParticles[k],m_renderFields[t],first,last);
+      else splat2D(_snapshot,m_fieldParticles[k],m_renderFields[t],first,last);
+    }
+  }
+}
+
+void World::setParallelRender(bool _parallel)
+{
+  m_parallelRender=_parallel;
+}
+
+void World::setCompactMetaballs(bool _compact)
+{
+  m_compactMetaballs=_compact;
+}
+
+float World::getRender2DThreshold() const
+{
+  return m_mainrender2dthreshold;
+}
+
+const FieldBuffer &World::getRenderField(int _type) const
+{
+  return m_renderFields[_type];
+}
+
+int World::getRenderFieldCount(int _type) const
+{
+  if(_type+1>=(int)m_fieldTypeStart.size()) return 0;
+  return m_fieldTypeStart[_type+1]-m_fieldTypeStart[_type];
 }
 
 void World::set3D(bool b)
 {
   m_3d=b;
+  wakeParticles();
 }
 
 bool World::get3D()
@@ -1242,71 +2346,69 @@ bool World::get3D()
 
 void World::setToDraw(int _todraw)
 {
-  if(_todraw<m_particleTypes.size()) m_todraw=_todraw;
+  if(_todraw<(int)m_particleTypes.size()) m_todraw=_todraw;
 }
 
 void World::setRandomType(int _randomSeed)
 {
   m_particleTypes[3].randomize(_randomSeed);
   m_particleTypes[3].printVariables();
+  wakeParticles();
 }
 
-std::vector<std::vector<std::vector<float>>> World::render3dGrid(ParticleProperties *p)
+const FieldBuffer &World::render3dGrid(const RenderSnapshot &_snapshot, ParticleProperties *p)
 {
-  std::vector<std::vector<std::vector<float>>> rendergrid;
-  rendergrid.clear();
-  rendergrid.resize(m_render3dwidth+1);
-  for(auto& i : rendergrid)
+  int type = p-&m_particleTypes[0];
+  if(m_renderFields.size()<m_particleTypes.size()) m_renderFields.resize(m_particleTypes.size());
+
+  // At snapshot resolution this is the largest buffer in the program, it is only allocated the first time
+  FieldBuffer &rendergrid = m_renderFields[type];
+  rendergrid.reset(m_render3dwidth+1,m_render3dheight+1,m_render3dwidth+1);
+  for(int i=0; i<_snapshot.m_count; ++i)
   {
-    i.resize(m_render3dheight+1);
-    for(auto& j : i)
-    {
-      j.resize(m_render3dwidth+1,0.0f);
-    }
+    if(_snapshot.m_type[i]==type) splat3D(_snapshot,i,rendergrid,0,INT_MAX);
   }
+  return rendergrid;
+}
 
-  float rendersquare=m_squaresize/m_render3dresolution;
-
-  for(int i=0; i<m_lastTakenParticle+1; ++i)
+void World::splat3D(const RenderSnapshot &_snapshot, int _i, FieldBuffer &io_grid, int _firstColumn, int _lastColumn)
+{
+  float rendersquare=m_renderView.m_squaresize/m_render3dresolution;
+  int cell = _snapshot.m_gridPosition[_i];
+  int layer = m_renderView.m_gridwidth*m_renderView.m_gridheight;
+  Vec3 heightwidthdepth = Vec3(cell%m_renderView.m_gridwidth,(cell%layer)/m_renderView.m_gridwidth,cell/layer)
+                          *m_render3dresolution;
+
+  int firstx = std::max(-2*m_render3dresolution,_firstColumn-(int)heightwidthdepth[0]);
+  int lastx = std::min(4*m_render3dresolution,_lastColumn-1-(int)heightwidthdepth[0]);
+  for(int x = firstx; x<=lastx; ++x)
   {
-    if(m_particles[i].getAlive()&&(m_particles[i].getProperties()==p))
+    for(int y = -2*m_render3dresolution; y<=4*m_render3dresolution ; ++y)
     {
-      Vec3 heightwidthdepth = getGridXYZ(m_particles[i].getGridPosition())*m_render3dresolution; // 3Dify this
-
-      for(int x = -2*m_render3dresolution; x<=4*m_render3dresolution; ++x)
+      for(int z = -2*m_render3dresolution; z<=4*m_render3dresolution ; ++z)
       {
-        for(int y = -2*m_render3dresolution; y<=4*m_render3dresolution ; ++y)
-        {
-          for(int z = -2*m_render3dresolution; z<=4*m_render3dresolution ; ++z)
-          {
-
-            //std::cout<<"hello"<<std::endl;
-            int currentcolumn=heightwidthdepth[0]+x;
-            int currentrow=heightwidthdepth[1]+y;
-            int currentdepth=heightwidthdepth[2]+z;
+        int currentcolumn=heightwidthdepth[0]+x;
+        int currentrow=heightwidthdepth[1]+y;
+        int currentdepth=heightwidthdepth[2]+z;
 
-            if(currentcolumn<m_render3dwidth && currentcolumn>0 &&
-               currentrow<m_render3dheight && currentrow>0 &&
-               currentdepth<m_render3dwidth && currentdepth>0)
-            {
-              float currentx = rendersquare*(float)currentcolumn - m_halfwidth;
-              float currenty = rendersquare*(float)currentrow - m_halfheight;
-              float currentz = rendersquare*(float)currentdepth - 2 - m_halfwidth;
+        if(currentcolumn<m_render3dwidth && currentcolumn>0 &&
+           currentrow<m_render3dheight && currentrow>0 &&
+           currentdepth<m_render3dwidth && currentdepth>0)
+        {
+          float currentx = rendersquare*(float)currentcolumn - m_renderView.m_halfwidth;
+          float currenty = rendersquare*(float)currentrow - m_renderView.m_halfheight;
+          float currentz = rendersquare*(float)currentdepth - 2 - m_renderView.m_halfwidth;
 
-              float metaballx = currentx-m_particles[i].getPosition()[0];
-              float metabally = currenty-m_particles[i].getPosition()[1];
-              float metaballz = currentz-m_particles[i].getPosition()[2];
+          float metaballx = currentx-_snapshot.m_x[_i];
+          float metabally = currenty-_snapshot.m_y[_i];
+          float metaballz = currentz-_snapshot.m_z[_i];
 
-              float metaballfloat = (m_interactionradius*m_interactionradius)/(metaballx*metaballx + metabally*metabally + metaballz*metaballz);
-              //std::cout<<metaballfloat<<std::endl;
-              rendergrid[currentcolumn][currentrow][currentdepth]+=metaballfloat;
-            }
-          }
+          float metaballfloat = (m_renderView.m_interactionradius*m_renderView.m_interactionradius)/(metaballx*metaballx + metabally*metabally + metaballz*metaballz);
+          io_grid.at(currentcolumn,currentrow,currentdepth)+=metaballfloat;
         }
       }
     }
   }
-  return rendergrid;
 }
 
 Vec3 World::getGridXYZ(int k) // CHECK THIS
@@ -1320,82 +2422,180 @@ Vec3 World::getGridXYZ(int k) // CHECK THIS
 
 int World::getSnapshotMode()
 {
-  return m_marching.getSnapshotMode();
+  return m_snapshotMode;
 }
 
-void World::drawLoading()
+const RenderView &World::getDrawnView() const
 {
+  return m_snapshots.front().m_view;
+}
 
-  /// The following section is modified from :-
-  /// Tim Jones (2011). SDL Tip - SDL Surface to OpenGL Texture [online]. [Accessed 2016].
-  /// Available from: <http://www.sdltutorials.com/sdl-tip-sdl-surface-to-opengl-texture>.
-  glDisable(GL_LIGHTING);
-  glEnable(GL_TEXTURE_2D);
+void World::drawCube(float _x, float _y)
+{
+  if(!m_3d)
+  {
+    for(int i = 0; i<10; ++i)
+    {
+      for(int j=0; j<10; ++j)
+      {
+        Particle newparticle = Particle(Vec3(_x+i*0.2f,_y-j*0.2f,-2.0f),&m_particleTypes[m_todraw]);
+        newparticle.setIsObject();
+        insertParticle(newparticle);
+      }
+    }
+  }
+}
 
-  glEnable (GL_BLEND);
-  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void World::addBlock(Vec3 _min, Vec3 _max, float _spacing)
+{
+  int columns = (int)floor((_max[0]-_min[0])/_spacing)+1;
+  int rows = (int)floor((_max[1]-_min[1])/_spacing)+1;
+  int layers = 1;
+  if(m_3d) layers = (int)floor((_max[2]-_min[2])/_spacing)+1;
 
-  GLuint titleTextureID = 0;
-  SDL_Surface* Surface = IMG_Load("textures/buttons.png");
-  if(!Surface)
+  for(int k=0; k<layers; ++k)
   {
-    printf("IMG_Load: %s\n", IMG_GetError());
-    std::cout<<"error"<<std::endl;
+    float z = -2.0f;
+    if(m_3d) z = _min[2]+k*_spacing;
+    for(int j=0; j<rows; ++j)
+    {
+      for(int i=0; i<columns; ++i)
+      {
+        insertParticle(Particle(Vec3(_min[0]+i*_spacing,_min[1]+j*_spacing,z),&m_particleTypes[m_todraw]));
+      }
+    }
   }
+  hashParticles();
+}
 
-  glGenTextures(1, &titleTextureID);
-  glBindTexture(GL_TEXTURE_2D, titleTextureID);
-
-  int Mode = GL_RGBA;
+void World::setWorldHalfHeight(float _halfheight)
+{
+  m_worldHalfHeight=_halfheight;
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, Mode, Surface->w, Surface->h, 0, Mode, GL_UNSIGNED_BYTE, Surface->pixels);
+int World::getAliveParticles() const
+{
+  return m_howManyAliveParticles;
+}
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void World::addParticles(const std::vector<Vec3> &_positions)
+{
+  for(auto& p : _positions)
+  {
+    Vec3 position = p;
+    if(!m_3d) position[2]=-2.0f;
+    insertParticle(Particle(position,&m_particleTypes[m_todraw]));
+  }
+  hashParticles();
+}
 
-  // end of Citation
+ParticleProperties *World::getParticleType(int _type)
+{
+  return &m_particleTypes[_type];
+}
 
-  float texH = 0.1f;
-  float texW = 0.6f;
-  float X = -1.0f;
-  float Y = -0.3f;
-  float Width = 2.8;
-  float Height = 0.6f;
+int World::getGridCell(int _i) const
+{
+  return m_particles.m_gridPosition[_i];
+}
 
-  glBegin(GL_QUADS);
-  glColor3f(1.0f,1.0f,1.0f);
-  glTexCoord2f(0, 0.9+texH); glVertex3f(X, Y, -2);
-  glTexCoord2f(0+texW, 0.9+texH); glVertex3f(X + Width, Y, -2);
-  glTexCoord2f(0+texW, 0.9); glVertex3f(X + Width, Y + Height, -2);
-  glTexCoord2f(0, 0.9); glVertex3f(X, Y + Height, -2);
-  glEnd();
+const PhaseTimer &World::getPhaseTimer() const
+{
+  return m_phaseTimer;
+}
 
-  glDisable(GL_TEXTURE_2D);
-  glEnable(GL_LIGHTING) ;
+void World::setTimingDump(int _frames)
+{
+  m_timingDumpInterval=_frames;
 }
 
-void World::drawCube()
+void World::publishSnapshot()
 {
-  if(!m_3d)
+  RenderSnapshot &snapshot = m_snapshots.back();
+  int slots = m_lastTakenParticle+1;
+  snapshot.m_x.resize(slots);
+  snapshot.m_y.resize(slots);
+  snapshot.m_z.resize(slots);
+  snapshot.m_red.resize(slots);
+  snapshot.m_green.resize(slots);
+  snapshot.m_blue.resize(slots);
+  snapshot.m_type.resize(slots);
+  snapshot.m_gridPosition.resize(slots);
+
+  int k = 0;
+  for(int i=0; i<slots; ++i)
   {
-    for(int i = 0; i<10; ++i)
+    if(!m_particles.getAlive(i)) continue;
+
+    snapshot.m_x[k]=m_particles.m_x[i];
+    snapshot.m_y[k]=m_particles.m_y[i];
+    snapshot.m_z[k]=m_particles.m_z[i];
+    snapshot.m_type[k]=m_particles.m_type[i];
+    snapshot.m_gridPosition[k]=m_particles.m_gridPosition[i];
+
+    // Same colours as Particle::drawParticle
+    const ParticleProperties &properties = m_particleTypes[m_particles.m_type[i]];
+    if(m_particles.getWall(i))
     {
-      for(int j=0; j<10; ++j)
+      snapshot.m_red[k]=1.0f;
+      snapshot.m_green[k]=0.0f;
+      snapshot.m_blue[k]=0.0f;
+    }
+    else
+    {
+      float fast = 0.0f;
+      if(properties.getColourEffect())
       {
-        Particle newparticle = Particle(Vec3(-3.0f+i*0.2f,3.0f-j*0.2f,-2.0f),&m_particleTypes[m_todraw]);
-        newparticle.setIsObject();
-        insertParticle(newparticle);
+        float vx = m_particles.m_velx[i];
+        float vy = m_particles.m_vely[i];
+        float vz = m_particles.m_velz[i];
+        fast = std::min(1.0f,sqrtf(vx*vx + vy*vy + vz*vz)*5.0f);
       }
+      snapshot.m_red[k]=properties.getRed()+fast;
+      snapshot.m_green[k]=properties.getGreen()+fast;
+      snapshot.m_blue[k]=properties.getBlue()+fast;
     }
+    ++k;
   }
+  snapshot.m_count=k;
+  snapshot.m_step=m_step;
+
+  RenderView &view = snapshot.m_view;
+  view.m_3d=m_3d;
+  view.m_gridwidth=m_gridwidth;
+  view.m_gridheight=m_gridheight;
+  view.m_squaresize=m_squaresize;
+  view.m_interactionradius=m_interactionradius;
+  view.m_halfwidth=m_halfwidth;
+  view.m_halfheight=m_halfheight;
+  view.m_pointsize=m_pointsize;
+  snapshot.m_types=m_particleTypes;
+
+  m_snapshots.publish();
+}
+
+void World::setTrajectory(TrajectoryWriter *_writer)
+{
+  m_trajectory=_writer;
+}
+
+const RenderSnapshot &World::getSnapshot()
+{
+  m_snapshots.acquire();
+  return m_snapshots.front();
+}
+
+MarchingAlgorithms &World::getMarching()
+{
+  return m_marching;
 }
 
 void World::makeParticlesBig()
 {
     m_pointsize=10.f;
     m_squaresize=1.0f;
-    m_marching.setSquareSize(1.0f);
     m_interactionradius=1.0f;
+    setNeighbourList(m_useNeighbourList,m_neighbourSkin);
     hashParticles();
 }
 
@@ -1403,8 +2603,8 @@ void World::makeParticlesSmall()
 {
     m_pointsize=5.0f;
     m_squaresize=0.5f;
-    m_marching.setSquareSize(0.5f);
     m_interactionradius=0.5f;
+    setNeighbourList(m_useNeighbourList,m_neighbourSkin);
     hashParticles();
 }
 
@@ -1412,8 +2612,8 @@ void World::increase2DResolutionWORLD()
 {
   ++m_render2DResolution;
   m_marching.increase2DResolution();
-  m_render2dwidth=m_gridwidth*m_render2DResolution;
-  m_render2dheight=m_gridheight*m_render2DResolution;
+  m_render2dwidth=m_renderView.m_gridwidth*m_render2DResolution;
+  m_render2dheight=m_renderView.m_gridheight*m_render2DResolution;
 }
 
 void World::decrease2DResolutionWORLD()
@@ -1421,6 +2621,6 @@ void World::decrease2DResolutionWORLD()
   m_marching.decrease2DResolution();
   if(m_render2DResolution!=1)
     --m_render2DResolution;
-  m_render2dwidth=m_gridwidth*m_render2DResolution;
-  m_render2dheight=m_gridheight*m_render2DResolution;
+  m_render2dwidth=m_renderView.m_gridwidth*m_render2DResolution;
+  m_render2dheight=m_renderView.m_gridheight*m_render2DResolution;
 }
@@ -0,0 +1,217 @@
+///
+///  @file WorldDraw.cpp
+///  @brief OpenGL set up and drawing of the world. Everything in World that needs OpenGL or SDL lives here so
+///         that World.cpp builds into the headless simulation core.
+
+#include "include/World.h"
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glu.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <GL/gl.h>
+#include <GL/glu.h>
+#endif
+
+void World::initGL()
+{
+  glEnable(GL_TEXTURE_2D);
+
+  glFrontFace(GL_CCW);
+
+  glEnable(GL_LIGHTING);
+  glEnable(GL_NORMALIZE);
+  glEnable(GL_LIGHT0);
+  glEnable(GL_LIGHT_MODEL_AMBIENT);
+
+  GLfloat ambientColor[] = {0.2f, 0.2f, 0.2f, 1.0f}; //Color(0.2, 0.2, 0.2)
+  glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
+
+  glEnable( GL_MULTISAMPLE_ARB);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_COLOR_MATERIAL);
+  glPointSize(m_pointsize);
+
+  // Set the background colour
+  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+}
+
+void World::resizeWindow(int w, int h) {
+
+  if (!m_isInit) return;
+
+  glViewport(0,0,w,h);
+
+  // The world is resized on the simulation thread by Command::RESIZE_WORLD, draw() sets the projection up
+  // again for the size it publishes
+  m_renderView=RenderView();
+}
+
+void World::draw() {
+  if (!m_isInit) return;
+
+  // Everything below reads the newest finished step, never the particles update() is working on
+  const RenderSnapshot &snapshot = getSnapshot();
+
+  // The world was resized, switched dimension or loaded from a checkpoint since the last frame
+  if(snapshot.m_view!=m_renderView)
+  {
+    const RenderView &view = snapshot.m_view;
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-view.m_halfwidth,view.m_halfwidth,-view.m_halfheight,view.m_halfheight,0.1, 5000.0);
+    resizeRender(view);
+  }
+  const std::vector<ParticleProperties> &types = snapshot.m_types;
+
+  glMatrixMode(GL_MODELVIEW);
+
+  bool current_3d=snapshot.m_view.m_3d;
+  if(current_3d && m_marching.getSnapshotMode()!=1)
+  {
+    glPushMatrix();
+    glTranslatef(0.0f,2.0f,-10.0f);
+    glTranslatef(0.0f, 0.0f, -2.0f); // move back to focus of gluLookAt
+    glRotatef(m_camerarotatex,0.0f,1.0f,0.0f); //  rotate around center
+    glRotatef(m_camerarotatey,1.0f,0.0f,0.0f); //  rotate around center
+    glTranslatef(0.0f, 0.0f, 2.0f); //move object to center
+  }
+
+  glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+  if(m_renderoption==1){
+    // Same spheres as Particle::drawParticle with the colours worked out in publishSnapshot()
+    GLUquadricObj *quadric = gluNewQuadric();
+    gluQuadricDrawStyle(quadric, GLU_FILL );
+    glMatrixMode(GL_MODELVIEW);
+    for(int i=0; i<snapshot.m_count; ++i){
+      glColor3f(snapshot.m_red[i],snapshot.m_green[i],snapshot.m_blue[i]);
+      glPushMatrix();
+      glTranslatef(snapshot.m_x[i], snapshot.m_y[i], snapshot.m_z[i]);
+      gluSphere( quadric , 0.25*(snapshot.m_view.m_pointsize/10.f) , 16 , 16 );
+      glPopMatrix();
+    }
+    gluDeleteQuadric(quadric);
+  }
+
+
+  else if(m_renderoption==2)
+  {
+    if(!current_3d)
+    {
+      renderFields(snapshot,false);
+      for(int t=0; t<(int)types.size(); ++t)
+      {
+        if(getRenderFieldCount(t)==0) continue;
+        m_marching.calculateMarchingSquares(getRenderField(t),types[t],false);
+        m_marching.calculateMarchingSquares(getRenderField(t),types[t],true);
+      }
+      m_marching.draw2DRealtime();
+    }
+    else
+    {
+      // DRAW LOADING SCREEN
+      if(m_marching.getSnapshotMode()==1)
+      {
+        drawLoading();
+        m_marching.setSnapshotMode(2);
+      }
+
+      // SNAPSHOT MODE PROCESSING
+      else if(m_marching.getSnapshotMode()==2)
+      {
+        m_render3dresolution*=m_snapshotmultiplier;
+        m_render3dwidth=m_renderView.m_gridwidth*m_render3dresolution;
+        m_render3dheight=m_renderView.m_gridheight*m_render3dresolution;
+        m_marching.toggle3DResolution();
+        m_marching.clearSnapshot3DTriangles();
+        renderFields(snapshot,true);
+        for(int t=0; t<(int)types.size(); ++t)
+        {
+          if(getRenderFieldCount(t)==0) continue;
+          m_marching.calculateMarchingCubes(getRenderField(t),types[t]);
+        }
+        m_marching.setSnapshotMode(3);
+      }
+
+      // DRAW THE GENERATED SNAPSHOT
+      else if(m_marching.getSnapshotMode()>2)
+      {
+        m_marching.draw3DSnapshot();
+      }
+
+      // DRAW REAL-TIME FLUID MARCHING CUBES
+      else
+      {
+        m_marching.clearSnapshot3DTriangles();
+        renderFields(snapshot,true);
+        for(int t=0; t<(int)types.size(); ++t)
+        {
+          if(getRenderFieldCount(t)==0) continue;
+          m_marching.calculateMarchingCubes(getRenderField(t),types[t]);
+        }
+        m_marching.draw3DRealtime();
+      }
+    }
+  }
+
+  if(current_3d) glPopMatrix();
+
+  // Holds the simulation thread while a 3D snapshot is being built
+  m_snapshotMode=m_marching.getSnapshotMode();
+}
+
+void World::drawLoading()
+{
+
+  /// The following section is modified from :-
+  /// Tim Jones (2011). SDL Tip - SDL Surface to OpenGL Texture [online]. [Accessed 2016].
+  /// Available from: <http://www.sdltutorials.com/sdl-tip-sdl-surface-to-opengl-texture>.
+  glDisable(GL_LIGHTING);
+  glEnable(GL_TEXTURE_2D);
+
+  glEnable (GL_BLEND);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  GLuint titleTextureID = 0;
+  SDL_Surface* Surface = IMG_Load("textures/buttons.png");
+  if(!Surface)
+  {
+    printf("IMG_Load: %s\n", IMG_GetError());
+    std::cout<<"error"<<std::endl;
+  }
+
+  glGenTextures(1, &titleTextureID);
+  glBindTexture(GL_TEXTURE_2D, titleTextureID);
+
+  int Mode = GL_RGBA;
+
+  glTexImage2D(GL_TEXTURE_2D, 0, Mode, Surface->w, Surface->h, 0, Mode, GL_UNSIGNED_BYTE, Surface->pixels);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  // end of Citation
+
+  float texH = 0.1f;
+  float texW = 0.6f;
+  float X = -1.0f;
+  float Y = -0.3f;
+  float Width = 2.8;
+  float Height = 0.6f;
+
+  glBegin(GL_QUADS);
+  glColor3f(1.0f,1.0f,1.0f);
+  glTexCoord2f(0, 0.9+texH); glVertex3f(X, Y, -2);
+  glTexCoord2f(0+texW, 0.9+texH); glVertex3f(X + Width, Y, -2);
+  glTexCoord2f(0+texW, 0.9); glVertex3f(X + Width, Y + Height, -2);
+  glTexCoord2f(0, 0.9); glVertex3f(X, Y + Height, -2);
+  glEnd();
+
+  glDisable(GL_TEXTURE_2D);
+  glEnable(GL_LIGHTING) ;
+}